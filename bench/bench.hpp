@@ -0,0 +1,78 @@
+/*! \file bench.hpp
+ *  \brief Timing helpers shared by the benchmarks
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace discpp
+{
+    namespace bench
+    {
+        /*! Stores `v` where the optimizer can't see it unused, so the work
+         *  that produced it isn't dropped */
+        inline void consume(std::uint64_t v)
+        {
+            static volatile std::uint64_t sink;
+            sink = v;
+        }
+
+        /*! Runs `f` repeatedly for at least `min_time`, after one untimed
+         *  warm-up call, and returns the mean nanoseconds per call */
+        template <typename F>
+        double ns_per_call(F &&f, std::chrono::milliseconds min_time = std::chrono::milliseconds(500))
+        {
+            using clock = std::chrono::steady_clock;
+            f();
+            std::uint64_t calls = 0;
+            const auto start = clock::now();
+            auto now = start;
+            do
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    f();
+                }
+                calls += 16;
+                now = clock::now();
+            } while (now - start < min_time);
+            return std::chrono::duration<double, std::nano>(now - start).count() / calls;
+        }
+
+        /*! Prints one result line: name, time per call, and throughput if
+         *  `bytes` were processed per call */
+        inline void report(const char *name, double ns, std::uint64_t bytes = 0)
+        {
+            if (bytes)
+            {
+                std::printf("%-40s %12.1f ns  %9.1f MB/s\n", name, ns, bytes / ns * 1e3);
+            }
+            else
+            {
+                std::printf("%-40s %12.1f ns\n", name, ns);
+            }
+        }
+    } // namespace bench
+} // namespace discpp
+
+#endif
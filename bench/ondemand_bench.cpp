@@ -0,0 +1,128 @@
+/*! \file ondemand_bench.cpp
+ *  \brief Compares field lookups through ondemand::document with
+ *  boost::json::parse
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+
+#include <boost/json.hpp>
+
+#include "core/ondemand.hpp"
+#include "bench.hpp"
+
+namespace
+{
+    using namespace discpp;
+
+    std::string message_create()
+    {
+        return R"({"op":0,"s":4021,"t":"MESSAGE_CREATE","d":{"type":0,"tts":false,)"
+               R"("timestamp":"2020-08-24T17:02:11.123000+00:00","pinned":false,"nonce":"748122",)"
+               R"("mentions":[],"mention_roles":[],"mention_everyone":false,"member":{"roles":)"
+               R"(["41771983423143936","41771983423143937"],"joined_at":"2019-01-01T00:00:00+00:00",)"
+               R"("deaf":false,"mute":false},"id":"748122480311091200","flags":0,"embeds":[],)"
+               R"("edited_timestamp":null,"content":"!ping with \"some\" {text} to scan past",)"
+               R"("channel_id":"41771983423143937","author":{"username":"someone","public_flags":0,)"
+               R"("id":"80351110224678912","discriminator":"1337","avatar":"8342729096ea3675442027381ff50dfe"},)"
+               R"("attachments":[],"guild_id":"41771983423143937"}})";
+    }
+
+    std::string presence_update()
+    {
+        return R"({"op":0,"s":4022,"t":"PRESENCE_UPDATE","d":{"user":{"id":"80351110224678912"},)"
+               R"("status":"online","guild_id":"41771983423143937","client_status":{"desktop":"online"},)"
+               R"("activities":[{"type":0,"name":"A game","id":"ec0b28a579ecb4bd","created_at":1598288531000,)"
+               R"("timestamps":{"start":1598280000000},"application_id":"379286085710381999",)"
+               R"("details":"In a match","state":"Rank 12","assets":{"large_image":"383308474034536449"}}]}})";
+    }
+
+    std::string guild_create(std::size_t members)
+    {
+        std::string out = R"({"op":0,"s":2,"t":"GUILD_CREATE","d":{"members":[)";
+        for (std::size_t i = 0; i < members; ++i)
+        {
+            if (i)
+            {
+                out += ',';
+            }
+            const std::string id = std::to_string(80351110224678912ull + i);
+            out += R"({"user":{"id":")" + id + R"(","username":"member )" + std::to_string(i) +
+                   R"(","discriminator":"0001","avatar":null},"roles":["41771983423143936"],)"
+                   R"("joined_at":"2019-01-01T00:00:00+00:00","deaf":false,"mute":false})";
+        }
+        out += R"(],"name":"A guild","id":"41771983423143937","member_count":)" +
+               std::to_string(members) + "}}";
+        return out;
+    }
+
+    /*! The DOM counterpart of ondemand::value::at_path */
+    const boost::json::value &dom_path(const boost::json::value &v, boost::json::string_view path)
+    {
+        const std::size_t dot = path.find('.');
+        const boost::json::value &member = v.as_object().at(path.substr(0, dot));
+        return dot == boost::json::string_view::npos ? member : dom_path(member, path.substr(dot + 1));
+    }
+
+    void run(const char *label, const std::string &frame, const char *path)
+    {
+        std::printf("%s (%zu bytes), looking up t and %s\n", label, frame.size(), path);
+
+        const double dom = bench::ns_per_call([&]
+        {
+            const boost::json::value v = boost::json::parse(frame);
+            bench::consume(v.as_object().at("t").as_string().size() +
+                           dom_path(v, path).as_string().size());
+        });
+        bench::report("  boost::json::parse", dom, frame.size());
+
+        const struct
+        {
+            const char *name;
+            ondemand::simd_level level;
+        } levels[] = {
+            {"  ondemand, scalar", ondemand::simd_level::scalar},
+            {"  ondemand, sse4.2", ondemand::simd_level::sse42},
+            {"  ondemand, avx2", ondemand::simd_level::avx2},
+        };
+        for (const auto &l : levels)
+        {
+            if (static_cast<int>(l.level) > static_cast<int>(ondemand::active_simd_level()))
+            {
+                std::printf("%-40s (not supported by this CPU)\n", l.name);
+                continue;
+            }
+            const double od = bench::ns_per_call([&]
+            {
+                const ondemand::document doc(frame, l.level);
+                bench::consume(doc.root()["t"].get_raw_string().size() +
+                               doc.root().at_path(path).get_raw_string().size());
+            });
+            bench::report(l.name, od, frame.size());
+        }
+    }
+}
+
+int main()
+{
+    run("MESSAGE_CREATE", message_create(), "d.author.id");
+    run("PRESENCE_UPDATE", presence_update(), "d.user.id");
+    run("GUILD_CREATE, 1000 members", guild_create(1000), "d.id");
+    run("GUILD_CREATE, 25000 members", guild_create(25000), "d.id");
+    return 0;
+}
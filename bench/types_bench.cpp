@@ -0,0 +1,171 @@
+/*! \file types_bench.cpp
+ *  \brief Measures the memory and access cost of the typed objects against
+ *  boost::json::object
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+
+#include <boost/json.hpp>
+
+#include "core/types.hpp"
+#include "bench.hpp"
+
+namespace
+{
+    /*! Bytes currently allocated through operator new */
+    std::atomic<std::size_t> live_bytes{0};
+}
+
+// Count every allocation, so each representation's heap use can be read off
+// as the difference before and after building it
+void *operator new(std::size_t size)
+{
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    live_bytes += malloc_usable_size(p);
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (p)
+    {
+        live_bytes -= malloc_usable_size(p);
+        std::free(p);
+    }
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+namespace
+{
+    using namespace discpp;
+
+    constexpr std::size_t count = 20000;
+
+    std::string message_json(std::size_t i)
+    {
+        // Content lengths vary the way chat does: mostly short, some long
+        const std::string content(i % 10 == 0 ? 300 : 20 + i % 60, 'x');
+        return R"({"type":0,"tts":false,"timestamp":"2020-08-24T17:02:11.123000+00:00",)"
+               R"("pinned":false,"mentions":[],"mention_roles":[],"mention_everyone":false,)"
+               R"("member":{"roles":["41771983423143936"],"joined_at":"2019-01-01T00:00:00+00:00",)"
+               R"("deaf":false,"mute":false},"id":")" + std::to_string(748122480311091200ull + i) +
+               R"(","flags":0,"embeds":[],"edited_timestamp":null,"content":")" + content +
+               R"(","channel_id":"41771983423143937","author":{"username":"someone","public_flags":0,)"
+               R"("id":"80351110224678912","discriminator":"1337",)"
+               R"("avatar":"8342729096ea3675442027381ff50dfe"},"attachments":[],)"
+               R"("guild_id":"41771983423143937"})";
+    }
+
+    std::string member_json(std::size_t i)
+    {
+        return R"({"user":{"id":")" + std::to_string(80351110224678912ull + i) +
+               R"(","username":"member )" + std::to_string(i) +
+               R"(","discriminator":"0001","avatar":null},"nick":null,)"
+               R"("roles":["41771983423143936","41771983423143937"],)"
+               R"("joined_at":"2019-01-01T00:00:00+00:00","deaf":false,"mute":false})";
+    }
+
+    /*! Prints the bytes per object, heap and inline, held by `count`
+     *  objects of each representation */
+    template <typename Typed>
+    void measure(const char *label, std::string (*make)(std::size_t))
+    {
+        std::vector<std::string> sources;
+        std::size_t source_bytes = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            sources.push_back(make(i));
+            source_bytes += sources.back().size();
+        }
+        std::printf("%s: %zu objects, %.1f bytes of JSON each\n",
+                    label, count, static_cast<double>(source_bytes) / count);
+
+        {
+            std::vector<boost::json::object> dom;
+            dom.reserve(count);
+            const std::size_t before = live_bytes;
+            for (const std::string &s : sources)
+            {
+                dom.push_back(std::move(boost::json::parse(s).as_object()));
+            }
+            const std::size_t heap = live_bytes - before;
+            std::printf("  %-36s %9.1f bytes/object\n", "boost::json::object",
+                        static_cast<double>(heap) / count + sizeof(boost::json::object));
+        }
+
+        {
+            std::vector<Typed> typed;
+            typed.reserve(count);
+            const std::size_t before = live_bytes;
+            for (const std::string &s : sources)
+            {
+                // Copied, so the source's buffer counts against the object
+                typed.emplace_back(std::string(s));
+            }
+            const std::size_t heap = live_bytes - before;
+            std::printf("  %-36s %9.1f bytes/object\n", "typed",
+                        static_cast<double>(heap) / count + sizeof(Typed));
+        }
+    }
+}
+
+int main()
+{
+    measure<types::message>("Messages", message_json);
+    measure<types::guild_member>("Members", member_json);
+
+    // What reading a text field costs once the object is built
+    const std::string json = message_json(1);
+    const boost::json::object dom = boost::json::parse(json).as_object();
+    const types::message typed(json);
+    std::printf("Reading content of a cached message\n");
+    bench::report("  boost::json::object", bench::ns_per_call([&]
+    {
+        bench::consume(dom.at("content").as_string().size());
+    }));
+    bench::report("  typed", bench::ns_per_call([&]
+    {
+        bench::consume(typed.content().size());
+    }));
+
+    std::printf("Building a message from its JSON\n");
+    bench::report("  boost::json::parse", bench::ns_per_call([&]
+    {
+        bench::consume(boost::json::parse(json).as_object().size());
+    }), json.size());
+    bench::report("  typed", bench::ns_per_call([&]
+    {
+        bench::consume(types::message(json).id().value());
+    }), json.size());
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*! \file url_encode_bench.cpp
+ *  \brief Compares http::url_encode, and reaction routes rendered with it,
+ *  with what they replaced
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <string>
+
+#include "net/http.hpp"
+#include "rest/channel.hpp"
+#include "rest/route.hpp"
+#include "bench.hpp"
+
+namespace
+{
+    using namespace discpp;
+
+    /*! The encoder before the rewrite: in place, one replace per escaped
+     *  byte */
+    void in_place(std::string &s)
+    {
+        static const char hex[] = "0123456789ABCDEF";
+        for (auto i = s.begin(); i != s.end(); ++i)
+        {
+            const unsigned char c = static_cast<unsigned char>(*i);
+            if ((c < '0' || c > '9') && (c < 'A' || c > 'Z') && (c < 'a' || c > 'z') &&
+                c != '~' && c != '-' && c != '_' && c != '.')
+            {
+                const char escaped[3] = {'%', hex[c >> 4], hex[c & 0x0F]};
+                const auto at = i - s.begin();
+                s.replace(i, i + 1, escaped, 3);
+                i = s.begin() + at + 2;
+            }
+        }
+    }
+
+    void run(const char *label, const std::string &input)
+    {
+        std::printf("%s (%zu bytes)\n", label, input.size());
+        bench::report("  in place, replace per byte", bench::ns_per_call([&]
+        {
+            std::string s = input;
+            in_place(s);
+            bench::consume(s.size());
+        }), input.size());
+        bench::report("  url_encode", bench::ns_per_call([&]
+        {
+            bench::consume(http::url_encode(input).size());
+        }), input.size());
+    }
+
+    /*! Renders the route of one page of an emoji's reactions both ways:
+     *  through strings, as before, and straight into the route */
+    void run_route(const char *label, const emoji &emoji_)
+    {
+        const snowflake channel_id(41771983423143937ULL);
+        const snowflake message_id(80351110224678912ULL);
+        const snowflake after(53908232506183680ULL);
+        const unsigned int limit = 100;
+
+        std::printf("%s\n", label);
+        bench::report("  strings, then route", bench::ns_per_call([&]
+        {
+            const std::string emoji_string =
+                http::url_encode(rest::channel::detail::get_emoji_string(emoji_));
+            std::string query = "?limit=" + std::to_string(limit);
+            query += "&after=" + after.to_string();
+            rest::route r(rest::routes::reactions, channel_id, message_id);
+            r.append("/").append(emoji_string).append(query);
+            bench::consume(r.view().size());
+        }));
+        bench::report("  emoji_route", bench::ns_per_call([&]
+        {
+            rest::route r = rest::channel::detail::emoji_route(channel_id, message_id, emoji_);
+            r.append("?limit=").append(limit).append("&after=").append(after);
+            bench::consume(r.view().size());
+        }));
+    }
+}
+
+int main()
+{
+    // What the REST routes actually encode: reaction emoji
+    run("Custom emoji", "thumbs:41771983423143937");
+    run("Unicode emoji", "\xF0\x9F\x91\x8D\xF0\x9F\x8F\xBD");
+
+    std::string plain;
+    std::string mixed;
+    for (int i = 0; i < 64; ++i)
+    {
+        plain += "abcd";
+        mixed += i % 4 ? "ab c" : "a/\xC3\xA9";
+    }
+    run("Unreserved text", plain);
+    run("Text with spaces and UTF-8", mixed);
+
+    emoji custom;
+    custom["name"] = "thumbs";
+    custom["id"] = "41771983423143937";
+    emoji unicode;
+    unicode["name"] = "\xF0\x9F\x91\x8D\xF0\x9F\x8F\xBD";
+    unicode["id"] = nullptr;
+    run_route("Reaction route, custom emoji", custom);
+    run_route("Reaction route, unicode emoji", unicode);
+    return 0;
+}
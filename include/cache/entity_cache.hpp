@@ -0,0 +1,279 @@
+/*! \file entity_cache.hpp
+ *  \brief In-memory cache of guild state built from gateway events
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENTITY_CACHE_HPP
+#define ENTITY_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "core/dispatcher.hpp"
+#include "core/guild_stream.hpp"
+#include "core/snowflake.hpp"
+#include "core/types.hpp"
+#include "rcu_table.hpp"
+
+namespace discpp
+{
+    namespace cache
+    {
+        /*! Key of a guild member: the same user is a different member in
+         *  every guild */
+        struct member_key
+        {
+            snowflake guild;
+            snowflake user;
+
+            friend bool operator==(const member_key &a, const member_key &b)
+            {
+                return a.guild == b.guild && a.user == b.user;
+            }
+        };
+
+        struct member_key_hash
+        {
+            std::size_t operator()(const member_key &k) const noexcept
+            {
+                const std::hash<snowflake> h;
+                return h(k.guild) ^ (h(k.user) * 0x9E3779B97F4A7C15ULL);
+            }
+        };
+
+        /*! Number of entities of each kind held by an entity_cache */
+        struct entity_counts
+        {
+            std::size_t guilds;
+            std::size_t channels;
+            std::size_t roles;
+            std::size_t members;
+            std::size_t emojis;
+        };
+
+        class entity_cache
+        {
+            /*! \class entity_cache
+             *  \brief Guilds, channels, roles, members and emojis, kept current
+             *  from gateway events
+             *
+             *  Feed it every dispatch payload through #apply, or let #attach do
+             *  so. Entities are stored as the compact types:: objects, in
+             *  rcu_tables keyed by snowflake, so lookups don't wait for the
+             *  thread applying events to finish a write. An update only
+             *  replaces the
+             *  entity it touches; partial updates (GUILD_UPDATE,
+             *  GUILD_MEMBER_UPDATE...) are merged into the cached object, so
+             *  fields they don't carry are kept.
+             *
+             *  Returned pointers are snapshots: they stay valid, and
+             *  unchanged, after the cache moves on.
+             *
+             *  The whole cache can be saved to a binary snapshot file with
+             *  #save_snapshot, and restored from it at startup with
+             *  #load_snapshot, so that it is usable before the gateway has
+             *  sent anything. Restored guilds count as stale until their
+             *  GUILD_CREATE arrives and replaces them.
+             *
+             *  The GUILD_CREATE of a large guild doesn't list its members, so
+             *  the members already cached (restored, or left from before an
+             *  outage) are kept but marked unconfirmed. Any event carrying a
+             *  member confirms it. Once the last chunk of a
+             *  GUILD_MEMBERS_CHUNK answer arrives and the confirmed members
+             *  add up to the guild's member_count, the unconfirmed ones are
+             *  dropped as having left.
+             */
+            public:
+                template <typename T>
+                using pointer = std::shared_ptr<const T>;
+
+                entity_cache() = default;
+
+                entity_cache(const entity_cache &) = delete;
+                entity_cache &operator=(const entity_cache &) = delete;
+
+                /*! Applies one gateway payload. Events the cache doesn't track
+                 *  are ignored. */
+                void apply(const boost::json::value &payload);
+
+                /*! Registers #apply as a synchronous dispatcher handler for
+                 *  every event the cache tracks, so the cache is up to date
+                 *  before any async handler of the same event runs. The cache
+                 *  must outlive the dispatcher. */
+                void attach(gateway::dispatcher &d);
+
+                /*! Returns callbacks for a gateway::guild_stream that collect
+                 *  the streamed members, channels and roles of a GUILD_CREATE
+                 *  into one batch per guild. The batch is stored when #apply
+                 *  gets the trimmed GUILD_CREATE, in socket order, together
+                 *  with the guild and its threads, so that events read before
+                 *  it can't land on top of it. */
+                gateway::guild_stream_handlers stream_handlers();
+
+                pointer<types::guild> guild(snowflake id) const { return guilds.find(id); }
+                pointer<types::channel> channel(snowflake id) const { return channels.find(id); }
+                pointer<types::role> role(snowflake id) const { return roles.find(id); }
+                pointer<types::emoji> emoji(snowflake id) const { return emojis.find(id); }
+                pointer<types::guild_member> member(snowflake guild_id, snowflake user_id) const
+                {
+                    return members.find(member_key{guild_id, user_id});
+                }
+                /*! Returns the bot's own user, from READY */
+                pointer<types::user> self() const { return std::atomic_load(&self_user); }
+
+                /*! Returns every cached channel of a guild */
+                std::vector<pointer<types::channel>> guild_channels(snowflake guild_id) const;
+                /*! Returns every cached role of a guild */
+                std::vector<pointer<types::role>> guild_roles(snowflake guild_id) const;
+                /*! Returns every cached member of a guild */
+                std::vector<pointer<types::guild_member>> guild_members(snowflake guild_id) const;
+
+                entity_counts counts() const;
+
+                /*! Writes every cached entity to `path`. The file is written
+                 *  under a temporary name and renamed over `path` once
+                 *  complete, so an existing snapshot is never left half
+                 *  written. Throws std::system_error on I/O errors. */
+                void save_snapshot(const std::string &path) const;
+                /*! Adds the entities of a snapshot written by #save_snapshot,
+                 *  returning how many were read. Throws std::runtime_error if
+                 *  the file is corrupt or from an incompatible version, and
+                 *  std::system_error if it can't be read; in both cases the
+                 *  cache is left as it was. */
+                std::size_t load_snapshot(const std::string &path);
+                /*! Whether a guild's state comes from a snapshot, and hasn't
+                 *  been confirmed by a GUILD_CREATE yet */
+                bool is_stale(snowflake guild_id) const;
+                /*! Drops the members of a guild that nothing has confirmed
+                 *  since its last GUILD_CREATE, returning how many. Call it
+                 *  once a request for all of the guild's members completes,
+                 *  if member_count can't be relied on to do it. */
+                std::size_t drop_unconfirmed_members(snowflake guild_id);
+
+                /*! Incremented after every change to the cache; anything
+                 *  derived from cached state can be reused as long as this
+                 *  hasn't moved */
+                std::uint64_t generation() const { return current_generation; }
+                /*! Like #generation, but only moves on changes that may affect
+                 *  `guild_id`: its guild object, channels, roles, members or
+                 *  emojis (and events touching every guild, like READY). */
+                std::uint64_t generation(snowflake guild_id) const;
+
+            private:
+                template <typename T>
+                using entry = std::pair<snowflake, pointer<T>>;
+
+                void on_ready(const boost::json::object &d);
+                void on_guild_create(const boost::json::object &d);
+                void on_guild_delete(const boost::json::object &d);
+                void on_members(snowflake guild_id, const boost::json::array &members);
+                /*! Drops the unconfirmed members of a guild once the
+                 *  confirmed ones account for its member_count */
+                void reconcile_members(snowflake guild_id);
+                void on_emojis(snowflake guild_id, const boost::json::array &emojis);
+                /*! Drops every entity belonging to a guild; members are only
+                 *  dropped if `members` is set, since large guilds don't send
+                 *  their full member list in GUILD_CREATE */
+                void forget_guild(snowflake guild_id, bool members = true);
+                /*! Marks a guild as confirmed by the gateway */
+                void mark_fresh(snowflake guild_id);
+                /*! Stores the guild object itself, without its arrays */
+                void put_guild(const boost::json::object &d);
+
+                /*! Ids of the entities one guild owns, so that per-guild
+                 *  queries and #forget_guild don't scan whole tables */
+                struct guild_index
+                {
+                    snowflake_map<bool> channels;
+                    snowflake_map<bool> roles;
+                    snowflake_map<bool> emojis;
+                    /*! User ids */
+                    snowflake_map<bool> members;
+                    /*! Members kept through a GUILD_CREATE without a member
+                     *  list, and not seen since */
+                    snowflake_map<bool> unconfirmed;
+                };
+                using id_set = snowflake_map<bool> guild_index::*;
+
+                /*! Records that `guild_id` owns the entity `id` of a table */
+                void index_add(snowflake guild_id, id_set ids, snowflake id);
+                /*! Records every entity of a batch about to be stored */
+                template <typename Key, typename T>
+                void index_add(snowflake guild_id, id_set ids,
+                               const std::vector<std::pair<Key, pointer<T>>> &batch);
+                void index_remove(snowflake guild_id, id_set ids, snowflake id);
+                /*! Returns the ids a guild owns in a table */
+                std::vector<snowflake> indexed(snowflake guild_id, id_set ids) const;
+
+                /*! Moves #current_generation on, recording it as the last
+                 *  change to `guild_id` */
+                void touched(snowflake guild_id);
+                /*! Moves #current_generation on for every guild at once */
+                void touched_all();
+
+                rcu_table<snowflake, types::guild> guilds{16};
+                rcu_table<snowflake, types::channel> channels{64};
+                rcu_table<snowflake, types::role> roles{64};
+                rcu_table<snowflake, types::emoji> emojis{16};
+                rcu_table<member_key, types::guild_member, member_key_hash> members{256};
+                std::shared_ptr<const types::user> self_user;
+
+                /*! Kept alongside the tables rather than atomically with
+                 *  them: a guild_* query racing an update can miss an entity
+                 *  being added, and skips one being removed */
+                mutable std::mutex index_mutex;
+                snowflake_map<guild_index> by_guild;
+
+                /*! Entities received through #stream_handlers, waiting for the
+                 *  end of their guild */
+                struct staged_guild
+                {
+                    std::vector<entry<types::channel>> channels;
+                    std::vector<entry<types::role>> roles;
+                    std::vector<std::pair<member_key, pointer<types::guild_member>>> members;
+                };
+                std::mutex staging_mutex;
+                snowflake_map<staged_guild> staging;
+                /*! Finished batches, waiting for their trimmed GUILD_CREATE,
+                 *  oldest first */
+                snowflake_map<std::deque<staged_guild>> streamed;
+
+                /*! Guilds restored by #load_snapshot and not yet confirmed */
+                mutable std::mutex stale_mutex;
+                snowflake_map<bool> stale;
+
+                std::atomic<std::uint64_t> current_generation{0};
+                /*! Guards #guild_generations and #all_generation */
+                mutable std::mutex generation_mutex;
+                /*! The generation of each guild's last change */
+                snowflake_map<std::uint64_t> guild_generations;
+                /*! The generation of the last change to every guild */
+                std::uint64_t all_generation = 0;
+        }; // class entity_cache
+    } // namespace cache
+} // namespace discpp
+
+#endif
@@ -0,0 +1,182 @@
+/*! \file message_cache.hpp
+ *  \brief Memory-bounded cache of recent channel messages
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESSAGE_CACHE_HPP
+#define MESSAGE_CACHE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/json.hpp>
+#include <boost/optional.hpp>
+
+#include "core/dispatcher.hpp"
+#include "core/flat_map.hpp"
+#include "core/snowflake.hpp"
+#include "core/types.hpp"
+
+namespace discpp
+{
+    namespace cache
+    {
+        /*! Counters kept by a message_cache */
+        struct message_cache_stats
+        {
+            std::size_t bytes;
+            std::size_t messages;
+            std::size_t channels;
+            /*! Messages dropped to stay within the budgets */
+            std::uint64_t evictions;
+        };
+
+        class message_cache
+        {
+            /*! \class message_cache
+             *  \brief Recent messages per channel, under a global byte budget
+             *
+             *  Each channel keeps its messages in a ring ordered by id, fed by
+             *  MESSAGE_CREATE, and kept current by MESSAGE_UPDATE, _DELETE and
+             *  _DELETE_BULK. Rings hold at most `per_channel` messages, and
+             *  when all rings together exceed the byte budget, the oldest
+             *  messages of the least recently used channels go first.
+             *
+             *  Besides the messages, each channel tracks the id from which on
+             *  it is known to hold *every* message: the time the cache started
+             *  watching, pushed forward as old messages are evicted. Range
+             *  queries only answer when the requested range lies entirely
+             *  within that, and return boost::none otherwise, so a cached
+             *  answer is always the same as the API's. Call #reset_coverage
+             *  whenever events may have been missed (e.g. after a new session
+             *  rather than a resume).
+             *
+             *  Query results are newest first, like the API's. All members are
+             *  thread-safe.
+             */
+            public:
+                using pointer = std::shared_ptr<const types::message>;
+
+                /*! Same default and maximum as the API */
+                static constexpr std::size_t default_limit = 50;
+                static constexpr std::size_t max_limit = 100;
+
+                explicit message_cache(std::size_t byte_budget = 64 << 20,
+                                       std::size_t per_channel = 1000);
+
+                message_cache(const message_cache &) = delete;
+                message_cache &operator=(const message_cache &) = delete;
+
+                /*! Applies one gateway payload; non-message events are ignored */
+                void apply(const boost::json::value &payload);
+                /*! Registers #apply as a synchronous handler of the message
+                 *  events. The cache must outlive the dispatcher. */
+                void attach(gateway::dispatcher &d);
+
+                /*! Adds a message obtained elsewhere (e.g. from REST). This
+                 *  makes it findable, but doesn't extend the range the cache
+                 *  can answer queries for. */
+                void insert(pointer m);
+
+                pointer find(snowflake channel_id, snowflake message_id);
+
+                /*! The newest `limit` messages of a channel */
+                boost::optional<std::vector<pointer>> latest(snowflake channel_id,
+                                                             std::size_t limit = default_limit);
+                /*! The `limit` messages right before `id` */
+                boost::optional<std::vector<pointer>> before(snowflake channel_id, snowflake id,
+                                                             std::size_t limit = default_limit);
+                /*! The `limit` messages right after `id` */
+                boost::optional<std::vector<pointer>> after(snowflake channel_id, snowflake id,
+                                                            std::size_t limit = default_limit);
+                /*! Up to `limit` messages centred on `id`, with `id` itself
+                 *  counting towards the newer half */
+                boost::optional<std::vector<pointer>> around(snowflake channel_id, snowflake id,
+                                                             std::size_t limit = default_limit);
+
+                /*! Forgets which ranges are complete, keeping the messages;
+                 *  only messages from now on count as complete */
+                void reset_coverage();
+
+                message_cache_stats stats() const;
+
+            private:
+                struct channel_ring
+                {
+                    /*! Ascending by id */
+                    std::deque<pointer> messages;
+                    /*! Every message with an id from here on is in #messages */
+                    snowflake complete_from;
+                    std::size_t bytes = 0;
+                    std::list<snowflake>::iterator lru;
+                };
+
+                using ring_iterator = std::deque<pointer>::const_iterator;
+
+                /*! Returns a channel's ring, creating it if needed, and marks
+                 *  the channel as most recently used */
+                channel_ring &ring_for(snowflake channel_id);
+                /*! Like #ring_for, but never creates; nullptr if unknown */
+                channel_ring *touch(snowflake channel_id);
+                /*! Like #touch, but fills in and returns `empty` for unknown
+                 *  channels, so queries can treat them like any other */
+                const channel_ring &ring_or_empty(snowflake channel_id, channel_ring &empty);
+
+                void add(channel_ring &r, pointer m);
+                void remove(channel_ring &r, snowflake message_id);
+                void evict_oldest(channel_ring &r);
+                /*! Evicts from the least recently used channels until the
+                 *  cache is back within its byte budget */
+                void enforce_budget();
+                void drop_channel(snowflake channel_id);
+
+                /*! Whether `r` holds every message ever sent in the channel */
+                static bool has_full_history(const channel_ring &r, snowflake channel_id);
+                /*! The messages of [first, last), newest first */
+                static std::vector<pointer> newest_first(ring_iterator first, ring_iterator last);
+                /*! Up to `limit` messages right before `pos`, or none if the
+                 *  complete range doesn't reach back far enough */
+                static boost::optional<std::vector<pointer>> take_before(
+                    const channel_ring &r, snowflake channel_id, ring_iterator pos, std::size_t limit);
+
+                static std::size_t cost(const pointer &m);
+
+                const std::size_t budget;
+                const std::size_t per_channel;
+
+                mutable std::mutex mutex;
+                snowflake_map<std::unique_ptr<channel_ring>> channels;
+                /*! Most recently used channel first */
+                std::list<snowflake> lru;
+                /*! For channels whose ring was dropped altogether, where their
+                 *  complete range starts when they come back */
+                snowflake_map<snowflake> dropped;
+                /*! When the current coverage started */
+                snowflake started;
+                std::size_t total_bytes = 0;
+                std::size_t total_messages = 0;
+                std::uint64_t evictions = 0;
+        }; // class message_cache
+    } // namespace cache
+} // namespace discpp
+
+#endif
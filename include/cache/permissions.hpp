@@ -0,0 +1,198 @@
+/*! \file permissions.hpp
+ *  \brief Effective permissions of members, computed from the entity cache
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERMISSIONS_HPP
+#define PERMISSIONS_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "core/flat_map.hpp"
+#include "core/snowflake.hpp"
+#include "entity_cache.hpp"
+
+namespace discpp
+{
+    namespace cache
+    {
+        /*! Permission bits, as found in roles and overwrites */
+        namespace permission
+        {
+            constexpr std::uint64_t create_instant_invite     = 1ULL << 0;
+            constexpr std::uint64_t kick_members              = 1ULL << 1;
+            constexpr std::uint64_t ban_members               = 1ULL << 2;
+            constexpr std::uint64_t administrator             = 1ULL << 3;
+            constexpr std::uint64_t manage_channels           = 1ULL << 4;
+            constexpr std::uint64_t manage_guild              = 1ULL << 5;
+            constexpr std::uint64_t add_reactions             = 1ULL << 6;
+            constexpr std::uint64_t view_audit_log            = 1ULL << 7;
+            constexpr std::uint64_t priority_speaker          = 1ULL << 8;
+            constexpr std::uint64_t stream                    = 1ULL << 9;
+            constexpr std::uint64_t view_channel              = 1ULL << 10;
+            constexpr std::uint64_t send_messages             = 1ULL << 11;
+            constexpr std::uint64_t send_tts_messages         = 1ULL << 12;
+            constexpr std::uint64_t manage_messages           = 1ULL << 13;
+            constexpr std::uint64_t embed_links               = 1ULL << 14;
+            constexpr std::uint64_t attach_files              = 1ULL << 15;
+            constexpr std::uint64_t read_message_history      = 1ULL << 16;
+            constexpr std::uint64_t mention_everyone          = 1ULL << 17;
+            constexpr std::uint64_t use_external_emojis       = 1ULL << 18;
+            constexpr std::uint64_t view_guild_insights       = 1ULL << 19;
+            constexpr std::uint64_t connect                   = 1ULL << 20;
+            constexpr std::uint64_t speak                     = 1ULL << 21;
+            constexpr std::uint64_t mute_members              = 1ULL << 22;
+            constexpr std::uint64_t deafen_members            = 1ULL << 23;
+            constexpr std::uint64_t move_members              = 1ULL << 24;
+            constexpr std::uint64_t use_vad                   = 1ULL << 25;
+            constexpr std::uint64_t change_nickname           = 1ULL << 26;
+            constexpr std::uint64_t manage_nicknames          = 1ULL << 27;
+            constexpr std::uint64_t manage_roles              = 1ULL << 28;
+            constexpr std::uint64_t manage_webhooks           = 1ULL << 29;
+            constexpr std::uint64_t manage_guild_expressions  = 1ULL << 30;
+            constexpr std::uint64_t use_application_commands  = 1ULL << 31;
+            constexpr std::uint64_t request_to_speak          = 1ULL << 32;
+            constexpr std::uint64_t manage_events             = 1ULL << 33;
+            constexpr std::uint64_t manage_threads            = 1ULL << 34;
+            constexpr std::uint64_t create_public_threads     = 1ULL << 35;
+            constexpr std::uint64_t create_private_threads    = 1ULL << 36;
+            constexpr std::uint64_t use_external_stickers     = 1ULL << 37;
+            constexpr std::uint64_t send_messages_in_threads  = 1ULL << 38;
+            constexpr std::uint64_t use_embedded_activities   = 1ULL << 39;
+            constexpr std::uint64_t moderate_members          = 1ULL << 40;
+
+            /*! Every permission there is; what owners and administrators get */
+            constexpr std::uint64_t all = ~0ULL;
+        } // namespace permission
+
+        /*! Effective permissions of every cached member of a guild in one
+         *  channel, as parallel arrays */
+        struct channel_permissions
+        {
+            std::vector<snowflake> users;
+            std::vector<std::uint64_t> permissions;
+        };
+
+        class permission_engine
+        {
+            /*! \class permission_engine
+             *  \brief Computes what members may do, guild-wide and per channel
+             *
+             *  Permissions are worked out the way the API does: the owner and
+             *  administrators get everything; anyone else gets the union of
+             *  @everyone's and their roles' permissions, adjusted by the
+             *  channel's @everyone overwrite, then its role overwrites, then
+             *  its member overwrite. Without VIEW_CHANNEL in a channel, a
+             *  member can do nothing there. Threads use their parent
+             *  channel's overwrites.
+             *
+             *  Results are memoized per guild, and a guild's memo is dropped
+             *  whenever the cache's generation for that guild moves, i.e.
+             *  after any update to its roles, members, channels or the guild
+             *  itself; other guilds' memos are kept. Lookups return none when
+             *  the guild, channel or member isn't cached.
+             */
+            public:
+                /*! `entities` must outlive the engine */
+                explicit permission_engine(const entity_cache &entities);
+
+                permission_engine(const permission_engine &) = delete;
+                permission_engine &operator=(const permission_engine &) = delete;
+
+                /*! Guild-wide permissions of a member, before overwrites */
+                boost::optional<std::uint64_t> base_permissions(snowflake guild_id, snowflake user_id);
+                /*! Permissions of a member in a channel */
+                boost::optional<std::uint64_t> permissions(snowflake channel_id, snowflake user_id);
+                /*! Whether a member has all of `required` in a channel */
+                bool has(snowflake channel_id, snowflake user_id, std::uint64_t required);
+
+                /*! Computes the permissions of every cached member of the
+                 *  channel's guild in one pass over flat arrays, rather than
+                 *  member by member. Not memoized. */
+                channel_permissions bulk(snowflake channel_id) const;
+
+            private:
+                struct memo_key
+                {
+                    enum class kind : std::uint8_t
+                    {
+                        /*! Base permissions; #scope is the guild */
+                        guild,
+                        /*! Channel permissions; #scope is the channel */
+                        channel
+                    };
+
+                    kind type;
+                    snowflake scope;
+                    snowflake user;
+
+                    friend bool operator==(const memo_key &a, const memo_key &b)
+                    {
+                        // A guild's default channel may share the guild's id
+                        return a.type == b.type && a.scope == b.scope && a.user == b.user;
+                    }
+                };
+
+                struct memo_key_hash
+                {
+                    std::size_t operator()(const memo_key &k) const noexcept
+                    {
+                        const std::hash<snowflake> h;
+                        return (h(k.scope) + static_cast<std::size_t>(k.type)) ^
+                               (h(k.user) * 0x9E3779B97F4A7C15ULL);
+                    }
+                };
+
+                using memo_map = flat_hash_map<memo_key, std::uint64_t, memo_key_hash>;
+
+                /*! Results for one guild, valid as of #generation */
+                struct guild_memo
+                {
+                    std::uint64_t generation = 0;
+                    memo_map entries;
+                };
+
+                /*! Returns the memo of `guild_id`, emptied first if the cache
+                 *  has moved on to `generation`; expects #mutex to be held */
+                memo_map &memo_for(snowflake guild_id, std::uint64_t generation);
+                /*! Looks up a memoized result; expects #mutex to be held */
+                boost::optional<std::uint64_t> recall(snowflake guild_id, std::uint64_t generation,
+                                                      const memo_key &key);
+                /*! Memoizes a result computed from the state of `generation`,
+                 *  unless the guild has changed since */
+                void remember(snowflake guild_id, std::uint64_t generation,
+                              const memo_key &key, std::uint64_t p);
+                /*! The channel whose overwrites apply to `channel_id` */
+                entity_cache::pointer<types::channel> overwrite_source(snowflake channel_id) const;
+
+                const entity_cache &entities;
+
+                std::mutex mutex;
+                snowflake_map<guild_memo> memo;
+                /*! The guild of each channel looked up so far, which never
+                 *  changes; saves resolving it again to find its memo */
+                snowflake_map<snowflake> channel_guilds;
+        }; // class permission_engine
+    } // namespace cache
+} // namespace discpp
+
+#endif
@@ -0,0 +1,297 @@
+/*! \file rcu_table.hpp
+ *  \brief Sharded read-copy-update hash table
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RCU_TABLE_HPP
+#define RCU_TABLE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "core/flat_map.hpp"
+
+namespace discpp
+{
+    namespace cache
+    {
+        template <typename Key, typename T, typename Hash = std::hash<Key>>
+        class rcu_table
+        {
+            /*! \class rcu_table
+             *  \brief Hash table whose readers don't wait for its writers' work
+             *
+             *  Keys are spread over a power-of-two number of shards. Each shard
+             *  is an immutable flat_hash_map published through a shared_ptr:
+             *  readers atomically load the current map and look up in it, while
+             *  a writer copies the shard, changes the copy and publishes it.
+             *  Old maps are freed once their last reader lets go of them.
+             *
+             *  Values are held by shared_ptr<const T>, so copying a shard only
+             *  copies pointers, and a value found by a reader stays valid for
+             *  as long as the reader holds on to it, whatever writers do in
+             *  the meantime. Batched writes (#upsert_many, #erase_many,
+             *  #erase_if) copy each shard they touch once.
+             *
+             *  Writers to the same shard are serialized by a per-shard mutex,
+             *  which readers never take. This is not lock-free, though: the
+             *  standard library makes shared_ptr loads and stores atomic with a
+             *  small pool of spinlocks, held just long enough to copy the
+             *  pointer, so a reader can briefly contend with a writer
+             *  publishing (or with any other access hashing to the same lock).
+             *
+             *  Every write, even to one entry, copies the shard's pointers, so
+             *  a write costs O(size / shards). Size the shard count so shards
+             *  stay in the hundreds of entries.
+             */
+            public:
+                using pointer = std::shared_ptr<const T>;
+
+                explicit rcu_table(std::size_t shards = 64)
+                    : shard_count(round_up(shards)), shards(new shard[shard_count])
+                {
+                }
+
+                rcu_table(const rcu_table &) = delete;
+                rcu_table &operator=(const rcu_table &) = delete;
+
+                /*! Returns the value stored under `key`, or nullptr */
+                pointer find(const Key &key) const
+                {
+                    const std::shared_ptr<const map> m = load(shard_for(key));
+                    const pointer *p = m->find(key);
+                    return p ? *p : pointer();
+                }
+
+                /*! Stores `value` under `key`, replacing any previous value */
+                void upsert(const Key &key, pointer value)
+                {
+                    shard &s = shard_for(key);
+                    std::lock_guard<std::mutex> g(s.write);
+                    std::shared_ptr<map> next = std::make_shared<map>(*load(s));
+                    next->insert_or_assign(key, std::move(value));
+                    publish(s, std::move(next));
+                }
+
+                /*! Replaces the value under `key` with `f(old)`, where `old`
+                 *  is a pointer to the current value or nullptr. If `f`
+                 *  returns nullptr, the key is erased instead. The shard is
+                 *  locked while `f` runs, so it sees the latest value. */
+                template <typename F>
+                void update(const Key &key, F &&f)
+                {
+                    shard &s = shard_for(key);
+                    std::lock_guard<std::mutex> g(s.write);
+                    const std::shared_ptr<const map> current = load(s);
+                    const pointer *old = current->find(key);
+                    pointer value = f(old ? old->get() : static_cast<const T*>(nullptr));
+
+                    std::shared_ptr<map> next = std::make_shared<map>(*current);
+                    if (value)
+                    {
+                        next->insert_or_assign(key, std::move(value));
+                    }
+                    else if (!next->erase(key))
+                    {
+                        return;
+                    }
+                    publish(s, std::move(next));
+                }
+
+                /*! Stores every entry, copying each affected shard only once */
+                void upsert_many(std::vector<std::pair<Key, pointer>> entries)
+                {
+                    std::sort(entries.begin(), entries.end(),
+                        [this](const std::pair<Key, pointer> &a, const std::pair<Key, pointer> &b)
+                        {
+                            return index_of(a.first) < index_of(b.first);
+                        });
+
+                    auto it = entries.begin();
+                    while (it != entries.end())
+                    {
+                        const std::size_t i = index_of(it->first);
+                        shard &s = shards[i];
+                        std::lock_guard<std::mutex> g(s.write);
+                        std::shared_ptr<map> next = std::make_shared<map>(*load(s));
+                        for (; it != entries.end() && index_of(it->first) == i; ++it)
+                        {
+                            next->insert_or_assign(it->first, std::move(it->second));
+                        }
+                        publish(s, std::move(next));
+                    }
+                }
+
+                /*! Removes `key`, returning whether it was present */
+                bool erase(const Key &key)
+                {
+                    shard &s = shard_for(key);
+                    std::lock_guard<std::mutex> g(s.write);
+                    const std::shared_ptr<const map> current = load(s);
+                    if (!current->contains(key))
+                    {
+                        return false;
+                    }
+                    std::shared_ptr<map> next = std::make_shared<map>(*current);
+                    next->erase(key);
+                    publish(s, std::move(next));
+                    return true;
+                }
+
+                /*! Removes every key of `keys`, copying each affected shard
+                 *  only once. Returns how many were present. */
+                std::size_t erase_many(std::vector<Key> keys)
+                {
+                    std::sort(keys.begin(), keys.end(),
+                        [this](const Key &a, const Key &b) { return index_of(a) < index_of(b); });
+
+                    std::size_t erased = 0;
+                    auto it = keys.begin();
+                    while (it != keys.end())
+                    {
+                        const std::size_t i = index_of(*it);
+                        shard &s = shards[i];
+                        std::lock_guard<std::mutex> g(s.write);
+                        std::shared_ptr<map> next = std::make_shared<map>(*load(s));
+                        const std::size_t before = erased;
+                        for (; it != keys.end() && index_of(*it) == i; ++it)
+                        {
+                            erased += next->erase(*it);
+                        }
+                        if (erased != before)
+                        {
+                            publish(s, std::move(next));
+                        }
+                    }
+                    return erased;
+                }
+
+                /*! Removes every entry for which `pred(key, value)` is true.
+                 *  Shards without a match are left alone. */
+                template <typename Pred>
+                std::size_t erase_if(Pred &&pred)
+                {
+                    std::size_t erased = 0;
+                    for (std::size_t i = 0; i < shard_count; ++i)
+                    {
+                        shard &s = shards[i];
+                        std::lock_guard<std::mutex> g(s.write);
+                        const std::shared_ptr<const map> current = load(s);
+
+                        bool any = false;
+                        current->for_each([&](const Key &k, const pointer &v)
+                        {
+                            any = any || pred(k, *v);
+                        });
+                        if (!any)
+                        {
+                            continue;
+                        }
+                        std::shared_ptr<map> next = std::make_shared<map>(*current);
+                        erased += next->erase_if([&](const Key &k, const pointer &v)
+                        {
+                            return pred(k, *v);
+                        });
+                        publish(s, std::move(next));
+                    }
+                    return erased;
+                }
+
+                /*! Calls `f(key, pointer)` on every entry. Each shard is
+                 *  visited as of one point in time, but shards are not all
+                 *  captured at once. */
+                template <typename F>
+                void for_each(F &&f) const
+                {
+                    for (std::size_t i = 0; i < shard_count; ++i)
+                    {
+                        load(shards[i])->for_each(f);
+                    }
+                }
+
+                std::size_t size() const
+                {
+                    std::size_t n = 0;
+                    for (std::size_t i = 0; i < shard_count; ++i)
+                    {
+                        n += load(shards[i])->size();
+                    }
+                    return n;
+                }
+
+                void clear()
+                {
+                    for (std::size_t i = 0; i < shard_count; ++i)
+                    {
+                        std::lock_guard<std::mutex> g(shards[i].write);
+                        publish(shards[i], std::make_shared<map>());
+                    }
+                }
+
+            private:
+                using map = flat_hash_map<Key, pointer, Hash>;
+
+                struct shard
+                {
+                    std::shared_ptr<const map> current = std::make_shared<const map>();
+                    /*! Serializes writers; readers never take it */
+                    std::mutex write;
+                };
+
+                static std::size_t round_up(std::size_t n)
+                {
+                    std::size_t p = 1;
+                    while (p < n)
+                    {
+                        p *= 2;
+                    }
+                    return p;
+                }
+
+                static std::shared_ptr<const map> load(const shard &s)
+                {
+                    return std::atomic_load(&s.current);
+                }
+
+                static void publish(shard &s, std::shared_ptr<map> next)
+                {
+                    std::atomic_store(&s.current, std::shared_ptr<const map>(std::move(next)));
+                }
+
+                std::size_t index_of(const Key &key) const
+                {
+                    return Hash()(key) & (shard_count - 1);
+                }
+
+                shard &shard_for(const Key &key) const
+                {
+                    return shards[index_of(key)];
+                }
+
+                const std::size_t shard_count;
+                const std::unique_ptr<shard[]> shards;
+        }; // class rcu_table
+    } // namespace cache
+} // namespace discpp
+
+#endif
@@ -0,0 +1,118 @@
+/*! \file reaction_index.hpp
+ *  \brief Who reacted with what, kept current from gateway events
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef REACTION_INDEX_HPP
+#define REACTION_INDEX_HPP
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/json.hpp>
+#include <boost/optional.hpp>
+
+#include "core/dispatcher.hpp"
+#include "core/flat_map.hpp"
+#include "core/snowflake.hpp"
+
+namespace discpp
+{
+    namespace cache
+    {
+        class reaction_index
+        {
+            /*! \class reaction_index
+             *  \brief The users behind every reaction on recent messages
+             *
+             *  Only messages whose MESSAGE_CREATE the index has seen are
+             *  tracked: their reactions are then known from the first one on,
+             *  so answers are always complete. Reactions to older messages are
+             *  ignored, and queries about them return none. A READY (a new
+             *  session, after which reactions may have been missed) forgets
+             *  every tracked message.
+             *
+             *  Each message keeps one sorted array of user ids per emoji,
+             *  which is also the order the API pages reactions in. At most
+             *  `max_messages` are tracked; the oldest are forgotten first.
+             *  All members are thread-safe.
+             */
+            public:
+                explicit reaction_index(std::size_t max_messages = 100000);
+
+                reaction_index(const reaction_index &) = delete;
+                reaction_index &operator=(const reaction_index &) = delete;
+
+                /*! Applies one gateway payload; events other than READY,
+                 *  message creation, deletion and reactions are ignored */
+                void apply(const boost::json::value &payload);
+                /*! Registers #apply as a synchronous handler of the events it
+                 *  needs. The index must outlive the dispatcher. */
+                void attach(gateway::dispatcher &d);
+
+                /*! Whether reactions to `message_id` are being tracked */
+                bool tracks(snowflake message_id) const;
+
+                /*! Up to `limit` users who reacted with `emoji`, in id order,
+                 *  starting after `after` */
+                boost::optional<std::vector<snowflake>> users(snowflake message_id,
+                                                              boost::json::string_view emoji,
+                                                              snowflake after = snowflake(),
+                                                              std::size_t limit = 25) const;
+                /*! How many users reacted with `emoji` */
+                boost::optional<std::size_t> count(snowflake message_id,
+                                                   boost::json::string_view emoji) const;
+                /*! Every emoji on a message with its count, in the order they
+                 *  were first added */
+                boost::optional<std::vector<std::pair<std::string, std::size_t>>>
+                    counts(snowflake message_id) const;
+
+                /*! The key an emoji object is indexed under: the id of a custom
+                 *  emoji, or the character(s) of a unicode one */
+                static std::string emoji_key(const boost::json::object &emoji);
+
+            private:
+                struct tracked_message
+                {
+                    /*! Emoji keys, each with its sorted user ids */
+                    std::vector<std::pair<std::string, std::vector<snowflake>>> reactions;
+                };
+
+                void track(snowflake message_id);
+                void forget(snowflake message_id);
+                void add(snowflake message_id, std::string emoji, snowflake user_id);
+                void remove(snowflake message_id, const std::string &emoji, snowflake user_id);
+                void remove_emoji(snowflake message_id, const std::string &emoji);
+                void clear(snowflake message_id);
+
+                const std::size_t max_messages;
+
+                mutable std::mutex mutex;
+                snowflake_map<tracked_message> messages;
+                /*! Tracked message ids, oldest first; may hold ids already
+                 *  forgotten, which are skipped when evicting */
+                std::deque<snowflake> order;
+        }; // class reaction_index
+    } // namespace cache
+} // namespace discpp
+
+#endif
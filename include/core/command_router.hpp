@@ -0,0 +1,179 @@
+/*! \file command_router.hpp
+ *  \brief Routes MESSAGE_CREATEs to commands through a compiled trie
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMAND_ROUTER_HPP
+#define COMMAND_ROUTER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+#include <boost/optional.hpp>
+
+#include "dispatcher.hpp"
+#include "flat_map.hpp"
+#include "snowflake.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        class arguments
+        {
+            /*! \class arguments
+             *  \brief Splits a command's arguments on whitespace, lazily
+             *
+             *  "Double quoted" arguments may contain whitespace; they are
+             *  returned without their quotes, but otherwise as is (escapes are
+             *  not processed). Arguments are views into the message content,
+             *  so nothing is copied or allocated.
+             */
+            public:
+                explicit arguments(boost::json::string_view text) : text(text) {}
+
+                /*! Returns the next argument, or none past the last one */
+                boost::optional<boost::json::string_view> next();
+                /*! Returns everything not consumed yet, without leading
+                 *  whitespace */
+                boost::json::string_view rest() const;
+
+            private:
+                boost::json::string_view text;
+                std::size_t pos = 0;
+        };
+
+        /*! What a command handler gets to see */
+        struct command_context
+        {
+            /*! The whole MESSAGE_CREATE payload */
+            const boost::json::value &payload;
+            /*! Its "d" object, the message */
+            const boost::json::object &message;
+            snowflake guild_id;
+            snowflake channel_id;
+            snowflake author_id;
+            /*! The command's name as registered, even if an alias was used */
+            boost::json::string_view name;
+            /*! The content following the command */
+            boost::json::string_view args_text;
+
+            arguments args() const { return arguments(args_text); }
+        };
+
+        using command_handler = std::function<void(const command_context &ctx)>;
+
+        class command_router
+        {
+            /*! \class command_router
+             *  \brief Finds the command a message invokes in one pass over its
+             *  content
+             *
+             *  Command names and aliases are compiled into a trie laid out in
+             *  flat arrays. After the prefix, the content is walked through
+             *  the trie character by character, and the longest name that
+             *  ends on a word boundary wins, so names may have several words
+             *  ("config set") and share beginnings with others.
+             *
+             *  Each guild may have its own prefix; messages outside guilds,
+             *  and guilds without one, use the default prefix. Commands must
+             *  be added before the router is compiled (see #compile and
+             *  #attach); prefixes may change at any time.
+             */
+            public:
+                explicit command_router(std::string default_prefix = "!",
+                                        bool case_sensitive = false);
+
+                command_router(const command_router &) = delete;
+                command_router &operator=(const command_router &) = delete;
+
+                /*! Registers a command under `name` and each of `aliases`.
+                 *  Throws std::invalid_argument if a name is empty or taken,
+                 *  and std::logic_error once compiled. */
+                void add(boost::json::string_view name, command_handler handler,
+                         const std::vector<std::string> &aliases = {});
+
+                void set_prefix(snowflake guild_id, std::string prefix);
+                /*! Makes a guild use the default prefix again */
+                void reset_prefix(snowflake guild_id);
+
+                /*! Builds the trie; no commands can be added afterwards */
+                void compile();
+                /*! Compiles the router if needed, then registers #route as a
+                 *  MESSAGE_CREATE handler. The router must outlive the
+                 *  dispatcher. */
+                void attach(dispatcher &d, execution mode = execution::async);
+
+                /*! Runs the command a MESSAGE_CREATE payload invokes, if any;
+                 *  returns whether one ran. Messages by bots are ignored.
+                 *  Throws std::logic_error if the router isn't compiled. */
+                bool route(const boost::json::value &payload) const;
+
+                /*! Returns the index of the command `content` (with its prefix
+                 *  already removed) invokes, and where its arguments start.
+                 *  Throws std::logic_error if the router isn't compiled. */
+                boost::optional<std::pair<std::size_t, std::size_t>> match(
+                    boost::json::string_view content) const;
+
+            private:
+                struct command
+                {
+                    std::string name;
+                    command_handler handler;
+                };
+
+                /*! A trie node; its outgoing edges are
+                 *  #edge_labels / #edge_targets [first_edge, first_edge + edges),
+                 *  sorted by label */
+                struct node
+                {
+                    std::uint32_t first_edge = 0;
+                    std::uint32_t edges = 0;
+                    /*! Index into #commands of the name ending here, or -1 */
+                    std::int32_t command = -1;
+                };
+
+                /*! Prefix `content` starts with for `guild_id`, or none */
+                boost::optional<std::size_t> prefix_length(snowflake guild_id,
+                                                           boost::json::string_view content) const;
+                char fold(char c) const;
+
+                const std::string default_prefix;
+                const bool case_sensitive;
+
+                std::vector<command> commands;
+                /*! Every registered name and alias, with its command index;
+                 *  only needed until #compile */
+                std::vector<std::pair<std::string, std::size_t>> names;
+                bool compiled = false;
+
+                std::vector<node> nodes;
+                std::vector<char> edge_labels;
+                std::vector<std::uint32_t> edge_targets;
+
+                mutable std::mutex prefix_mutex;
+                snowflake_map<std::string> prefixes;
+        }; // class command_router
+    } // namespace gateway
+} // namespace discpp
+
+#endif
@@ -18,6 +18,7 @@
 #define DIS_HPP
 
 #include <string>
+#include <type_traits>
 #include <vector>
 
 // Required by boost::beast for async io
@@ -27,6 +28,8 @@
 
 #include <boost/json.hpp>
 
+#include "snowflake.hpp"
+
 namespace discpp
 {
     /*! \namespace discpp
@@ -34,15 +37,18 @@ namespace discpp
      */
 
     /*! Comparison operator for payload object data types that have an `id`
-     *  member
+     *  member. Restricted to JSON objects, since ADL would otherwise offer it
+     *  for any type with a discpp template argument (allocators, pairs...).
      */
-    template <typename T>
+    template <typename T, typename = typename std::enable_if<
+        std::is_same<T, boost::json::object>::value>::type>
     bool operator==(T& a, T& b)
     {
-        return a["id"].as_string() == b["id"].as_string();
+        return snowflake::from_json(a["id"]) == snowflake::from_json(b["id"]);
     }
 
-    // Let's add some semantic meaning to what kind of objects we're working with
+    // Let's add some semantic meaning to what kind of objects we're working with.
+    // These stay plain JSON objects; see types.hpp for compact typed versions.
 
     /*! Gateway payload object that represents a single Discord user */
     using user = boost::json::object;
@@ -60,7 +66,6 @@ namespace discpp
     using invite = boost::json::object;
     using message = boost::json::object;
     using reaction = boost::json::object;
-    using overwrite = boost::json::object;
     using embed = boost::json::object;
     using attachment = boost::json::object;
     using channel_mention = boost::json::object;
@@ -0,0 +1,148 @@
+/*! \file dispatcher.hpp
+ *  \brief Per-event handler registry for gateway dispatches
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DISPATCHER_HPP
+#define DISPATCHER_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+
+#include "events.hpp"
+#include "executor.hpp"
+#include "gateway.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        /*! Receives the full dispatch payload ({"op":0,"t":...,"s":...,"d":...}) */
+        using event_handler = std::function<void(const boost::json::value &payload)>;
+
+        /*! Where a handler runs */
+        enum class execution
+        {
+            /*! On the thread calling dispatcher::dispatch, before it returns,
+             *  in registration order. Use for cheap handlers and for anything
+             *  that must observe events in order (e.g. cache updates).
+             *  Exceptions are logged and swallowed, as for async handlers. */
+            sync,
+            /*! Posted to the dispatcher's worker pool; async handlers of one
+             *  event may run concurrently with each other and with later
+             *  events. */
+            async
+        };
+
+        class dispatcher
+        {
+            /*! \class dispatcher
+             *  \brief Routes dispatch events to the handlers registered for them
+             *
+             *  Handlers are looked up by event through a flat table indexed by
+             *  #event, which is resolved from the payload's "t" with a single
+             *  perfect-hash probe (see #to_event). Handlers registered for
+             *  event::unknown receive every event whose name isn't known.
+             *
+             *  Handlers must be registered before the first dispatch; the
+             *  registry itself is not synchronized.
+             *
+             *  By default async handlers run on a plain thread pool, in no
+             *  particular order. Built on a keyed_executor instead, they run
+             *  in order per guild (per channel for DMs; see
+             *  exec::ordering_key) and in parallel across guilds.
+             */
+            public:
+                /*! Creates a dispatcher whose async handlers run on `threads`
+                 *  workers */
+                explicit dispatcher(std::size_t threads = std::thread::hardware_concurrency());
+                /*! Creates a dispatcher whose async handlers run on `executor`,
+                 *  which must outlive it */
+                explicit dispatcher(exec::keyed_executor &executor);
+                /*! Waits for queued async handlers to finish, including those
+                 *  posted to a keyed_executor */
+                ~dispatcher();
+
+                dispatcher(const dispatcher &) = delete;
+                dispatcher &operator=(const dispatcher &) = delete;
+
+                void on(event e, event_handler handler, execution mode = execution::async);
+                /*! Registers a handler by gateway name, e.g. "MESSAGE_CREATE";
+                 *  throws std::invalid_argument if the name isn't known */
+                void on(boost::json::string_view name, event_handler handler,
+                        execution mode = execution::async);
+
+                /*! Runs the handlers for one message. Messages other than
+                 *  dispatches (op 0) are ignored. */
+                void dispatch(const message &msg);
+                /*! Pops and dispatches messages from `cxn` until #stop is
+                 *  called. Must be the only consumer of the connection's read
+                 *  queue. */
+                void run(connection &cxn);
+                /*! Makes #run return once it is done with its current message */
+                void stop();
+
+                /*! Returns every event that has at least one handler */
+                std::vector<event> registered_events() const;
+
+            private:
+                struct entry
+                {
+                    execution mode;
+                    /*! Shared with queued async calls, so they neither dangle
+                     *  when #handlers grows nor outlive the handler */
+                    std::shared_ptr<const event_handler> handler;
+                };
+
+                /*! Posts one async call to #executor, counted in #in_flight */
+                void post_to_executor(snowflake key, std::shared_ptr<const event_handler> handler,
+                                      std::shared_ptr<const boost::json::value> payload);
+
+                /*! Handlers, indexed by event */
+                std::array<std::vector<entry>, event_count> handlers;
+                /*! Whether any handler of each event is async, so sync-only
+                 *  events never allocate a shared payload */
+                std::array<bool, event_count> has_async{};
+                /*! Runs async handlers, unless #executor is set */
+                std::unique_ptr<boost::asio::thread_pool> pool;
+                /*! Runs async handlers in per-key order, if set */
+                exec::keyed_executor *executor = nullptr;
+                /*! Calls posted to #executor that haven't finished; guarded by
+                 *  #in_flight_mutex. The executor is shared, so the destructor
+                 *  waits on this rather than joining it. */
+                std::size_t in_flight = 0;
+                std::mutex in_flight_mutex;
+                std::condition_variable drained;
+                /*! Tracks whether #run should keep going */
+                std::atomic_bool keep_going{false};
+                /*! The connection #run is draining, so #stop can wake it */
+                std::atomic<connection*> running{nullptr};
+        }; // class dispatcher
+    } // namespace gateway
+} // namespace discpp
+
+#endif
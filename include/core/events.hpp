@@ -0,0 +1,120 @@
+/*! \file events.hpp
+ *  \brief Gateway dispatch event names
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENTS_HPP
+#define EVENTS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/json.hpp>
+
+// Every dispatch event we know by name, as X(enumerator, "NAME"). Keeping the
+// list in one place keeps the enum and the name table from drifting apart.
+#define DISCPP_GATEWAY_EVENTS(X) \
+    X(ready,                            "READY") \
+    X(resumed,                          "RESUMED") \
+    X(application_command_permissions_update, "APPLICATION_COMMAND_PERMISSIONS_UPDATE") \
+    X(auto_moderation_rule_create,      "AUTO_MODERATION_RULE_CREATE") \
+    X(auto_moderation_rule_update,      "AUTO_MODERATION_RULE_UPDATE") \
+    X(auto_moderation_rule_delete,      "AUTO_MODERATION_RULE_DELETE") \
+    X(auto_moderation_action_execution, "AUTO_MODERATION_ACTION_EXECUTION") \
+    X(channel_create,                   "CHANNEL_CREATE") \
+    X(channel_update,                   "CHANNEL_UPDATE") \
+    X(channel_delete,                   "CHANNEL_DELETE") \
+    X(channel_pins_update,              "CHANNEL_PINS_UPDATE") \
+    X(thread_create,                    "THREAD_CREATE") \
+    X(thread_update,                    "THREAD_UPDATE") \
+    X(thread_delete,                    "THREAD_DELETE") \
+    X(thread_list_sync,                 "THREAD_LIST_SYNC") \
+    X(thread_member_update,             "THREAD_MEMBER_UPDATE") \
+    X(thread_members_update,            "THREAD_MEMBERS_UPDATE") \
+    X(guild_create,                     "GUILD_CREATE") \
+    X(guild_update,                     "GUILD_UPDATE") \
+    X(guild_delete,                     "GUILD_DELETE") \
+    X(guild_audit_log_entry_create,     "GUILD_AUDIT_LOG_ENTRY_CREATE") \
+    X(guild_ban_add,                    "GUILD_BAN_ADD") \
+    X(guild_ban_remove,                 "GUILD_BAN_REMOVE") \
+    X(guild_emojis_update,              "GUILD_EMOJIS_UPDATE") \
+    X(guild_stickers_update,            "GUILD_STICKERS_UPDATE") \
+    X(guild_integrations_update,        "GUILD_INTEGRATIONS_UPDATE") \
+    X(guild_member_add,                 "GUILD_MEMBER_ADD") \
+    X(guild_member_remove,              "GUILD_MEMBER_REMOVE") \
+    X(guild_member_update,              "GUILD_MEMBER_UPDATE") \
+    X(guild_members_chunk,              "GUILD_MEMBERS_CHUNK") \
+    X(guild_role_create,                "GUILD_ROLE_CREATE") \
+    X(guild_role_update,                "GUILD_ROLE_UPDATE") \
+    X(guild_role_delete,                "GUILD_ROLE_DELETE") \
+    X(guild_scheduled_event_create,     "GUILD_SCHEDULED_EVENT_CREATE") \
+    X(guild_scheduled_event_update,     "GUILD_SCHEDULED_EVENT_UPDATE") \
+    X(guild_scheduled_event_delete,     "GUILD_SCHEDULED_EVENT_DELETE") \
+    X(guild_scheduled_event_user_add,   "GUILD_SCHEDULED_EVENT_USER_ADD") \
+    X(guild_scheduled_event_user_remove, "GUILD_SCHEDULED_EVENT_USER_REMOVE") \
+    X(integration_create,               "INTEGRATION_CREATE") \
+    X(integration_update,               "INTEGRATION_UPDATE") \
+    X(integration_delete,               "INTEGRATION_DELETE") \
+    X(interaction_create,               "INTERACTION_CREATE") \
+    X(invite_create,                    "INVITE_CREATE") \
+    X(invite_delete,                    "INVITE_DELETE") \
+    X(message_create,                   "MESSAGE_CREATE") \
+    X(message_update,                   "MESSAGE_UPDATE") \
+    X(message_delete,                   "MESSAGE_DELETE") \
+    X(message_delete_bulk,              "MESSAGE_DELETE_BULK") \
+    X(message_reaction_add,             "MESSAGE_REACTION_ADD") \
+    X(message_reaction_remove,          "MESSAGE_REACTION_REMOVE") \
+    X(message_reaction_remove_all,      "MESSAGE_REACTION_REMOVE_ALL") \
+    X(message_reaction_remove_emoji,    "MESSAGE_REACTION_REMOVE_EMOJI") \
+    X(presence_update,                  "PRESENCE_UPDATE") \
+    X(stage_instance_create,            "STAGE_INSTANCE_CREATE") \
+    X(stage_instance_update,            "STAGE_INSTANCE_UPDATE") \
+    X(stage_instance_delete,            "STAGE_INSTANCE_DELETE") \
+    X(typing_start,                     "TYPING_START") \
+    X(user_update,                      "USER_UPDATE") \
+    X(voice_state_update,               "VOICE_STATE_UPDATE") \
+    X(voice_server_update,              "VOICE_SERVER_UPDATE") \
+    X(webhooks_update,                  "WEBHOOKS_UPDATE")
+
+namespace discpp
+{
+    namespace gateway
+    {
+        enum class event : std::uint8_t
+        {
+#define DISCPP_EVENT_ENUMERATOR(id, name) id,
+            DISCPP_GATEWAY_EVENTS(DISCPP_EVENT_ENUMERATOR)
+#undef DISCPP_EVENT_ENUMERATOR
+            /*! Any event name not in the list above */
+            unknown
+        };
+
+        /*! Number of distinct #event values, including event::unknown */
+        constexpr std::size_t event_count = static_cast<std::size_t>(event::unknown) + 1;
+
+        /*! Returns the gateway name of an event, e.g. "MESSAGE_CREATE" */
+        boost::json::string_view event_name(event e);
+
+        /*! Maps a dispatch event name to its #event through a perfect hash
+         *  table built once from the known names; a lookup costs one hash of
+         *  the name and one string compare. */
+        event to_event(boost::json::string_view name);
+    } // namespace gateway
+} // namespace discpp
+
+#endif
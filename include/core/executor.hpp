@@ -0,0 +1,185 @@
+/*! \file executor.hpp
+ *  \brief Work-stealing thread pool and per-key serial executor
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "flat_map.hpp"
+#include "snowflake.hpp"
+
+namespace discpp
+{
+    namespace exec
+    {
+        using task = std::function<void()>;
+
+        class work_stealing_pool
+        {
+            /*! \class work_stealing_pool
+             *  \brief Thread pool with one task deque per worker
+             *
+             *  Tasks submitted from a worker go to the back of that worker's
+             *  own deque, and tasks submitted from other threads are spread
+             *  round-robin. Each worker runs its own deque front to back, so a
+             *  task that resubmits itself goes behind the work already
+             *  waiting. An idle worker steals from the back of the other
+             *  workers' deques before going to sleep.
+             *
+             *  Exceptions thrown by tasks are logged and swallowed.
+             */
+            public:
+                explicit work_stealing_pool(std::size_t threads = std::thread::hardware_concurrency());
+                /*! Runs every task already submitted, then joins the workers */
+                ~work_stealing_pool();
+
+                work_stealing_pool(const work_stealing_pool &) = delete;
+                work_stealing_pool &operator=(const work_stealing_pool &) = delete;
+
+                void submit(task t);
+                std::size_t size() const { return workers.size(); }
+                /*! Number of tasks taken from another worker's deque so far */
+                std::uint64_t steals() const { return steal_count; }
+
+            private:
+                struct worker_queue
+                {
+                    std::mutex mutex;
+                    std::deque<task> tasks;
+                };
+
+                void work(std::size_t index);
+                /*! Takes a task from our own deque, or steals one */
+                bool take(std::size_t index, task &out);
+
+                std::vector<std::unique_ptr<worker_queue>> queues;
+                std::vector<std::thread> workers;
+                /*! Next queue for submissions from outside the pool */
+                std::atomic<std::size_t> next_queue{0};
+                /*! Tasks submitted but not yet taken by a worker */
+                std::atomic<std::size_t> pending{0};
+                std::atomic<std::uint64_t> steal_count{0};
+                std::atomic_bool stopping{false};
+                /*! Used with #idle to put workers to sleep */
+                std::mutex idle_mutex;
+                std::condition_variable idle;
+        }; // class work_stealing_pool
+
+        /*! Queue depth counters for one key of a keyed_executor */
+        struct key_stats
+        {
+            snowflake key;
+            /*! Tasks currently waiting */
+            std::size_t depth;
+            /*! Largest depth seen so far */
+            std::size_t max_depth;
+            /*! Tasks run so far */
+            std::uint64_t executed;
+        };
+
+        class keyed_executor
+        {
+            /*! \class keyed_executor
+             *  \brief Runs tasks in order per key, and in parallel across keys
+             *
+             *  Each key gets a lane, which behaves like a strand: its tasks
+             *  run one at a time, in the order they were posted, while lanes
+             *  of different keys share the pool's workers. A busy lane gives
+             *  its worker back after #batch tasks so one hot key can't starve
+             *  the others.
+             *
+             *  A lane is dropped as soon as it runs dry, so keys that come and
+             *  go (DM channels, guilds the bot left) don't pile up. The
+             *  counters of dropped lanes are kept for the #retained keys with
+             *  the deepest queues seen, and picked up again if the key comes
+             *  back.
+             */
+            public:
+                /*! Tasks a lane runs before yielding its worker */
+                static constexpr std::size_t batch = 32;
+                /*! Dropped lanes whose counters are kept */
+                static constexpr std::size_t retained = 64;
+
+                explicit keyed_executor(std::size_t threads = std::thread::hardware_concurrency());
+
+                keyed_executor(const keyed_executor &) = delete;
+                keyed_executor &operator=(const keyed_executor &) = delete;
+
+                /*! Queues `t` behind every task previously posted for `key` */
+                void post(snowflake key, task t);
+
+                /*! Returns the counters of every live lane, and of the
+                 *  retained dropped ones (with a depth of zero) */
+                std::vector<key_stats> stats() const;
+                /*! Returns the counters of the `n` lanes with the deepest
+                 *  queues, deepest first */
+                std::vector<key_stats> hottest(std::size_t n) const;
+
+                work_stealing_pool &pool() { return workers; }
+
+            private:
+                struct lane
+                {
+                    explicit lane(snowflake key) : key(key) {}
+
+                    const snowflake key;
+                    std::mutex mutex;
+                    std::deque<task> tasks;
+                    /*! Whether a drain of this lane is queued or running */
+                    bool scheduled = false;
+                    std::size_t max_depth = 0;
+                    std::uint64_t executed = 0;
+                };
+
+                void drain(lane *l);
+                /*! Drops `l` if it is still empty; returns false if a task
+                 *  was posted to it in the meantime */
+                bool retire(lane *l);
+
+                /*! Guards #lanes and #history; each lane has its own mutex,
+                 *  always locked after this one */
+                mutable std::mutex lanes_mutex;
+                snowflake_map<std::unique_ptr<lane>> lanes;
+                /*! Counters of dropped lanes, at most #retained of them */
+                std::vector<key_stats> history;
+                /*! Declared last, so it is joined before the lanes go away */
+                work_stealing_pool workers;
+        }; // class keyed_executor
+
+        /*! Returns the key that orders a dispatch payload: the guild id, the
+         *  channel id for events outside guilds (DMs), the guild's own id for
+         *  GUILD_* events that carry it as "id", or zero for events tied to
+         *  neither (READY, USER_UPDATE...), which then share one lane. */
+        snowflake ordering_key(const boost::json::value &payload);
+    } // namespace exec
+} // namespace discpp
+
+#endif
@@ -0,0 +1,291 @@
+/*! \file flat_map.hpp
+ *  \brief Open-addressing hash map for id-indexed state
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLAT_MAP_HPP
+#define FLAT_MAP_HPP
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "snowflake.hpp"
+
+namespace discpp
+{
+    template <typename Key, typename T, typename Hash = std::hash<Key>>
+    class flat_hash_map
+    {
+        /*! \class flat_hash_map
+         *  \brief Linear probing hash map stored in two flat arrays
+         *
+         *  Entries live inline in one contiguous array (no per-node
+         *  allocations, no pointer chasing), with a parallel byte array
+         *  marking which slots are in use. Erasure shifts later entries of the
+         *  probe run back instead of leaving tombstones, so lookups never
+         *  degrade over time.
+         *
+         *  Key and T must be default constructible. Pointers returned by
+         *  find() and friends are invalidated by any insertion or erasure.
+         */
+        public:
+            using value_type = std::pair<Key, T>;
+
+            flat_hash_map() = default;
+
+            std::size_t size() const { return _size; }
+            bool empty() const { return _size == 0; }
+
+            /*! Returns a pointer to the value stored under `key`, or nullptr */
+            T *find(const Key &key)
+            {
+                const std::size_t i = locate(key);
+                return i == npos ? nullptr : &_slots[i].second;
+            }
+
+            const T *find(const Key &key) const
+            {
+                const std::size_t i = locate(key);
+                return i == npos ? nullptr : &_slots[i].second;
+            }
+
+            bool contains(const Key &key) const
+            {
+                return locate(key) != npos;
+            }
+
+            /*! Returns the value stored under `key`, default constructing it
+             *  first if needed */
+            T &operator[](const Key &key)
+            {
+                return *insert(key, T()).first;
+            }
+
+            /*! Inserts `value` under `key` unless the key is already present.
+             *  Returns the stored value and whether an insertion happened. */
+            std::pair<T*, bool> insert(const Key &key, T value)
+            {
+                const std::size_t found = locate(key);
+                if (found != npos)
+                {
+                    return {&_slots[found].second, false};
+                }
+                grow_if_needed();
+
+                std::size_t i = ideal(key);
+                while (_used[i])
+                {
+                    i = (i + 1) & mask();
+                }
+                _used[i] = 1;
+                _slots[i] = value_type(key, std::move(value));
+                ++_size;
+                return {&_slots[i].second, true};
+            }
+
+            /*! Stores `value` under `key`, replacing any previous value */
+            T &insert_or_assign(const Key &key, T value)
+            {
+                auto res = insert(key, T());
+                *res.first = std::move(value);
+                return *res.first;
+            }
+
+            /*! Removes `key`, returning whether it was present */
+            bool erase(const Key &key)
+            {
+                std::size_t i = locate(key);
+                if (i == npos)
+                {
+                    return false;
+                }
+                erase_slot(i);
+                return true;
+            }
+
+            /*! Removes every entry for which `pred(key, value)` is true */
+            template <typename Pred>
+            std::size_t erase_if(Pred &&pred)
+            {
+                std::size_t erased = 0;
+                std::size_t i = 0;
+                while (i < _slots.size())
+                {
+                    // Backward shifting may pull a later entry into slot i, so
+                    // only move on once slot i holds something we keep
+                    if (_used[i] && pred(_slots[i].first, _slots[i].second))
+                    {
+                        erase_slot(i);
+                        ++erased;
+                    }
+                    else
+                    {
+                        ++i;
+                    }
+                }
+                return erased;
+            }
+
+            /*! Calls `f(key, value)` for every entry, in no particular order */
+            template <typename F>
+            void for_each(F &&f)
+            {
+                for (std::size_t i = 0; i < _slots.size(); ++i)
+                {
+                    if (_used[i])
+                    {
+                        f(_slots[i].first, _slots[i].second);
+                    }
+                }
+            }
+
+            template <typename F>
+            void for_each(F &&f) const
+            {
+                for (std::size_t i = 0; i < _slots.size(); ++i)
+                {
+                    if (_used[i])
+                    {
+                        f(_slots[i].first, _slots[i].second);
+                    }
+                }
+            }
+
+            void clear()
+            {
+                _slots.clear();
+                _used.clear();
+                _size = 0;
+            }
+
+            /*! Makes room for at least `n` entries without rehashing */
+            void reserve(std::size_t n)
+            {
+                std::size_t capacity = 8;
+                while (capacity * max_load_num < n * max_load_den)
+                {
+                    capacity *= 2;
+                }
+                if (capacity > _slots.size())
+                {
+                    rehash(capacity);
+                }
+            }
+
+        private:
+            static constexpr std::size_t npos = std::size_t(-1);
+            /*! Maximum load factor, as a fraction (7/8) */
+            static constexpr std::size_t max_load_num = 7;
+            static constexpr std::size_t max_load_den = 8;
+
+            std::size_t mask() const { return _slots.size() - 1; }
+
+            std::size_t ideal(const Key &key) const
+            {
+                // Fibonacci hashing: spreads out hashes that only differ in
+                // their high bits
+                const std::uint64_t h =
+                    static_cast<std::uint64_t>(Hash()(key)) * 0x9E3779B97F4A7C15ULL;
+                return static_cast<std::size_t>(h >> 32) & mask();
+            }
+
+            std::size_t locate(const Key &key) const
+            {
+                if (_size == 0)
+                {
+                    return npos;
+                }
+                for (std::size_t i = ideal(key); _used[i]; i = (i + 1) & mask())
+                {
+                    if (_slots[i].first == key)
+                    {
+                        return i;
+                    }
+                }
+                return npos;
+            }
+
+            void erase_slot(std::size_t hole)
+            {
+                // Shift later members of the probe run back into the hole,
+                // unless they'd end up before their ideal slot
+                std::size_t j = hole;
+                for (;;)
+                {
+                    j = (j + 1) & mask();
+                    if (!_used[j])
+                    {
+                        break;
+                    }
+                    const std::size_t k = ideal(_slots[j].first);
+                    const bool stays = (hole <= j) ? (hole < k && k <= j)
+                                                   : (hole < k || k <= j);
+                    if (!stays)
+                    {
+                        _slots[hole] = std::move(_slots[j]);
+                        hole = j;
+                    }
+                }
+                _used[hole] = 0;
+                _slots[hole] = value_type();
+                --_size;
+            }
+
+            void grow_if_needed()
+            {
+                if ((_size + 1) * max_load_den > _slots.size() * max_load_num)
+                {
+                    rehash(_slots.empty() ? 8 : _slots.size() * 2);
+                }
+            }
+
+            void rehash(std::size_t capacity)
+            {
+                std::vector<value_type> old_slots(capacity);
+                std::vector<std::uint8_t> old_used(capacity, 0);
+                old_slots.swap(_slots);
+                old_used.swap(_used);
+
+                for (std::size_t i = 0; i < old_slots.size(); ++i)
+                {
+                    if (old_used[i])
+                    {
+                        std::size_t j = ideal(old_slots[i].first);
+                        while (_used[j])
+                        {
+                            j = (j + 1) & mask();
+                        }
+                        _used[j] = 1;
+                        _slots[j] = std::move(old_slots[i]);
+                    }
+                }
+            }
+
+            std::vector<value_type> _slots;
+            std::vector<std::uint8_t> _used;
+            std::size_t _size = 0;
+    };
+
+    /*! The map used for all snowflake-indexed state */
+    template <typename T>
+    using snowflake_map = flat_hash_map<snowflake, T>;
+} // namespace discpp
+
+#endif
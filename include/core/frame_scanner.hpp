@@ -0,0 +1,69 @@
+/*! \file frame_scanner.hpp
+ *  \brief Lightweight scanner for gateway payload headers
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SCANNER_HPP
+#define FRAME_SCANNER_HPP
+
+#include <cstdint>
+
+#include <boost/json.hpp>
+#include <boost/optional.hpp>
+
+namespace discpp
+{
+    namespace gateway
+    {
+        /*! The routing fields of a gateway payload, read without parsing `d` */
+        struct frame_header
+        {
+            /*! The payload opcode, or -1 if the frame didn't carry one */
+            std::int64_t op = -1;
+            /*! The sequence number, for dispatch payloads */
+            boost::optional<std::int64_t> s;
+            /*! The dispatch event name, pointing into the scanned frame; empty
+             *  for non-dispatch payloads */
+            boost::json::string_view t;
+        };
+
+        /*! Extracts `op`, `s` and `t` from the top level of a raw gateway
+         *  frame without building a DOM.
+         *
+         *  Nested values are skipped over rather than decoded, and scanning
+         *  stops as soon as all three fields have been seen; since Discord
+         *  sends them ahead of `d`, the event body usually isn't touched at all.
+         *
+         *  Returns false if the frame isn't a well-formed JSON object as far as
+         *  the scanner got. `header` may be partially filled in that case.
+         */
+        bool peek_header(boost::json::string_view frame, frame_header &header);
+
+        /*! Finds the member `key` at the top level of the JSON object held in
+         *  `object`, using the same skipping scanner as #peek_header, and
+         *  points `value` at its raw JSON text (strings keep their quotes).
+         *
+         *  Returns false if the key is missing or the text is malformed.
+         */
+        bool peek_member(boost::json::string_view object,
+                         boost::json::string_view key,
+                         boost::json::string_view &value);
+    } // namespace gateway
+} // namespace discpp
+
+#endif
@@ -19,6 +19,7 @@
 
 #include <array>
 #include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -41,7 +42,11 @@
 #include <boost/beast/ssl.hpp>
 #include <boost/beast/websocket/ssl.hpp>
 
+#include "frame_scanner.hpp"
+#include "identify.hpp"
 #include "priority_queue.hpp"
+#include "reorder_buffer.hpp"
+#include "session_store.hpp"
 #include "dis.hpp"
 
 
@@ -75,6 +80,21 @@ namespace discpp
             boost::optional<std::chrono::time_point<std::chrono::steady_clock>>
                 >;
 
+        /*! Counters kept by the pre-parse event filter */
+        struct filter_stats
+        {
+            /*! Dispatch frames dropped before being parsed */
+            std::uint64_t frames_skipped;
+            /*! Total size of the dropped frames */
+            std::uint64_t bytes_skipped;
+        };
+
+        /*! Handler given first look at each raw frame that passed the event
+         *  filter; returns true if it consumed the frame, in which case the
+         *  frame is neither parsed nor queued. */
+        using raw_handler = std::function<bool(boost::json::string_view frame,
+                                               const frame_header &header)>;
+
         class connection : public std::enable_shared_from_this<connection>
         {
             /*! \class connection
@@ -100,10 +120,66 @@ namespace discpp
                     std::string encoding = "json",
                     bool use_compression = false
                     );
+                /*! Finishes a pending session save, if any */
+                ~connection();
                 // connection(connection &&) = default;
                 static void init_logger();
                 void main_loop();
+                /*! Moves JSON decoding of incoming frames off the connection's
+                 *  strand and onto a pool of `threads` workers. Must be called
+                 *  before #main_loop. */
+                void enable_parse_offload(std::size_t threads);
+                /*! Only dispatch events named in `events` will be parsed and
+                 *  queued; all others are dropped after their sequence number is
+                 *  recorded. An empty list (the default) accepts everything.
+                 *  READY and RESUMED are always accepted, as the connection
+                 *  needs them itself. Must be called before #main_loop. */
+                void set_event_filter(std::vector<std::string> events);
+                filter_stats get_filter_stats() const;
+                /*! Installs a #raw_handler, e.g. one that walks frames with an
+                 *  ondemand::document instead of building a DOM. It runs on the
+                 *  connection's strand, and the frame is only valid for the
+                 *  duration of the call. Must be called before #main_loop. */
+                void set_raw_handler(raw_handler handler);
+                /*! Returns the installed #raw_handler, for chaining */
+                const raw_handler &get_raw_handler() const;
+                /*! Runs `parse` on the parse pool, if offloading is enabled,
+                 *  and queues its result in the order parse_in_order was
+                 *  called, along with the frames parsed by the connection
+                 *  itself. A #raw_handler that consumes a frame but still
+                 *  produces a message queues it through here. A parse that
+                 *  throws or returns none queues nothing, but doesn't hold
+                 *  back the frames after it. Only call on the strand. */
+                void parse_in_order(std::function<boost::optional<message>()> parse);
+                /*! Returns the last sequence number seen, or -1 if none yet */
+                std::int64_t sequence() const;
+                /*! Keeps the session of this connection in `store`, as shard
+                 *  `shard`: it is saved on READY and RESUMED, at most every
+                 *  `interval` while events arrive, and dropped when the
+                 *  gateway invalidates it. Saves sync the file to disk, so
+                 *  they run on a writer thread of their own. The store must
+                 *  outlive the connection. Must be called before #main_loop. */
+                void use_session_store(session_store &store, std::uint32_t shard,
+                                       std::chrono::seconds interval = std::chrono::seconds(5));
+                /*! Adopts a session loaded from a #session_store, so that the
+                 *  connection continues its sequence numbers. Connect to its
+                 *  resume_url, then send resume_payload() instead of
+                 *  IDENTIFY. */
+                void restore_session(const session_state &state);
+                /*! Returns the current session; its id is empty until READY */
+                session_state session() const;
+                /*! Saves the session to the store right away, e.g. on
+                 *  shutdown. Does nothing without a store or a session. */
+                void save_session();
                 context& get_context();
+                /*! Queues an IDENTIFY built from `options`, for the events
+                 *  `handlers` will dispatch; throws std::invalid_argument if
+                 *  the options aren't valid, or if `handlers` has handlers for
+                 *  events the requested intents don't cover (see
+                 *  check_intents) */
+                void identify(const identify_options &options, const dispatcher &handlers);
+                /*! Queues a presence update */
+                void update_presence(const presence &p);
                 // Direct interfaces
                 message pop();
                 void push(message);
@@ -119,6 +195,23 @@ namespace discpp
 
                 void start_reading();
                 void start_writing();
+                /*! Swaps in a fresh #read_buffer and issues the next async_read */
+                void queue_read();
+                /*! Whether a frame with the given header passes #event_filter */
+                bool wants_frame(const frame_header &header) const;
+
+                /*! Parses a raw gateway frame and attaches its deadline;
+                 *  throws if the frame isn't a gateway payload */
+                message parse_frame(const std::string &frame);
+                /*! Runs `parse`, logging and swallowing anything it throws */
+                boost::optional<message> parse_or_skip(const std::function<boost::optional<message>()> &parse);
+                /*! Keeps the session up to date with a frame's header; only
+                 *  READY and INVALID_SESSION frames are looked into */
+                void track_session(boost::json::string_view frame, const frame_header &header);
+                /*! Asks #session_writer for a save */
+                void request_session_save();
+                /*! Body of #session_writer */
+                void write_sessions();
 
                 /*! Tracks whether we currently have a pending write; used by
                  *  #cv_pending_write */
@@ -132,10 +225,51 @@ namespace discpp
                 std::string gateway_url;
                 /*! Stores the session id sent by the gateway during READY events */
                 std::string session_id;
+                /*! Stores the resume_gateway_url sent along with #session_id */
+                std::string resume_url;
+                /*! Guards #session_id and #resume_url */
+                mutable std::mutex session_mutex;
+                /*! Where to persist the session, if anywhere */
+                session_store *sessions = nullptr;
+                std::uint32_t shard_id = 0;
+                std::chrono::seconds session_save_interval{5};
+                /*! When the session was last saved; only touched on the strand */
+                std::chrono::steady_clock::time_point last_session_save;
+                /*! Runs the saves requested through #request_session_save */
+                std::thread session_writer;
+                /*! Guards #save_requested and #stop_session_writer */
+                std::mutex save_mutex;
+                std::condition_variable save_wanted;
+                /*! Whether a save is due. Requests made while a save runs
+                 *  fold into one more save, which reads the session when it
+                 *  starts and so covers all of them. */
+                bool save_requested = false;
+                bool stop_session_writer = false;
+                /*! Serializes #save_session, since saves of one shard share a
+                 *  temporary file */
+                std::mutex session_io_mutex;
                 /*! Tracks whether we should keep running the gateway event loop */
                 std::atomic_bool keep_going;
                 /*! Stores incoming data that has yet to be parsed */
                 std::unique_ptr<boost::beast::flat_buffer> read_buffer;
+                /*! Last sequence number received from the gateway */
+                std::atomic<std::int64_t> last_sequence;
+                /*! Sorted allow-list of dispatch event names; empty means all */
+                std::vector<std::string> event_filter;
+                /*! Optional consumer of raw frames; see #set_raw_handler */
+                raw_handler raw_frame_handler;
+                /*! Number of dispatch frames dropped by #event_filter */
+                std::atomic<std::uint64_t> frames_skipped;
+                /*! Number of bytes dropped by #event_filter */
+                std::atomic<std::uint64_t> bytes_skipped;
+                /*! Number of frames handed to #parse_pool so far; only touched
+                 *  on the strand */
+                std::uint64_t read_sequence = 0;
+                /*! Worker pool used to parse frames, if offloading is enabled */
+                std::unique_ptr<boost::asio::thread_pool> parse_pool;
+                /*! Puts frames parsed by #parse_pool back into socket order;
+                 *  none marks a frame that yielded no message */
+                queue::reorder_buffer<boost::optional<message>> parse_reorder;
 
                 /*! Stores the context associated with the current connection */
                 context &discpp_context;
@@ -0,0 +1,94 @@
+/*! \file guild_stream.hpp
+ *  \brief Streaming ingestion of large GUILD_CREATE payloads
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GUILD_STREAM_HPP
+#define GUILD_STREAM_HPP
+
+#include <functional>
+
+#include <boost/json.hpp>
+
+#include "dis.hpp"
+#include "gateway.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        /*! Callbacks receiving the pieces of a streamed GUILD_CREATE. Each
+         *  element callback is given the guild's id (as its raw string) and
+         *  ownership of one array element; any of them may be left empty. */
+        struct guild_stream_handlers
+        {
+            std::function<void(boost::json::string_view, ::discpp::guild_member &&)> on_member;
+            std::function<void(boost::json::string_view, ::discpp::channel &&)> on_channel;
+            std::function<void(boost::json::string_view, ::discpp::role &&)> on_role;
+            std::function<void(boost::json::string_view, ::discpp::presence_update &&)> on_presence;
+            /*! Called last, with the guild object minus the streamed arrays */
+            std::function<void(::discpp::guild &&)> on_guild;
+        };
+
+        class guild_stream
+        {
+            /*! \class guild_stream
+             *  \brief SAX-style GUILD_CREATE decoder
+             *
+             *  Instead of parsing a GUILD_CREATE into a single DOM, the frame
+             *  is run through a boost::json::basic_parser, and every element of
+             *  `d.members`, `d.channels`, `d.roles` and `d.presences` is built
+             *  and handed off on its own as soon as its closing bracket is
+             *  seen. Peak memory is therefore the frame itself plus one element,
+             *  rather than a multiple of the payload size.
+             */
+            public:
+                explicit guild_stream(guild_stream_handlers handlers);
+
+                /*! Streams one complete GUILD_CREATE payload (the whole gateway
+                 *  frame). Throws boost::system::system_error if the frame is
+                 *  not valid JSON; callbacks already made are not undone. */
+                void feed(boost::json::string_view frame);
+
+                /*! Installs this stream as `cxn`'s raw frame handler. GUILD_CREATE
+                 *  frames are streamed through the callbacks, after which a
+                 *  trimmed GUILD_CREATE (see #guild_stream_handlers::on_guild)
+                 *  is pushed onto the connection's read queue in place of the
+                 *  full one; all other frames pass through untouched.
+                 *
+                 *  Streaming runs where the connection parses frames: on its
+                 *  parse pool if offloading is enabled, so the callbacks may
+                 *  run on several pool threads at once for different guilds.
+                 *  The trimmed event is queued in socket order either way.
+                 *  The stream must outlive the connection's read loop. Any
+                 *  raw handler already installed is kept and gets every
+                 *  other frame.
+                 */
+                void install(connection &cxn);
+
+            private:
+                /*! Streams one GUILD_CREATE frame and returns the trimmed
+                 *  event, with sequence number `s` */
+                message stream(boost::json::string_view frame, boost::optional<std::int64_t> s);
+
+                guild_stream_handlers handlers;
+        };
+    } // namespace gateway
+} // namespace discpp
+
+#endif
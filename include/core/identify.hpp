@@ -0,0 +1,153 @@
+/*! \file identify.hpp
+ *  \brief IDENTIFY and presence payloads, and gateway intents
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDENTIFY_HPP
+#define IDENTIFY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+#include <boost/optional.hpp>
+
+#include "events.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        class dispatcher;
+
+        /*! The gateway intents; each one subscribes to a group of events */
+        enum class intent : std::uint32_t
+        {
+            guilds                        = 1 << 0,
+            guild_members                 = 1 << 1,  // privileged
+            guild_moderation              = 1 << 2,
+            guild_expressions             = 1 << 3,
+            guild_integrations            = 1 << 4,
+            guild_webhooks                = 1 << 5,
+            guild_invites                 = 1 << 6,
+            guild_voice_states            = 1 << 7,
+            guild_presences               = 1 << 8,  // privileged
+            guild_messages                = 1 << 9,
+            guild_message_reactions       = 1 << 10,
+            guild_message_typing          = 1 << 11,
+            direct_messages               = 1 << 12,
+            direct_message_reactions      = 1 << 13,
+            direct_message_typing         = 1 << 14,
+            message_content               = 1 << 15, // privileged
+            guild_scheduled_events        = 1 << 16,
+            auto_moderation_configuration = 1 << 20,
+            auto_moderation_execution     = 1 << 21
+        };
+
+        class intents
+        {
+            /*! \class intents
+             *  \brief A set of #intent values, as sent in IDENTIFY
+             *
+             *  Build one with `|`, e.g.
+             *  `intent::guilds | intent::guild_messages`.
+             */
+            public:
+                constexpr intents() = default;
+                constexpr intents(intent i) : bits(static_cast<std::uint32_t>(i)) {}
+                constexpr explicit intents(std::uint32_t bits) : bits(bits) {}
+
+                /*! Every non-privileged intent */
+                static constexpr intents unprivileged()
+                {
+                    return intents(0x317EFD);
+                }
+
+                constexpr std::uint32_t value() const { return bits; }
+                constexpr bool contains(intents other) const { return (bits & other.bits) == other.bits; }
+                /*! Whether any of `other`'s intents is in the set */
+                constexpr bool intersects(intents other) const { return (bits & other.bits) != 0; }
+                constexpr bool empty() const { return bits == 0; }
+
+                friend constexpr intents operator|(intents a, intents b) { return intents(a.bits | b.bits); }
+                friend constexpr intents operator&(intents a, intents b) { return intents(a.bits & b.bits); }
+                friend constexpr bool operator==(intents a, intents b) { return a.bits == b.bits; }
+                friend constexpr bool operator!=(intents a, intents b) { return a.bits != b.bits; }
+
+            private:
+                std::uint32_t bits = 0;
+        };
+
+        constexpr intents operator|(intent a, intent b) { return intents(a) | intents(b); }
+
+        /*! Returns the intents that cause `e` to be sent: any one of them is
+         *  enough. Empty for events that are always sent, like READY. */
+        intents intents_for(event e);
+
+        /*! Returns the events of `events` that none of `requested` cover, and
+         *  so will never arrive */
+        std::vector<event> uncovered_events(const std::vector<event> &events, intents requested);
+
+        /*! Throws std::invalid_argument, naming the events, if `d` has
+         *  handlers for events that `requested` doesn't cover */
+        void check_intents(const dispatcher &d, intents requested);
+
+        /*! The bot's presence, as set in IDENTIFY or by a presence update */
+        struct presence
+        {
+            /*! "online", "dnd", "idle", "invisible" or "offline" */
+            std::string status = "online";
+            /*! Activity objects, as documented by the API */
+            boost::json::array activities;
+            bool afk = false;
+            /*! When the client went idle, in ms since the Unix epoch */
+            boost::optional<std::uint64_t> since;
+
+            boost::json::object to_json() const;
+        };
+
+        /*! What's sent in an IDENTIFY */
+        struct identify_options
+        {
+            std::string token;
+            intents requested = intents::unprivileged();
+            /*! Member count from which on guilds only send online members in
+             *  GUILD_CREATE; between 50 and 250 */
+            std::uint32_t large_threshold = 50;
+            std::uint32_t shard_id = 0;
+            std::uint32_t shard_count = 1;
+            boost::optional<presence> initial_presence;
+            std::string os = "linux";
+            std::string library = "discpp";
+
+            /*! Throws std::invalid_argument if the options can't be sent as
+             *  they are */
+            void validate() const;
+        };
+
+        /*! Builds the op 2 IDENTIFY payload; validates the options first.
+         *  Payload compression is never asked for, since nothing on the read
+         *  path inflates it. */
+        boost::json::object identify_payload(const identify_options &options);
+        /*! Builds the op 3 PRESENCE_UPDATE payload */
+        boost::json::object presence_payload(const presence &p);
+    } // namespace gateway
+} // namespace discpp
+
+#endif
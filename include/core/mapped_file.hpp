@@ -0,0 +1,72 @@
+/*! \file mapped_file.hpp
+ *  \brief Read-only memory-mapped files
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+#include <boost/json.hpp>
+
+namespace discpp
+{
+    class mapped_file
+    {
+        /*! \class mapped_file
+         *  \brief Maps a whole file into memory, read-only, for as long as the
+         *  object lives
+         *
+         *  The file's pages are loaded by the kernel on first access, and are
+         *  shared with the page cache rather than copied.
+         */
+        public:
+            enum class access_hint
+            {
+                normal,
+                /*! The file will be read front to back */
+                sequential,
+                random
+            };
+
+            /*! Maps `path`; throws std::system_error if it can't be opened
+             *  or mapped */
+            explicit mapped_file(const std::string &path,
+                                 access_hint hint = access_hint::normal);
+            ~mapped_file();
+
+            mapped_file(mapped_file &&other) noexcept;
+            mapped_file &operator=(mapped_file &&other) noexcept;
+            mapped_file(const mapped_file &) = delete;
+            mapped_file &operator=(const mapped_file &) = delete;
+
+            const char *data() const { return _data; }
+            std::size_t size() const { return _size; }
+            boost::json::string_view view() const { return boost::json::string_view(_data, _size); }
+
+        private:
+            void unmap();
+
+            const char *_data = nullptr;
+            std::size_t _size = 0;
+    };
+} // namespace discpp
+
+#endif
@@ -0,0 +1,162 @@
+/*! \file member_requester.hpp
+ *  \brief Requests for guild members, answered in GUILD_MEMBERS_CHUNKs
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEMBER_REQUESTER_HPP
+#define MEMBER_REQUESTER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "dispatcher.hpp"
+#include "gateway.hpp"
+#include "snowflake.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        /*! What to ask for in a REQUEST_GUILD_MEMBERS (op 8) */
+        struct member_request
+        {
+            snowflake guild_id;
+            /*! Members whose username starts with this; empty with a limit of
+             *  0 asks for every member (needs the guild_members intent) */
+            std::string query;
+            std::uint32_t limit = 0;
+            /*! Specific members to fetch; replaces #query if not empty */
+            std::vector<snowflake> user_ids;
+            /*! Whether to include the members' presences */
+            bool presences = false;
+        };
+
+        /*! Receives the "d" object of each GUILD_MEMBERS_CHUNK answering a
+         *  request, as it arrives */
+        using chunk_handler = std::function<void(const boost::json::object &chunk)>;
+
+        class member_requester
+        {
+            /*! \class member_requester
+             *  \brief Sends member requests on one shard and follows their
+             *  chunks to completion
+             *
+             *  Every request carries a nonce, which the gateway echoes in each
+             *  chunk of its answer; chunks are matched to their request by it,
+             *  handed to the request's handler, and tracked by chunk_index
+             *  (a repeated chunk is ignored). A request is complete once every
+             *  index below chunk_count has arrived, which resolves its future
+             *  with the number of members received.
+             *
+             *  A request that goes `timeout` without a chunk fails, and so
+             *  does every request once the session is lost (a new READY, or
+             *  an INVALID_SESSION that can't be resumed), since their answers
+             *  will never come. Either way its slot goes to the next queued
+             *  request. Deadlines are checked whenever a frame arrives, so
+             *  heartbeat ACKs keep them moving on an otherwise quiet shard.
+             *
+             *  Large guilds answer with hundreds of chunks, so at most
+             *  `max_in_flight` requests are outstanding at once; later ones
+             *  wait in a queue and are sent as earlier ones complete.
+             *
+             *  Chunks don't need a handler to reach the cache: an
+             *  entity_cache attached to the same dispatcher stores every
+             *  chunk's members itself.
+             */
+            public:
+                /*! `cxn` must outlive the requester */
+                explicit member_requester(connection &cxn, std::size_t max_in_flight = 2,
+                                          std::chrono::steady_clock::duration timeout =
+                                              std::chrono::seconds(30));
+
+                member_requester(const member_requester &) = delete;
+                member_requester &operator=(const member_requester &) = delete;
+
+                /*! Registers #apply as a synchronous GUILD_MEMBERS_CHUNK
+                 *  handler, and chains a raw handler onto the connection (see
+                 *  connection::set_raw_handler) that watches for session loss
+                 *  and deadlines. Must be called before the connection's
+                 *  main_loop. The requester must outlive the dispatcher and
+                 *  the connection's reads. */
+                void attach(dispatcher &d);
+                /*! Feeds one gateway payload; anything but a chunk answering
+                 *  one of our requests is ignored */
+                void apply(const boost::json::value &payload);
+
+                /*! Queues a request, sending it right away if fewer than
+                 *  `max_in_flight` are outstanding. `on_chunk` (which may be
+                 *  empty) is called from the thread feeding #apply. */
+                std::future<std::size_t> request(member_request req, chunk_handler on_chunk = {});
+
+                /*! Fails every outstanding and queued request, e.g. after the
+                 *  session was lost and their answers never will come */
+                void cancel_all();
+                /*! Fails the outstanding requests whose deadline is past
+                 *  `now`, and sends queued ones in their place */
+                void expire(std::chrono::steady_clock::time_point now =
+                                std::chrono::steady_clock::now());
+
+                /*! Requests sent and not complete yet */
+                std::size_t in_flight() const;
+                /*! Requests waiting for a slot */
+                std::size_t queued() const;
+
+            private:
+                struct pending
+                {
+                    member_request req;
+                    chunk_handler on_chunk;
+                    std::promise<std::size_t> done;
+                    std::string nonce;
+                    /*! Which chunk indexes arrived; sized on the first chunk */
+                    std::vector<bool> chunks;
+                    std::uint32_t chunks_seen = 0;
+                    std::size_t members_seen = 0;
+                    /*! When the request fails unless another chunk arrives */
+                    std::chrono::steady_clock::time_point deadline;
+                };
+
+                /*! Sends queued requests while there is room; expects #mutex
+                 *  to be held */
+                void send_queued();
+                /*! Fails `requests` with `what`; call without #mutex held */
+                static void fail(std::vector<pending> &requests, const char *what);
+                static boost::json::object request_payload(const pending &p);
+
+                connection &cxn;
+                const std::size_t max_in_flight;
+                const std::chrono::steady_clock::duration timeout;
+
+                mutable std::mutex mutex;
+                std::deque<pending> waiting;
+                /*! Outstanding requests, by nonce */
+                std::vector<pending> outstanding;
+                std::uint64_t next_nonce = 0;
+        }; // class member_requester
+    } // namespace gateway
+} // namespace discpp
+
+#endif
@@ -0,0 +1,215 @@
+/*! \file ondemand.hpp
+ *  \brief Lazy, index-based JSON field access for gateway frames
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ONDEMAND_HPP
+#define ONDEMAND_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+
+namespace discpp
+{
+    namespace ondemand
+    {
+        /*! \namespace discpp::ondemand
+         *  \brief simdjson-style on-demand JSON access
+         *
+         *  A frame is indexed in one pass (the positions of every structural
+         *  character outside of strings), after which fields can be looked up
+         *  by walking the index; only the values actually asked for are
+         *  decoded, and no DOM is ever built.
+         */
+
+        /*! The instruction set used to build structural indexes */
+        enum class simd_level
+        {
+            scalar,
+            sse42,
+            avx2
+        };
+
+        /*! Returns the best instruction set supported by the running CPU */
+        simd_level active_simd_level();
+
+        enum class kind
+        {
+            absent, // looked-up field doesn't exist
+            object,
+            array,
+            string,
+            number,
+            boolean,
+            null
+        };
+
+        class document;
+
+        class value
+        {
+            /*! \class value
+             *  \brief A lightweight handle on a value inside a #document
+             *
+             *  Handles are cheap to copy and remain valid for as long as both
+             *  the document and the underlying JSON text are alive. Looking up
+             *  a missing field yields a handle of kind::absent rather than
+             *  throwing; the typed getters throw std::invalid_argument if the
+             *  value isn't of the requested type.
+             */
+            public:
+                value() = default;
+
+                enum kind kind() const;
+                bool exists() const { return doc != nullptr; }
+                explicit operator bool() const { return exists(); }
+
+                /*! Finds a member of an object by its key */
+                value operator[](boost::json::string_view key) const;
+                /*! Finds the n-th element of an array */
+                value at(std::size_t n) const;
+                /*! Follows a dot-separated path of object keys, e.g.
+                 *  `d.author.id` */
+                value at_path(boost::json::string_view path) const;
+
+                /*! Calls `f(value)` for every element of an array */
+                template <typename F>
+                void for_each_element(F &&f) const;
+                /*! Calls `f(key, value)` for every member of an object; the
+                 *  key is passed raw, i.e. still escaped */
+                template <typename F>
+                void for_each_field(F &&f) const;
+
+                /*! Returns the string's contents without unescaping them */
+                boost::json::string_view get_raw_string() const;
+                /*! Returns the string's contents, unescaped */
+                std::string get_string() const;
+                std::int64_t get_int64() const;
+                std::uint64_t get_uint64() const;
+                double get_double() const;
+                bool get_bool() const;
+                bool is_null() const { return kind() == kind::null; }
+
+                /*! Returns the exact JSON text of this value */
+                boost::json::string_view raw_json() const;
+
+            private:
+                friend class document;
+                value(const document *doc, std::uint32_t pos, std::uint32_t idx)
+                    : doc(doc), pos(pos), idx(idx)
+                {
+                }
+
+                /*! Index of the first structural after this value */
+                std::uint32_t skip() const;
+                /*! Builds the handle of the value following structural `i` */
+                value after(std::uint32_t i) const;
+                void expect(enum kind k) const;
+
+                const document *doc = nullptr;
+                /*! Byte offset of the first character of the value */
+                std::uint32_t pos = 0;
+                /*! Index of the first structural at or after #pos */
+                std::uint32_t idx = 0;
+        };
+
+        class document
+        {
+            /*! \class document
+             *  \brief The structural index of one JSON text
+             *
+             *  The document does not own the text; it must outlive the
+             *  document and all values taken from it.
+             */
+            public:
+                /*! Indexes `json`, throwing std::invalid_argument if it holds
+                 *  an unterminated string or is over 4 GiB */
+                explicit document(boost::json::string_view json,
+                                  simd_level level = active_simd_level());
+
+                value root() const;
+                boost::json::string_view source() const { return json; }
+
+            private:
+                friend class value;
+
+                /*! Returns the offset of structural `i` */
+                std::uint32_t offset(std::uint32_t i) const { return structurals[i]; }
+                /*! Returns the character at structural `i`, or NUL past the end */
+                char token(std::uint32_t i) const
+                {
+                    return (i < structurals.size() && structurals[i] < json.size()) ?
+                        json[structurals[i]] : '\0';
+                }
+
+                boost::json::string_view json;
+                /*! Offsets of every `{}[]:,` outside of strings, and of every
+                 *  unescaped quote, followed by a sentinel at the end of #json */
+                std::vector<std::uint32_t> structurals;
+        };
+
+        template <typename F>
+        void value::for_each_element(F &&f) const
+        {
+            expect(kind::array);
+            if (after(idx).pos == doc->offset(idx + 1) && doc->token(idx + 1) == ']')
+            {
+                return; // empty array
+            }
+
+            std::uint32_t i = idx;
+            for (;;)
+            {
+                value v = after(i);
+                f(v);
+                i = v.skip();
+                if (doc->token(i) != ',')
+                {
+                    return;
+                }
+            }
+        }
+
+        template <typename F>
+        void value::for_each_field(F &&f) const
+        {
+            expect(kind::object);
+            std::uint32_t i = idx + 1;
+            while (doc->token(i) == '"')
+            {
+                // Keys are delimited by their two quotes, and followed by the
+                // colon at i + 2
+                boost::json::string_view key(doc->json.data() + doc->offset(i) + 1,
+                                             doc->offset(i + 1) - doc->offset(i) - 1);
+                value v = after(i + 2);
+                f(key, v);
+                i = v.skip();
+                if (doc->token(i) != ',')
+                {
+                    return;
+                }
+                ++i;
+            }
+        }
+    } // namespace ondemand
+} // namespace discpp
+
+#endif
@@ -0,0 +1,132 @@
+/*! \file presence_coalescer.hpp
+ *  \brief Collapses bursts of PRESENCE_UPDATEs to each member's latest
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PRESENCE_COALESCER_HPP
+#define PRESENCE_COALESCER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+
+#include "flat_map.hpp"
+#include "gateway.hpp"
+#include "snowflake.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        /*! Counters kept by a presence_coalescer */
+        struct coalescer_stats
+        {
+            /*! PRESENCE_UPDATEs taken in */
+            std::uint64_t received;
+            /*! PRESENCE_UPDATEs passed on to the read queue */
+            std::uint64_t delivered;
+            /*! PRESENCE_UPDATEs dropped because a newer one for the same
+             *  member arrived within the window */
+            std::uint64_t collapsed;
+        };
+
+        class presence_coalescer : public std::enable_shared_from_this<presence_coalescer>
+        {
+            /*! \class presence_coalescer
+             *  \brief Holds PRESENCE_UPDATEs back for a short window, keeping
+             *  only the newest one per (guild, user)
+             *
+             *  Installed on a connection, it takes PRESENCE_UPDATE frames
+             *  straight off the socket, before they are parsed. The first
+             *  update to arrive opens a window; updates for a member already
+             *  held within it replace the held frame. When the window closes,
+             *  the surviving frames are parsed and pushed to the read queue,
+             *  in the order their members first showed up. Collapsed updates
+             *  are thus never parsed at all.
+             *
+             *  Presences are delayed by up to one window, and so may reach
+             *  the read queue after events that followed them on the socket.
+             *  Must be owned by a std::shared_ptr.
+             */
+            public:
+                explicit presence_coalescer(boost::asio::io_context &ioc,
+                                            std::chrono::milliseconds window = std::chrono::milliseconds(250));
+
+                presence_coalescer(const presence_coalescer &) = delete;
+                presence_coalescer &operator=(const presence_coalescer &) = delete;
+
+                /*! Installs the coalescer as `cxn`'s raw handler, on top of
+                 *  any raw handler already installed, which keeps receiving
+                 *  every other frame. Must be called before main_loop. */
+                void install(connection &cxn);
+
+                /*! Pushes everything held to the read queue right away */
+                void flush();
+
+                coalescer_stats stats() const;
+
+            private:
+                struct member_key
+                {
+                    snowflake guild;
+                    snowflake user;
+
+                    friend bool operator==(const member_key &a, const member_key &b)
+                    {
+                        return a.guild == b.guild && a.user == b.user;
+                    }
+                };
+
+                struct member_key_hash
+                {
+                    std::size_t operator()(const member_key &k) const noexcept
+                    {
+                        const std::hash<snowflake> h;
+                        return h(k.guild) ^ (h(k.user) * 0x9E3779B97F4A7C15ULL);
+                    }
+                };
+
+                /*! Takes one PRESENCE_UPDATE frame; returns false if it can't
+                 *  tell whose presence it is, leaving it to the normal path */
+                bool offer(boost::json::string_view frame);
+
+                boost::asio::steady_timer timer;
+                const std::chrono::milliseconds window;
+                connection *cxn = nullptr;
+
+                mutable std::mutex mutex;
+                /*! Held frames, in the order their members first showed up */
+                std::vector<std::string> held;
+                /*! Index into #held of each member's frame */
+                flat_hash_map<member_key, std::size_t, member_key_hash> slots;
+                bool window_open = false;
+
+                std::uint64_t received = 0;
+                std::uint64_t delivered = 0;
+                std::uint64_t collapsed = 0;
+        }; // class presence_coalescer
+    } // namespace gateway
+} // namespace discpp
+
+#endif
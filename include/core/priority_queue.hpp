@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <condition_variable>
+#include <cstdint>
 #include <queue>
 #include <mutex>
 #include <type_traits>
@@ -111,7 +112,7 @@ namespace discpp
                 T top()
                 {
                     std::lock_guard<std::mutex> g(_mutex);
-                    return _queue.top();
+                    return _queue.top().value;
                 }
 
                 /*! Pops the underlying queue
@@ -144,7 +145,7 @@ namespace discpp
                     // Since the pop operation cannot throw, we can avoid
                     // copying the first element and directly swap with our
                     // return variable argument.
-                    auto top = _queue.top();
+                    auto top = _queue.top().value;
 
                     std::swap(top, ret);
                     _queue.pop();
@@ -158,7 +159,8 @@ namespace discpp
                 void push(const T& value)
                 {
                     std::lock_guard<std::mutex> g(_mutex); // strong guarantee
-                    _queue.push(value); // strong guarantee
+                    _queue.push(entry{value, _pushed}); // strong guarantee
+                    ++_pushed;
                     _cvar.notify_all();
                 }
 
@@ -170,7 +172,8 @@ namespace discpp
                 void push(T&& value)
                 {
                     std::lock_guard<std::mutex> g(_mutex); // strong guarantee
-                    _queue.push(value); // strong guarantee
+                    _queue.push(entry{std::move(value), _pushed}); // strong guarantee
+                    ++_pushed;
                     _cvar.notify_all();
                 }
 
@@ -214,8 +217,37 @@ namespace discpp
                     }
                 }
             private:
+                /*! A queued value, numbered in push order */
+                struct entry
+                {
+                    T value;
+                    std::uint64_t order;
+                };
+
+                /*! Orders entries by deadline, and entries whose deadlines tie
+                 *  (e.g. two without one) by push order, since
+                 *  std::priority_queue alone doesn't keep equal elements FIFO */
+                struct later_entry
+                {
+                    bool operator()(const entry &lhs, const entry &rhs) const
+                    {
+                        const LaterDeadline<T> later;
+                        if (later(lhs.value, rhs.value))
+                        {
+                            return true;
+                        }
+                        if (later(rhs.value, lhs.value))
+                        {
+                            return false;
+                        }
+                        return lhs.order > rhs.order;
+                    }
+                };
+
                 /*! Our underlying message queue container */
-                std::priority_queue<T, std::vector<T>, LaterDeadline<T>> _queue;
+                std::priority_queue<entry, std::vector<entry>, later_entry> _queue;
+                /*! Number of values pushed so far; the next one's order */
+                std::uint64_t _pushed = 0;
                 /*! The mutex used by our member functions to ensure thread-safety */
                 std::mutex _mutex;
                 std::condition_variable _cvar;
@@ -0,0 +1,86 @@
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef REORDER_BUFFER_HPP
+#define REORDER_BUFFER_HPP
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace discpp
+{
+    namespace queue
+    {
+        template <typename T>
+        class reorder_buffer
+        {
+            /*! \class reorder_buffer
+             *  \brief Restores sequence order for values completed out of order
+             *
+             *  Values are tagged with a sequence number when they are issued
+             *  (e.g. when a frame comes off the socket), and may finish their
+             *  processing in any order. Each value is held back until every
+             *  value issued before it has been handed on.
+             */
+            public:
+                /*! Stores `value` under sequence number `seq`, then hands every
+                 *  value that is now contiguous with the last delivered one
+                 *  over to `sink`, in sequence order.
+                 *
+                 *  The sink is called with the lock held, so that two threads
+                 *  completing neighbouring values can't interleave deliveries.
+                 *
+                 *  Exception-safety: Basic guarantee; if the sink throws, the
+                 *  value it was given is dropped and later values stay queued.
+                 */
+                template <typename Sink>
+                void push(std::uint64_t seq, T value, Sink &&sink)
+                {
+                    std::lock_guard<std::mutex> g(_mutex);
+                    _pending.emplace(seq, std::move(value));
+
+                    auto it = _pending.begin();
+                    while (it != _pending.end() && it->first == _next)
+                    {
+                        T ready = std::move(it->second);
+                        it = _pending.erase(it);
+                        ++_next;
+                        sink(std::move(ready));
+                    }
+                }
+
+                /*! Returns the number of values waiting on an earlier one */
+                std::size_t size()
+                {
+                    std::lock_guard<std::mutex> g(_mutex);
+                    return _pending.size();
+                }
+
+            private:
+                /*! Completed values that can't be delivered yet, by sequence */
+                std::map<std::uint64_t, T> _pending;
+                /*! The sequence number of the next value to deliver */
+                std::uint64_t _next = 0;
+                /*! The mutex used by our member functions to ensure thread-safety */
+                std::mutex _mutex;
+        };
+
+    } // namespace queue
+} // namespace discpp
+
+#endif
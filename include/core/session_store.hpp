@@ -0,0 +1,85 @@
+/*! \file session_store.hpp
+ *  \brief Durable storage of gateway sessions, for resuming after a restart
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SESSION_STORE_HPP
+#define SESSION_STORE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include <boost/json.hpp>
+#include <boost/optional.hpp>
+
+namespace discpp
+{
+    namespace gateway
+    {
+        /*! What's needed to resume a gateway session */
+        struct session_state
+        {
+            std::string session_id;
+            /*! The resume_gateway_url sent in READY */
+            std::string resume_url;
+            /*! Last sequence number received, or -1 if none */
+            std::int64_t sequence = -1;
+            /*! When the state was saved */
+            std::chrono::system_clock::time_point saved_at;
+        };
+
+        class session_store
+        {
+            /*! \class session_store
+             *  \brief Keeps one small file per shard, holding its session_state
+             *
+             *  Files are replaced atomically (written under a temporary name,
+             *  synced, then renamed), so a crash mid-save leaves the previous
+             *  state intact. The directory must exist already.
+             */
+            public:
+                /*! Sessions older than `max_age` are not worth resuming: by
+                 *  then the gateway will most likely have discarded them. */
+                explicit session_store(std::string directory,
+                                       std::chrono::seconds max_age = std::chrono::minutes(5));
+
+                /*! Returns the saved state of `shard`, or none if there is no
+                 *  usable one (missing, unreadable or too old) */
+                boost::optional<session_state> load(std::uint32_t shard) const;
+                /*! Saves the state of `shard`, stamping it with the current
+                 *  time. Throws std::system_error on I/O errors. */
+                void save(std::uint32_t shard, session_state state) const;
+                /*! Removes the state of `shard`, e.g. after the gateway
+                 *  rejected a resume */
+                void clear(std::uint32_t shard) const;
+
+            private:
+                std::string path_for(std::uint32_t shard) const;
+
+                const std::string directory;
+                const std::chrono::seconds max_age;
+        };
+
+        /*! Builds the op 6 RESUME payload for a saved session */
+        boost::json::object resume_payload(boost::json::string_view token,
+                                           const session_state &state);
+    } // namespace gateway
+} // namespace discpp
+
+#endif
@@ -0,0 +1,163 @@
+/*! \file snowflake.hpp
+ *  \brief Discord snowflake id type
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SNOWFLAKE_HPP
+#define SNOWFLAKE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/json.hpp>
+
+namespace discpp
+{
+    class snowflake
+    {
+        /*! \class snowflake
+         *  \brief A Discord id, stored as the 64-bit integer it really is
+         *
+         *  The API sends ids as decimal strings, but every id is a packed
+         *  integer:
+         *
+         *      63                         22 21     17 16     12 11         0
+         *      | ms since the Discord epoch | worker  | process | increment |
+         *
+         *  Since the timestamp sits in the top bits, ordering snowflakes also
+         *  orders them by creation time, and #from_time gives the smallest
+         *  possible id for a given instant, for use as a range bound.
+         */
+        public:
+            /*! Milliseconds between the Unix epoch and 2015-01-01T00:00:00Z */
+            static constexpr std::uint64_t discord_epoch = 1420070400000ULL;
+
+            constexpr snowflake() = default;
+            constexpr explicit snowflake(std::uint64_t value) : _value(value) {}
+
+            /*! Parses a decimal id, throwing std::invalid_argument if `s` is
+             *  empty or holds anything but digits */
+            static snowflake from_string(boost::json::string_view s)
+            {
+                if (s.empty() || s.size() > 20)
+                {
+                    throw std::invalid_argument("Malformed snowflake");
+                }
+                std::uint64_t v = 0;
+                for (char c : s)
+                {
+                    if (c < '0' || c > '9')
+                    {
+                        throw std::invalid_argument("Malformed snowflake");
+                    }
+                    v = v * 10 + static_cast<std::uint64_t>(c - '0');
+                }
+                return snowflake(v);
+            }
+
+            /*! Reads an id sent either as a string or as a number; null and
+             *  missing ids give the zero snowflake */
+            static snowflake from_json(const boost::json::value &v)
+            {
+                if (v.is_string())
+                {
+                    return from_string(v.get_string());
+                }
+                if (v.is_uint64())
+                {
+                    return snowflake(v.get_uint64());
+                }
+                if (v.is_int64())
+                {
+                    return snowflake(static_cast<std::uint64_t>(v.get_int64()));
+                }
+                return snowflake();
+            }
+
+            /*! Returns the smallest snowflake created at `ms` milliseconds
+             *  after the Unix epoch */
+            static constexpr snowflake from_timestamp(std::uint64_t ms)
+            {
+                return snowflake(ms <= discord_epoch ? 0 : (ms - discord_epoch) << 22);
+            }
+
+            /*! Returns the smallest snowflake created at time `t` */
+            static snowflake from_time(std::chrono::system_clock::time_point t)
+            {
+                using namespace std::chrono;
+                return from_timestamp(static_cast<std::uint64_t>(
+                    duration_cast<milliseconds>(t.time_since_epoch()).count()));
+            }
+
+            constexpr std::uint64_t value() const { return _value; }
+            /*! Creation time in milliseconds since the Unix epoch */
+            constexpr std::uint64_t timestamp() const { return (_value >> 22) + discord_epoch; }
+            constexpr std::uint8_t worker_id() const { return (_value >> 17) & 0x1F; }
+            constexpr std::uint8_t process_id() const { return (_value >> 12) & 0x1F; }
+            constexpr std::uint16_t increment() const { return _value & 0xFFF; }
+
+            std::chrono::system_clock::time_point time() const
+            {
+                return std::chrono::system_clock::time_point(
+                    std::chrono::milliseconds(timestamp()));
+            }
+
+            std::string to_string() const { return std::to_string(_value); }
+
+            /*! The zero snowflake stands in for "no id" */
+            constexpr explicit operator bool() const { return _value != 0; }
+
+            friend constexpr bool operator==(snowflake a, snowflake b) { return a._value == b._value; }
+            friend constexpr bool operator!=(snowflake a, snowflake b) { return a._value != b._value; }
+            friend constexpr bool operator<(snowflake a, snowflake b) { return a._value < b._value; }
+            friend constexpr bool operator<=(snowflake a, snowflake b) { return a._value <= b._value; }
+            friend constexpr bool operator>(snowflake a, snowflake b) { return a._value > b._value; }
+            friend constexpr bool operator>=(snowflake a, snowflake b) { return a._value >= b._value; }
+
+            friend std::ostream &operator<<(std::ostream &os, snowflake s)
+            {
+                return os << s._value;
+            }
+
+        private:
+            std::uint64_t _value = 0;
+    };
+} // namespace discpp
+
+namespace std
+{
+    template <>
+    struct hash<::discpp::snowflake>
+    {
+        std::size_t operator()(::discpp::snowflake s) const noexcept
+        {
+            // Most of the entropy is in the timestamp bits, so mix them down
+            // (this is the splitmix64 finalizer)
+            std::uint64_t x = s.value();
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+            return static_cast<std::size_t>(x ^ (x >> 31));
+        }
+    };
+} // namespace std
+
+#endif
@@ -0,0 +1,414 @@
+/*! \file types.hpp
+ *  \brief Compact, lazily decoded gateway and REST object types
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TYPES_HPP
+#define TYPES_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "snowflake.hpp"
+
+namespace discpp
+{
+    namespace ondemand
+    {
+        class value;
+    }
+
+    namespace types
+    {
+        namespace detail
+        {
+            class dom_value;
+            /*! Reads and writes typed objects in cache snapshots (see
+             *  entity_snapshot.cpp) */
+            struct snapshot_codec;
+        }
+
+        /*! \namespace discpp::types
+         *  \brief Typed counterparts of the boost::json::object aliases in dis.hpp
+         *
+         *  Each type keeps its source JSON as one compact string, and decodes
+         *  what is needed for indexing and hot-path checks (ids, flags,
+         *  permissions) up front. Text fields are located in the same pass and
+         *  read back as views into the source, so accessing them neither
+         *  scans nor allocates; only text holding escapes is unescaped, once,
+         *  into a side buffer. Nested objects such as a message's author are
+         *  decoded on demand, and the full object is still available through
+         *  json().
+         *
+         *  Optional and nullable fields are tracked in a presence bitmask,
+         *  queried through has().
+         */
+
+        /*! Where the contents of a text field are kept */
+        struct text_ref
+        {
+            /*! Set in #size when the text is in lazy_object::_text rather than
+             *  in the source */
+            static constexpr std::uint32_t unescaped = std::uint32_t(1) << 31;
+
+            std::uint32_t offset = 0;
+            std::uint32_t size = 0;
+        };
+
+        class lazy_object
+        {
+            /*! \class lazy_object
+             *  \brief Storage shared by all typed objects
+             */
+            public:
+                /*! Returns the object's source JSON */
+                boost::json::string_view raw_json() const { return _source; }
+                /*! Parses the source JSON into a full object (the escape hatch) */
+                boost::json::object json() const;
+                /*! Returns the heap memory held by this object, in bytes (add
+                 *  sizeof for the total) */
+                std::size_t footprint() const;
+
+            protected:
+                friend struct detail::snapshot_codec;
+
+                lazy_object() = default;
+                explicit lazy_object(std::string source) : _source(std::move(source)) {}
+
+                /*! Returns a text field; empty if it was missing or null. The
+                 *  view is valid for as long as the object. */
+                boost::json::string_view text(text_ref t) const;
+                /*! Records a string value of the source, unescaping it into
+                 *  #_text only if it holds escapes */
+                text_ref keep_text(const ondemand::value &v);
+                /*! Records a string value of the object a type was built from */
+                text_ref keep_text(const detail::dom_value &v);
+
+                std::string _source;
+                /*! Text fields that needed unescaping */
+                std::string _text;
+                /*! Heap memory held by derived classes besides #_source and
+                 *  #_text */
+                std::size_t _extra_bytes = 0;
+        };
+
+        class user : public lazy_object
+        {
+            public:
+                enum class field : std::uint32_t
+                {
+                    avatar      = 1 << 0,
+                    global_name = 1 << 1,
+                    bot         = 1 << 2,
+                    system      = 1 << 3
+                };
+
+                user() = default;
+                explicit user(std::string json);
+                explicit user(const boost::json::object &obj);
+
+                snowflake id() const { return _id; }
+                bool has(field f) const { return _present & static_cast<std::uint32_t>(f); }
+
+                boost::json::string_view username() const { return text(_username); }
+                boost::json::string_view global_name() const { return text(_global_name); }
+                boost::json::string_view avatar() const { return text(_avatar); }
+
+            private:
+                friend struct detail::snapshot_codec;
+
+                template <typename Value>
+                void decode(const Value &root);
+
+                snowflake _id;
+                text_ref _username;
+                text_ref _global_name;
+                text_ref _avatar;
+                std::uint32_t _present = 0;
+        };
+
+        class guild_member : public lazy_object
+        {
+            public:
+                enum class field : std::uint32_t
+                {
+                    user          = 1 << 0,
+                    nick          = 1 << 1,
+                    avatar        = 1 << 2,
+                    premium_since = 1 << 3,
+                    pending       = 1 << 4,
+                    timed_out     = 1 << 5, // communication_disabled_until
+                    deaf          = 1 << 6,
+                    mute          = 1 << 7
+                };
+
+                guild_member() = default;
+                /*! `guild_id` is needed because members sent in GUILD_CREATE
+                 *  don't carry one; leave it zero to take it from the object */
+                explicit guild_member(std::string json, snowflake guild_id = snowflake());
+                explicit guild_member(const boost::json::object &obj, snowflake guild_id = snowflake());
+
+                snowflake user_id() const { return _user_id; }
+                snowflake guild_id() const { return _guild_id; }
+                const std::vector<snowflake> &roles() const { return _roles; }
+                bool has(field f) const { return _present & static_cast<std::uint32_t>(f); }
+
+                boost::json::string_view nick() const { return text(_nick); }
+                boost::json::string_view joined_at() const { return text(_joined_at); }
+                types::user user() const;
+
+            private:
+                friend struct detail::snapshot_codec;
+
+                template <typename Value>
+                void decode(const Value &root);
+
+                snowflake _user_id;
+                snowflake _guild_id;
+                std::vector<snowflake> _roles;
+                text_ref _nick;
+                text_ref _joined_at;
+                std::uint32_t _present = 0;
+        };
+
+        class role : public lazy_object
+        {
+            public:
+                enum class field : std::uint32_t
+                {
+                    hoist       = 1 << 0,
+                    managed     = 1 << 1,
+                    mentionable = 1 << 2,
+                    icon        = 1 << 3,
+                    tags        = 1 << 4
+                };
+
+                role() = default;
+                explicit role(std::string json, snowflake guild_id = snowflake());
+                explicit role(const boost::json::object &obj, snowflake guild_id = snowflake());
+
+                snowflake id() const { return _id; }
+                snowflake guild_id() const { return _guild_id; }
+                std::uint64_t permissions() const { return _permissions; }
+                std::int32_t position() const { return _position; }
+                std::uint32_t color() const { return _color; }
+                bool has(field f) const { return _present & static_cast<std::uint32_t>(f); }
+
+                boost::json::string_view name() const { return text(_name); }
+
+            private:
+                friend struct detail::snapshot_codec;
+
+                template <typename Value>
+                void decode(const Value &root);
+
+                snowflake _id;
+                snowflake _guild_id;
+                text_ref _name;
+                std::uint64_t _permissions = 0;
+                std::int32_t _position = 0;
+                std::uint32_t _color = 0;
+                std::uint32_t _present = 0;
+        };
+
+        /*! A channel permission overwrite */
+        struct overwrite
+        {
+            enum class target : std::uint8_t
+            {
+                role   = 0,
+                member = 1
+            };
+
+            snowflake id;
+            target type;
+            std::uint64_t allow;
+            std::uint64_t deny;
+        };
+
+        class channel : public lazy_object
+        {
+            public:
+                enum class field : std::uint32_t
+                {
+                    guild_id        = 1 << 0,
+                    parent_id       = 1 << 1,
+                    topic           = 1 << 2,
+                    last_message_id = 1 << 3,
+                    nsfw            = 1 << 4,
+                    recipients      = 1 << 5
+                };
+
+                channel() = default;
+                explicit channel(std::string json, snowflake guild_id = snowflake());
+                explicit channel(const boost::json::object &obj, snowflake guild_id = snowflake());
+
+                snowflake id() const { return _id; }
+                snowflake guild_id() const { return _guild_id; }
+                snowflake parent_id() const { return _parent_id; }
+                std::uint8_t type() const { return _type; }
+                std::int32_t position() const { return _position; }
+                const std::vector<overwrite> &overwrites() const { return _overwrites; }
+                bool has(field f) const { return _present & static_cast<std::uint32_t>(f); }
+
+                boost::json::string_view name() const { return text(_name); }
+                boost::json::string_view topic() const { return text(_topic); }
+
+            private:
+                friend struct detail::snapshot_codec;
+
+                template <typename Value>
+                void decode(const Value &root);
+
+                snowflake _id;
+                snowflake _guild_id;
+                snowflake _parent_id;
+                std::vector<overwrite> _overwrites;
+                text_ref _name;
+                text_ref _topic;
+                std::int32_t _position = 0;
+                std::uint8_t _type = 0;
+                std::uint32_t _present = 0;
+        };
+
+        class emoji : public lazy_object
+        {
+            public:
+                enum class field : std::uint32_t
+                {
+                    custom   = 1 << 0, // has an id, i.e. isn't a unicode emoji
+                    animated = 1 << 1,
+                    managed  = 1 << 2
+                };
+
+                emoji() = default;
+                explicit emoji(std::string json, snowflake guild_id = snowflake());
+                explicit emoji(const boost::json::object &obj, snowflake guild_id = snowflake());
+
+                snowflake id() const { return _id; }
+                snowflake guild_id() const { return _guild_id; }
+                bool has(field f) const { return _present & static_cast<std::uint32_t>(f); }
+
+                boost::json::string_view name() const { return text(_name); }
+
+            private:
+                friend struct detail::snapshot_codec;
+
+                template <typename Value>
+                void decode(const Value &root);
+
+                snowflake _id;
+                snowflake _guild_id;
+                text_ref _name;
+                std::uint32_t _present = 0;
+        };
+
+        class guild : public lazy_object
+        {
+            public:
+                enum class field : std::uint32_t
+                {
+                    icon         = 1 << 0,
+                    unavailable  = 1 << 1,
+                    large        = 1 << 2,
+                    member_count = 1 << 3
+                };
+
+                guild() = default;
+                /*! Guild objects should be passed without their member, channel,
+                 *  role and presence arrays (see gateway::guild_stream); those
+                 *  belong in their own tables */
+                explicit guild(std::string json);
+                explicit guild(const boost::json::object &obj);
+
+                snowflake id() const { return _id; }
+                snowflake owner_id() const { return _owner_id; }
+                std::uint32_t member_count() const { return _member_count; }
+                bool has(field f) const { return _present & static_cast<std::uint32_t>(f); }
+
+                boost::json::string_view name() const { return text(_name); }
+                boost::json::string_view icon() const { return text(_icon); }
+
+            private:
+                friend struct detail::snapshot_codec;
+
+                template <typename Value>
+                void decode(const Value &root);
+
+                snowflake _id;
+                snowflake _owner_id;
+                text_ref _name;
+                text_ref _icon;
+                std::uint32_t _member_count = 0;
+                std::uint32_t _present = 0;
+        };
+
+        class message : public lazy_object
+        {
+            public:
+                enum class field : std::uint32_t
+                {
+                    guild_id           = 1 << 0,
+                    edited_timestamp   = 1 << 1,
+                    member             = 1 << 2,
+                    webhook_id         = 1 << 3,
+                    referenced_message = 1 << 4,
+                    attachments        = 1 << 5, // non-empty
+                    embeds             = 1 << 6, // non-empty
+                    pinned             = 1 << 7,
+                    tts                = 1 << 8,
+                    mention_everyone   = 1 << 9
+                };
+
+                message() = default;
+                explicit message(std::string json);
+                explicit message(const boost::json::object &obj);
+
+                snowflake id() const { return _id; }
+                snowflake channel_id() const { return _channel_id; }
+                snowflake guild_id() const { return _guild_id; }
+                snowflake author_id() const { return _author_id; }
+                std::uint8_t type() const { return _type; }
+                bool has(field f) const { return _present & static_cast<std::uint32_t>(f); }
+
+                boost::json::string_view content() const { return text(_content); }
+                boost::json::string_view timestamp() const { return text(_timestamp); }
+                boost::json::string_view edited_timestamp() const { return text(_edited_timestamp); }
+                types::user author() const;
+
+            private:
+                template <typename Value>
+                void decode(const Value &root);
+
+                snowflake _id;
+                snowflake _channel_id;
+                snowflake _guild_id;
+                snowflake _author_id;
+                text_ref _content;
+                text_ref _timestamp;
+                text_ref _edited_timestamp;
+                std::uint32_t _present = 0;
+                std::uint8_t _type = 0;
+        };
+    } // namespace types
+} // namespace discpp
+
+#endif
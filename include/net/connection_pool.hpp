@@ -0,0 +1,124 @@
+/*! \file connection_pool.hpp
+ *  \brief Keeps HTTPS connections to a host open between requests
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONNECTION_POOL_HPP
+#define CONNECTION_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+
+namespace discpp
+{
+    namespace http
+    {
+        class connection_pool
+        {
+            /*! \class connection_pool
+             *  \brief Hands out TLS connections to one host, reusing idle ones
+             *
+             *  A connection is only taken back once its user says the last
+             *  response was read in full and the server will keep it open;
+             *  anything else is closed when its lease ends. Servers drop idle
+             *  connections whenever they like, so a request failing on a
+             *  #lease::reused connection should be retried on a new one.
+             *
+             *  Connections are made with create_https_stream, through the
+             *  given SSL context; pointing the pool at a local server only
+             *  needs a context that trusts its certificate.
+             */
+            public:
+                using stream = boost::beast::ssl_stream<boost::beast::tcp_stream>;
+
+                class lease
+                {
+                    public:
+                        lease(lease &&other) noexcept;
+                        lease &operator=(lease &&other) noexcept;
+                        lease(const lease &) = delete;
+                        lease &operator=(const lease &) = delete;
+                        /*! Closes the connection unless it was released, as it
+                         *  may be stuck mid-response */
+                        ~lease() = default;
+
+                        stream &operator*() { return *conn; }
+                        stream *operator->() { return conn.get(); }
+
+                        /*! Whether the connection was used before */
+                        bool reused() const { return _reused; }
+                        /*! Gives the connection back for other requests */
+                        void release();
+
+                    private:
+                        friend class connection_pool;
+                        lease(connection_pool *pool, std::unique_ptr<stream> conn, bool reused);
+
+                        connection_pool *pool;
+                        std::unique_ptr<stream> conn;
+                        bool _reused;
+                };
+
+                connection_pool(boost::asio::ssl::context &ssl,
+                                std::string host,
+                                std::string port = "443",
+                                std::size_t max_idle = 8);
+
+                connection_pool(const connection_pool &) = delete;
+                connection_pool &operator=(const connection_pool &) = delete;
+
+                /*! An idle connection if there is one, else a new one; throws
+                 *  boost::beast::system_error if connecting fails */
+                lease acquire();
+                /*! A new connection, even if idle ones are waiting; for
+                 *  retrying a request that failed on a reused one */
+                lease connect();
+                /*! Closes every idle connection */
+                void clear();
+
+                const std::string &host() const { return _host; }
+                const std::string &port() const { return _port; }
+
+                // What create_https_stream needs of a context
+                boost::asio::io_context &io_context() { return ioc; }
+                boost::asio::ssl::context &ssl_context() { return ssl; }
+
+            private:
+                void give_back(std::unique_ptr<stream> conn);
+
+                boost::asio::ssl::context &ssl;
+                boost::asio::io_context ioc;
+                const std::string _host;
+                const std::string _port;
+                const std::size_t max_idle;
+
+                std::mutex mutex;
+                std::vector<std::unique_ptr<stream>> idle;
+        }; // class connection_pool
+    } // namespace http
+} // namespace discpp
+
+#endif
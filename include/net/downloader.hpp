@@ -0,0 +1,130 @@
+/*! \file downloader.hpp
+ *  \brief Downloads attachments and other CDN files in parallel ranges
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DOWNLOADER_HPP
+#define DOWNLOADER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/ssl.hpp>
+#include <boost/json.hpp>
+
+#include "net/connection_pool.hpp"
+
+namespace discpp
+{
+    namespace http
+    {
+        struct download_limits
+        {
+            /*! Requests in flight at once, across all downloads */
+            std::size_t max_connections = 8;
+            /*! Bytes asked for per Range request */
+            std::uint64_t chunk_size = 4 << 20;
+            /*! Overall transfer cap in bytes per second; zero for none */
+            std::uint64_t max_bytes_per_second = 0;
+        };
+
+        class downloader
+        {
+            /*! \class downloader
+             *  \brief Fetches files over HTTPS into local files
+             *
+             *  The first request of a download asks for the first chunk. If
+             *  the server answers with a range, the file is preallocated to
+             *  the full size and the remaining chunks are queued as Range
+             *  requests of their own, which any free connection may pick up;
+             *  otherwise the whole body arrives in that one response. Either
+             *  way, data is written with pwrite at its offset as it is read,
+             *  so a download never holds more than a read buffer per
+             *  connection.
+             *
+             *  Connections are pooled per host and port. Every URL must be
+             *  https; its host and port pick the pool, and every pool
+             *  connects through the SSL context given here.
+             */
+            public:
+                explicit downloader(boost::asio::ssl::context &ssl,
+                                    download_limits limits = download_limits());
+                /*! Waits for the requests in flight; downloads not finished
+                 *  by then fail with std::runtime_error */
+                ~downloader();
+
+                downloader(const downloader &) = delete;
+                downloader &operator=(const downloader &) = delete;
+
+                /*! Downloads `url` to `path`, replacing any file there. The
+                 *  future resolves with the number of bytes written, or with
+                 *  the exception that stopped the download, in which case the
+                 *  partial file is removed. */
+                std::future<std::uint64_t> download(const std::string &url, std::string path);
+                /*! Downloads an attachment object's `url` */
+                std::future<std::uint64_t> download(const boost::json::object &attachment, std::string path);
+
+            private:
+                struct file_state;
+
+                struct task
+                {
+                    std::shared_ptr<file_state> file;
+                    std::uint64_t offset;
+                    /*! Zero for the first request, which learns the size */
+                    std::uint64_t length;
+                };
+
+                void run();
+                void fetch(const task &t);
+                /*! Writes one response's body, read through `conn`; false if
+                 *  it was a reused connection that went stale before anything
+                 *  was read */
+                bool transfer(const task &t, connection_pool::lease conn);
+                void finish(const std::shared_ptr<file_state> &file, std::exception_ptr error);
+                /*! Sleeps as long as the bandwidth cap requires after `bytes` */
+                void throttle(std::uint64_t bytes);
+                connection_pool &pool_for(const std::string &host, const std::string &port);
+
+                boost::asio::ssl::context &ssl;
+                const download_limits limits;
+
+                std::mutex mutex;
+                std::condition_variable wakeup;
+                std::deque<task> tasks;
+                std::map<std::string, std::unique_ptr<connection_pool>> pools;
+                bool stopping = false;
+
+                std::mutex throttle_mutex;
+                std::chrono::steady_clock::time_point next_free;
+
+                std::vector<std::thread> workers;
+        }; // class downloader
+    } // namespace http
+} // namespace discpp
+
+#endif
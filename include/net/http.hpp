@@ -23,6 +23,10 @@
 
 #include <string>
 
+#include <boost/json.hpp>
+
+#include "multipart.hpp"
+
 namespace discpp
 {
     namespace http
@@ -38,41 +42,55 @@ namespace discpp
         // boost::beast::http::response<beast::http::string_body>
         template <class Context>
         auto get(Context &ctx,
-                 const std::string url,
-                 const std::string resource,
-                 const std::string token);
+                 boost::json::string_view url,
+                 boost::json::string_view resource,
+                 boost::json::string_view token);
 
         template <class Context>
         auto post(Context &ctx,
-                  const std::string url,
-                  const std::string resource,
-                  const std::string token,
+                  boost::json::string_view url,
+                  boost::json::string_view resource,
+                  boost::json::string_view token,
                   const std::string body);
 
+        /*! POSTs a multipart/form-data body, streaming its files from
+         *  where they are rather than copying them into the request */
+        template <class Context>
+        auto post_multipart(Context &ctx,
+                            boost::json::string_view url,
+                            boost::json::string_view resource,
+                            boost::json::string_view token,
+                            multipart_form form);
+
         template <class Context>
         auto put(Context &ctx,
-                 const std::string url,
-                 const std::string resource,
-                 const std::string token,
+                 boost::json::string_view url,
+                 boost::json::string_view resource,
+                 boost::json::string_view token,
                  const std::string body);
 
         template <class Context>
         auto patch(Context &ctx,
-                   const std::string url,
-                   const std::string resource,
-                   const std::string token,
+                   boost::json::string_view url,
+                   boost::json::string_view resource,
+                   boost::json::string_view token,
                    const std::string body);
 
         template <class Context>
         auto delete_(Context &ctx,
-                     const std::string url,
-                     const std::string resource,
-                     const std::string token);
+                     boost::json::string_view url,
+                     boost::json::string_view resource,
+                     boost::json::string_view token);
 
         template <class Context>
         std::string get_gateway(Context &ctx);
 
-        std::string url_encode(std::string substring);
+        /*! Percent-encodes every byte of `s` outside RFC 3986's unreserved
+         *  set, making it safe as one segment of a path or query */
+        std::string url_encode(boost::json::string_view s);
+        /*! Writes `s` percent-encoded to `out`, which must have room for
+         *  3 * s.size() bytes, and returns the end of what was written */
+        char *url_encode(boost::json::string_view s, char *out);
     } // namespace http
 } // namespace discpp
 
@@ -41,6 +41,19 @@ namespace discpp
 {
     namespace http
     {
+        namespace detail
+        {
+            inline boost::beast::string_view beast_view(boost::json::string_view s)
+            {
+                return boost::beast::string_view(s.data(), s.size());
+            }
+
+            inline std::string authorization(boost::json::string_view token)
+            {
+                return std::string("Bot ").append(token.data(), token.size());
+            }
+        }
+
         template <class SyncReadStream, class Context>
         SyncReadStream create_https_stream(Context &ctx, std::string url, std::string port)
         {
@@ -68,29 +81,29 @@ namespace discpp
 
         template <class Context>
         auto get(Context &ctx,
-                 std::string url,
-                 std::string resource,
-                 std::string token)
+                 boost::json::string_view url,
+                 boost::json::string_view resource,
+                 boost::json::string_view token)
         {
             namespace bhttp = boost::beast::http;
             using stream    = boost::beast::ssl_stream<boost::beast::tcp_stream>;
 
             // Okay, first thing's first. Let's follow HTTP 1.0 and keep each
             // session limited to 1 request. So the first step is connecting.
-            auto hstream = create_https_stream<stream, Context>(ctx, url);
+            auto hstream = create_https_stream<stream, Context>(ctx, std::string(url.data(), url.size()));
 
             // Now, we craft and send the GET request to the stream
             // note that boost::beast is limited to http 1.1
             const int HTTP_VERSION = 11;
             bhttp::request<bhttp::string_body> request(bhttp::verb::get,
-                                                       resource,
+                                                       detail::beast_view(resource),
                                                        HTTP_VERSION);
-            request.set(bhttp::field::host, url);
+            request.set(bhttp::field::host, detail::beast_view(url));
             request.set(bhttp::field::user_agent, BOOST_BEAST_VERSION_STRING);
 
             if (!token.empty())
             {
-                request.set(bhttp::field::authorization, "Bot " + token);
+                request.set(bhttp::field::authorization, detail::authorization(token));
             }
 
             bhttp::write(hstream, request);
@@ -122,9 +135,9 @@ namespace discpp
 
         template <class Context>
         auto post(Context &ctx,
-                  std::string url,
-                  std::string resource,
-                  std::string token,
+                  boost::json::string_view url,
+                  boost::json::string_view resource,
+                  boost::json::string_view token,
                   std::string body)
         {
             namespace bhttp = boost::beast::http;
@@ -132,16 +145,16 @@ namespace discpp
 
             // Okay, first thing's first. Let's follow HTTP 1.0 and keep each
             // session limited to 1 request. So the first step is connecting.
-            auto hstream = create_https_stream<stream, Context>(ctx, url);
+            auto hstream = create_https_stream<stream, Context>(ctx, std::string(url.data(), url.size()));
 
             // Now, we craft and send the GET request to the stream
             // note that boost::beast is limited to http 1.1
             const int HTTP_VERSION = 11;
             bhttp::request<bhttp::string_body> request(bhttp::verb::post,
-                                                       resource,
+                                                       detail::beast_view(resource),
                                                        HTTP_VERSION,
                                                        body);
-            request.set(bhttp::field::host, url);
+            request.set(bhttp::field::host, detail::beast_view(url));
             request.set(bhttp::field::user_agent, BOOST_BEAST_VERSION_STRING);
             request.set(bhttp::field::content_type, "application/json");
             request.set(bhttp::field::content_length, body.length());
@@ -149,7 +162,7 @@ namespace discpp
             // If the token is empty, then we consider authorization unnecessary
             if (!token.empty())
             {
-                request.set(bhttp::field::authorization, "Bot " + token);
+                request.set(bhttp::field::authorization, detail::authorization(token));
             }
 
             bhttp::write(hstream, request);
@@ -179,11 +192,63 @@ namespace discpp
             return response;
         }
 
+        template <class Context>
+        auto post_multipart(Context &ctx,
+                            boost::json::string_view url,
+                            boost::json::string_view resource,
+                            boost::json::string_view token,
+                            multipart_form form)
+        {
+            namespace bhttp = boost::beast::http;
+            using stream    = boost::beast::ssl_stream<boost::beast::tcp_stream>;
+
+            auto hstream = create_https_stream<stream, Context>(ctx, std::string(url.data(), url.size()));
+
+            const int HTTP_VERSION = 11;
+            bhttp::request<multipart_body> request(bhttp::verb::post,
+                                                   detail::beast_view(resource),
+                                                   HTTP_VERSION,
+                                                   std::move(form));
+            request.set(bhttp::field::host, detail::beast_view(url));
+            request.set(bhttp::field::user_agent, BOOST_BEAST_VERSION_STRING);
+            request.set(bhttp::field::content_type, request.body().content_type());
+            request.content_length(request.body().size());
+
+            if (!token.empty())
+            {
+                request.set(bhttp::field::authorization, detail::authorization(token));
+            }
+
+            // The parts go to the TLS layer as one gather list, so file
+            // contents are only ever copied by the encryption itself; that
+            // is also why there's no sendfile here
+            bhttp::write(hstream, request);
+
+            boost::beast::flat_buffer buf;
+            bhttp::response<bhttp::string_body> response;
+            bhttp::read(hstream, buf, response);
+
+            boost::beast::error_code err;
+            hstream.shutdown(err);
+            // Same as everywhere else: Discord may cut the TLS close short
+            if (err == boost::asio::error::eof ||
+                    err == boost::asio::ssl::error::stream_truncated)
+            {
+                err = {};
+            }
+            if (err)
+            {
+                throw boost::beast::system_error{err};
+            }
+
+            return response;
+        }
+
         template <class Context>
         auto put(Context &ctx,
-                 const std::string url,
-                 const std::string resource,
-                 const std::string token,
+                 boost::json::string_view url,
+                 boost::json::string_view resource,
+                 boost::json::string_view token,
                  const std::string body)
         {
             namespace bhttp = boost::beast::http;
@@ -191,16 +256,16 @@ namespace discpp
 
             // Okay, first thing's first. Let's follow HTTP 1.0 and keep each
             // session limited to 1 request. So the first step is connecting.
-            auto hstream = create_https_stream<stream, Context>(ctx, url);
+            auto hstream = create_https_stream<stream, Context>(ctx, std::string(url.data(), url.size()));
 
             // Now, we craft and send the GET request to the stream
             // note that boost::beast is limited to http 1.1
             const int HTTP_VERSION = 11;
             bhttp::request<bhttp::string_body> request(bhttp::verb::put,
-                                                       resource,
+                                                       detail::beast_view(resource),
                                                        HTTP_VERSION,
                                                        body);
-            request.set(bhttp::field::host, url);
+            request.set(bhttp::field::host, detail::beast_view(url));
             request.set(bhttp::field::user_agent, BOOST_BEAST_VERSION_STRING);
             request.set(bhttp::field::content_type, "application/json");
             request.set(bhttp::field::content_length, body.length());
@@ -208,7 +273,7 @@ namespace discpp
             // If the token is empty, then we consider authorization unnecessary
             if (!token.empty())
             {
-                request.set(bhttp::field::authorization, "Bot " + token);
+                request.set(bhttp::field::authorization, detail::authorization(token));
             }
 
             bhttp::write(hstream, request);
@@ -240,9 +305,9 @@ namespace discpp
 
         template <class Context>
         auto patch(Context &ctx,
-                   const std::string url,
-                   const std::string resource,
-                   const std::string token,
+                   boost::json::string_view url,
+                   boost::json::string_view resource,
+                   boost::json::string_view token,
                    const std::string body)
         {
             namespace bhttp = boost::beast::http;
@@ -250,24 +315,24 @@ namespace discpp
 
             // Okay, first thing's first. Let's follow HTTP 1.0 and keep each
             // session limited to 1 request. So the first step is connecting.
-            auto hstream = create_https_stream<stream, Context>(ctx, url);
+            auto hstream = create_https_stream<stream, Context>(ctx, std::string(url.data(), url.size()));
 
             // Now, we craft and send the GET request to the stream
             // note that boost::beast is limited to http 1.1
             const int HTTP_VERSION = 11;
             bhttp::request<bhttp::string_body> request(bhttp::verb::patch,
-                                                       resource,
+                                                       detail::beast_view(resource),
                                                        HTTP_VERSION,
                                                        body);
 
-            request.set(bhttp::field::host, url);
+            request.set(bhttp::field::host, detail::beast_view(url));
             request.set(bhttp::field::user_agent, BOOST_BEAST_VERSION_STRING);
             request.set(bhttp::field::content_type, "application/json");
             request.set(bhttp::field::content_length, body.length());
 
             if (!token.empty())
             {
-                request.set(bhttp::field::authorization, "Bot " + token);
+                request.set(bhttp::field::authorization, detail::authorization(token));
             }
 
             bhttp::write(hstream, request);
@@ -299,30 +364,30 @@ namespace discpp
 
         template <class Context>
         auto delete_(Context &ctx,
-                     std::string url,
-                     std::string resource,
-                     std::string token)
+                     boost::json::string_view url,
+                     boost::json::string_view resource,
+                     boost::json::string_view token)
         {
             namespace bhttp = boost::beast::http;
             using stream    = boost::beast::ssl_stream<boost::beast::tcp_stream>;
 
             // Okay, first thing's first. Let's follow HTTP 1.0 and keep each
             // session limited to 1 request. So the first step is connecting.
-            auto hstream = create_https_stream<stream, Context>(ctx, url);
+            auto hstream = create_https_stream<stream, Context>(ctx, std::string(url.data(), url.size()));
 
             // Now, we craft and send the GET request to the stream
             // note that boost::beast is limited to http 1.1
             const int HTTP_VERSION = 11;
             bhttp::request<bhttp::string_body> request(bhttp::verb::delete_,
-                                                       resource,
+                                                       detail::beast_view(resource),
                                                        HTTP_VERSION);
 
-            request.set(bhttp::field::host, url);
+            request.set(bhttp::field::host, detail::beast_view(url));
             request.set(bhttp::field::user_agent, BOOST_BEAST_VERSION_STRING);
 
             if (!token.empty())
             {
-                request.set(bhttp::field::authorization, "Bot " + token);
+                request.set(bhttp::field::authorization, detail::authorization(token));
             }
 
             bhttp::write(hstream, request);
@@ -0,0 +1,164 @@
+/*! \file multipart.hpp
+ *  \brief multipart/form-data request bodies that don't copy their files
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MULTIPART_HPP
+#define MULTIPART_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+#include "core/mapped_file.hpp"
+
+namespace discpp
+{
+    namespace http
+    {
+        class multipart_form
+        {
+            /*! \class multipart_form
+             *  \brief The parts of a multipart/form-data body
+             *
+             *  Parts only refer to their contents: files stay mapped and
+             *  user buffers stay where they are, and the body is written
+             *  as one gather list straight from them. Buffers passed to
+             *  #add_buffers must outlive the request.
+             *
+             *  The boundary is 128 random bits; contents aren't scanned for
+             *  it, as that would mean reading every file twice.
+             */
+            public:
+                multipart_form();
+
+                /*! A plain form field, such as `payload_json` */
+                void add_field(std::string name,
+                               std::string value,
+                               std::string content_type = std::string());
+                /*! A file part served from a mapping; the form shares it */
+                void add_file(std::string name,
+                              std::string filename,
+                              std::shared_ptr<const mapped_file> file,
+                              std::string content_type = "application/octet-stream");
+                /*! Maps `path` and adds it as a file part; throws
+                 *  std::system_error if it can't be mapped */
+                void add_file(std::string name,
+                              std::string filename,
+                              const std::string &path,
+                              std::string content_type = "application/octet-stream");
+
+                /*! A file part made of the caller's buffers, sent in order */
+                template <class ConstBufferSequence>
+                void add_buffers(std::string name,
+                                 std::string filename,
+                                 const ConstBufferSequence &buffers,
+                                 std::string content_type = "application/octet-stream")
+                {
+                    part p;
+                    p.data.assign(boost::asio::buffer_sequence_begin(buffers),
+                                  boost::asio::buffer_sequence_end(buffers));
+                    add_part(std::move(name), &filename, std::move(content_type), std::move(p));
+                }
+
+                const std::string &boundary() const { return _boundary; }
+                /*! The Content-Type header the body needs */
+                std::string content_type() const;
+                /*! Length of the whole body in bytes */
+                std::uint64_t size() const;
+                /*! The whole body, pointing into the parts' own storage */
+                std::vector<boost::asio::const_buffer> buffers() const;
+
+            private:
+                struct part
+                {
+                    /*! Boundary line and part headers */
+                    std::string head;
+                    /*! Contents of a plain field */
+                    std::string value;
+                    std::shared_ptr<const mapped_file> file;
+                    std::vector<boost::asio::const_buffer> data;
+                };
+
+                void add_part(std::string name,
+                              const std::string *filename,
+                              std::string content_type,
+                              part p);
+
+                std::string _boundary;
+                /*! The closing boundary line */
+                std::string tail;
+                std::vector<part> parts;
+        }; // class multipart_form
+
+        /*! A beast Body that writes a multipart_form. Only writing is
+         *  supported, so it can be used for requests but not responses. */
+        struct multipart_body
+        {
+            using value_type = multipart_form;
+
+            static std::uint64_t size(const value_type &body)
+            {
+                return body.size();
+            }
+
+            class writer
+            {
+                public:
+                    using const_buffers_type = std::vector<boost::asio::const_buffer>;
+
+                    template <bool isRequest, class Fields>
+                    writer(const boost::beast::http::header<isRequest, Fields> &, const value_type &body)
+                        : body(body)
+                    {
+                    }
+
+                    void init(boost::beast::error_code &ec)
+                    {
+                        ec = {};
+                    }
+
+                    /*! Hands over the whole body in one go; the serializer
+                     *  writes as much of it per call as the stream takes */
+                    boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code &ec)
+                    {
+                        ec = {};
+                        if (done)
+                        {
+                            return boost::none;
+                        }
+                        done = true;
+                        return std::make_pair(body.buffers(), false);
+                    }
+
+                private:
+                    const value_type &body;
+                    bool done = false;
+            };
+        };
+    } // namespace http
+} // namespace discpp
+
+#endif
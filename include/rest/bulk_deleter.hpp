@@ -0,0 +1,122 @@
+/*! \file bulk_deleter.hpp
+ *  \brief Gathers single message deletions into bulk-delete requests
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BULK_DELETER_HPP
+#define BULK_DELETER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "core/flat_map.hpp"
+#include "core/snowflake.hpp"
+#include "rest/rate_limit.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        class bulk_deleter
+        {
+            /*! \class bulk_deleter
+             *  \brief Deletes messages, sending as few requests as it can
+             *
+             *  Deletions are held per channel for a short window, then sent
+             *  as bulk-delete requests of up to 100 messages each. Messages
+             *  the API won't bulk delete (those older than two weeks, judging
+             *  by their id) and batches of a single message are deleted one
+             *  by one instead, as are the messages of a bulk delete refused
+             *  with 403, since the bot may still delete those it sent itself.
+             *  A channel's batch is sent early once it holds 100 messages.
+             *  Requests refused with 429 are sent again once the API allows.
+             *
+             *  Every deletion gets its own future, which resolves with the
+             *  HTTP status of the request that covered it, or with the
+             *  exception it threw. Requests are sent from a worker thread of
+             *  the deleter's own.
+             */
+            public:
+                explicit bulk_deleter(std::string token,
+                                      std::chrono::milliseconds window = std::chrono::milliseconds(500));
+                /*! Sends whatever is still held, then stops */
+                ~bulk_deleter();
+
+                bulk_deleter(const bulk_deleter &) = delete;
+                bulk_deleter &operator=(const bulk_deleter &) = delete;
+
+                /*! Queues the deletion of a message */
+                std::future<unsigned int> delete_message(snowflake channel_id, snowflake message_id);
+
+                /*! Sends every held deletion now, without waiting for windows
+                 *  to close */
+                void flush();
+
+                /*! Most messages one bulk-delete request may carry */
+                static constexpr std::size_t max_batch = 100;
+                /*! Whether the API still bulk deletes `message_id` */
+                static bool bulk_deletable(snowflake message_id);
+
+            private:
+                struct request
+                {
+                    snowflake message_id;
+                    std::promise<unsigned int> done;
+                };
+
+                struct batch
+                {
+                    std::chrono::steady_clock::time_point deadline;
+                    std::vector<request> requests;
+                };
+
+                void run();
+                /*! Sends one channel's batch */
+                void send(snowflake channel_id, std::vector<request> requests);
+                /*! Deletes one message, or many at once; both wait out 429s
+                 *  and return the status the API settles on */
+                unsigned int delete_one(snowflake channel_id, snowflake message_id);
+                unsigned int delete_many(snowflake channel_id, boost::json::array ids);
+
+                const std::string token;
+                const std::chrono::milliseconds window;
+
+                std::mutex mutex;
+                std::condition_variable wakeup;
+                snowflake_map<batch> pending;
+                bool flush_all = false;
+                bool stopping = false;
+
+                // Only the worker touches these
+                rate_limit single_bucket;
+                rate_limit bulk_bucket;
+
+                std::thread worker;
+        }; // class bulk_deleter
+    } // namespace rest
+} // namespace discpp
+
+#endif
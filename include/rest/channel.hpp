@@ -22,16 +22,63 @@
 #define CHANNEL_HPP
 
 #include "core/dis.hpp"
+#include "net/multipart.hpp"
+#include "rest/pager.hpp"
+#include "rest/route.hpp"
 
 namespace discpp
 {
+    namespace cache
+    {
+        class message_cache;
+        class reaction_index;
+    }
+
     namespace rest
     {
         namespace channel
         {
+            /*! Lets #get_channel_message and #get_channel_messages answer from
+             *  `cache` whenever it holds the complete answer, skipping the
+             *  request. Pass nullptr to stop; the cache must stay alive until
+             *  then. */
+            void use_message_cache(cache::message_cache *cache);
+            /*! Lets #get_reaction_user_ids and #get_reaction_count answer
+             *  from `index` for messages it tracks, skipping the request.
+             *  Pass nullptr to stop; the index must stay alive until then. */
+            void use_reaction_index(cache::reaction_index *index);
+
+            /*! Which page of a channel's history #get_channel_messages
+             *  returns. At most one of `before`, `after` and `around` may be
+             *  set; with none, the newest messages are returned. */
+            struct history_query
+            {
+                snowflake before;
+                snowflake after;
+                snowflake around;
+                /*! 1 to 100 */
+                unsigned int limit = 50;
+
+                /*! Appends the query string, leading `?` included, to `r`;
+                 *  throws std::invalid_argument if the query can't be sent */
+                route &append_to(route &r) const;
+            };
+
             namespace detail
             {
                 std::string get_emoji_string(emoji emoji_);
+
+                /*! The route of a message's reactions with `emoji_`, the
+                 *  emoji encoded straight into the route's buffer */
+                route emoji_route(snowflake channel_id, snowflake message_id, const emoji &emoji_);
+
+                /*! Deletes a reaction by `user`, which is either a user id or
+                 *  `@me` */
+                unsigned int delete_reaction(snowflake channel_id,
+                                             snowflake message_id,
+                                             emoji emoji_,
+                                             boost::json::string_view user,
+                                             boost::json::string_view token);
             }
             // TODO: double check return values for failed calls;
 
@@ -39,116 +86,176 @@ namespace discpp
              *
              * HTTP GET /channels/{channel.id}
              */
-            ::discpp::channel get_channel(std::string channel_id, std::string token);
+            ::discpp::channel get_channel(snowflake channel_id, boost::json::string_view token);
 
             /*! Update a channel's settings.
              *
              * HTTP PATCH /channels/{channel.id}
              */
-            ::discpp::channel modify_channel(std::string channel_id,
+            ::discpp::channel modify_channel(snowflake channel_id,
                                    boost::json::object patch,
-                                   std::string token);
+                                   boost::json::string_view token);
 
-            ::discpp::channel delete_channel(std::string channel_id, std::string token);
+            ::discpp::channel delete_channel(snowflake channel_id, boost::json::string_view token);
 
-            boost::json::array get_channel_messages(std::string channel_id,
-                                                    std::string token);
+            boost::json::array get_channel_messages(snowflake channel_id,
+                                                    boost::json::string_view token);
 
-            ::discpp::message get_channel_message(std::string channel_id,
-                                                  std::string message_id,
-                                                  std::string token);
+            /*! Get one page of a channel's history, newest message first.
+             *  Answered from the message cache, if one is in use and holds
+             *  the whole page.
+             *
+             * HTTP GET /channels/{channel.id}/messages?before=&after=&around=&limit=
+             */
+            boost::json::array get_channel_messages(snowflake channel_id,
+                                                    const history_query &query,
+                                                    boost::json::string_view token);
 
-            ::discpp::message create_message(std::string channel_id,
+            /*! Walks a channel's history from `before` (the newest message
+             *  when zero) back to its first message, 100 messages per
+             *  request. */
+            pager iterate_messages(snowflake channel_id,
+                                   boost::json::string_view token,
+                                   snowflake before = snowflake());
+
+            ::discpp::message get_channel_message(snowflake channel_id,
+                                                  snowflake message_id,
+                                                  boost::json::string_view token);
+
+            ::discpp::message create_message(snowflake channel_id,
+                                             boost::json::object msg,
+                                             boost::json::string_view token);
+
+            /*! Create a message with attachments. `files` holds the file
+             *  parts, conventionally named `files[0]`, `files[1]` and so on;
+             *  `msg` is sent alongside them as `payload_json`.
+             *
+             * HTTP POST /channels/{channel.id}/messages (multipart/form-data)
+             */
+            ::discpp::message create_message(snowflake channel_id,
                                              boost::json::object msg,
-                                             std::string token);
+                                             http::multipart_form files,
+                                             boost::json::string_view token);
 
-            unsigned int create_reaction(std::string channel_id,
-                                std::string message_id,
+            unsigned int create_reaction(snowflake channel_id,
+                                snowflake message_id,
                                 emoji emoji_,
-                                std::string token);
+                                boost::json::string_view token);
 
-            unsigned int delete_own_reaction(std::string channel_id,
-                                    std::string message_id,
+            unsigned int delete_own_reaction(snowflake channel_id,
+                                    snowflake message_id,
                                     emoji emoji_,
-                                    std::string token);
+                                    boost::json::string_view token);
 
-            unsigned int delete_user_reaction(std::string channel_id,
-                                     std::string message_id,
+            unsigned int delete_user_reaction(snowflake channel_id,
+                                     snowflake message_id,
                                      emoji emoji_,
-                                     std::string user_id,
-                                     std::string token);
+                                     snowflake user_id,
+                                     boost::json::string_view token);
 
-            boost::json::array get_reactions(std::string channel_id,
-                                             std::string message_id,
+            /*! Returns the first 25 users who reacted with `emoji_`, as
+             *  full user objects; always asks the API */
+            boost::json::array get_reactions(snowflake channel_id,
+                                             snowflake message_id,
                                              emoji emoji_,
-                                             std::string token);
+                                             boost::json::string_view token);
+
+            /*! Returns the ids of up to `limit` (1 to 100) users who reacted
+             *  with `emoji_`, in id order, starting after `after`. Answered
+             *  from the index set with #use_reaction_index when it tracks the
+             *  message, and from the API otherwise. */
+            std::vector<snowflake> get_reaction_user_ids(snowflake channel_id,
+                                                         snowflake message_id,
+                                                         emoji emoji_,
+                                                         boost::json::string_view token,
+                                                         snowflake after = snowflake(),
+                                                         unsigned int limit = 100);
+
+            /*! Returns how many users reacted with `emoji_`. Answered from
+             *  the index set with #use_reaction_index when it tracks the
+             *  message, and otherwise from the message's reaction counts,
+             *  which #get_channel_message may take from the message cache. */
+            std::size_t get_reaction_count(snowflake channel_id,
+                                           snowflake message_id,
+                                           emoji emoji_,
+                                           boost::json::string_view token);
+
+            /*! Walks every user who reacted with `emoji_`, by ascending id,
+             *  100 users per request. */
+            pager iterate_reactions(snowflake channel_id,
+                                    snowflake message_id,
+                                    emoji emoji_,
+                                    boost::json::string_view token);
 
             // TODO: should this be void?
-            void delete_all_reactions(std::string channel_id,
-                                      std::string message_id,
-                                      std::string token);
+            void delete_all_reactions(snowflake channel_id,
+                                      snowflake message_id,
+                                      boost::json::string_view token);
 
-            void delete_all_reactions_for_emoji(std::string channel_id,
-                                                std::string message_id,
+            void delete_all_reactions_for_emoji(snowflake channel_id,
+                                                snowflake message_id,
                                                 emoji emoji_,
-                                                std::string token);
+                                                boost::json::string_view token);
 
-            ::discpp::message edit_message(std::string channel_id,
-                                 std::string message_id,
+            ::discpp::message edit_message(snowflake channel_id,
+                                 snowflake message_id,
                                  boost::json::object patch,
-                                 std::string token);
+                                 boost::json::string_view token);
 
-            unsigned int delete_message(std::string channel_id,
-                                        std::string message_id,
-                                        std::string token);
+            unsigned int delete_message(snowflake channel_id,
+                                        snowflake message_id,
+                                        boost::json::string_view token);
 
-            unsigned int bulk_delete_messages(std::string channel_id,
+            unsigned int bulk_delete_messages(snowflake channel_id,
                                               boost::json::object messages,
-                                              std::string token);
+                                              boost::json::string_view token);
 
             // TODO: make sure guild channel
-            unsigned int edit_channel_permissions(std::string channel_id,
-                                                  std::string overwrite_id,
+            unsigned int edit_channel_permissions(snowflake channel_id,
+                                                  snowflake overwrite_id,
                                                   boost::json::object perms,
-                                                  std::string token);
+                                                  boost::json::string_view token);
 
             // TODO: make sure guild channel; also check; is it an array?
-            boost::json::array get_channel_invites(std::string channel_id,
-                                                   std::string token);
+            boost::json::array get_channel_invites(snowflake channel_id,
+                                                   boost::json::string_view token);
+
+            /*! #get_channel_invites as a range; the endpoint isn't paginated,
+             *  so this is a single request made on first use. */
+            pager iterate_invites(snowflake channel_id, boost::json::string_view token);
 
-            ::discpp::invite create_channel_invite(std::string channel_id,
+            ::discpp::invite create_channel_invite(snowflake channel_id,
                                          boost::json::object invite,
-                                         std::string token);
+                                         boost::json::string_view token);
 
             // TODO: make sure guild channel
-            unsigned int delete_channel_permission(std::string channel_id,
-                                                   std::string overwrite_id,
-                                                   std::string token);
+            unsigned int delete_channel_permission(snowflake channel_id,
+                                                   snowflake overwrite_id,
+                                                   boost::json::string_view token);
 
-            unsigned int trigger_typing_indicator(std::string channel_id,
-                                                  boost::json::object typing_obj,
-                                                  std::string token);
+            unsigned int trigger_typing_indicator(snowflake channel_id,
+                                                  boost::json::string_view token);
 
-            boost::json::array get_pinned_messages(std::string channel_id,
-                                                   std::string token);
+            boost::json::array get_pinned_messages(snowflake channel_id,
+                                                   boost::json::string_view token);
 
-            unsigned int add_pinned_channel_message(std::string channel_id,
-                                                    std::string message_id,
-                                                    std::string token);
+            unsigned int add_pinned_channel_message(snowflake channel_id,
+                                                    snowflake message_id,
+                                                    boost::json::string_view token);
 
-            unsigned int delete_pinned_channel_message(std::string channel_id,
-                                                       std::string message_id,
-                                                       std::string token);
+            unsigned int delete_pinned_channel_message(snowflake channel_id,
+                                                       snowflake message_id,
+                                                       boost::json::string_view token);
 
             // TODO: should this be void?
-            void group_dm_add_recipient(std::string channel_id,
-                                        std::string user_id,
+            void group_dm_add_recipient(snowflake channel_id,
+                                        snowflake user_id,
                                         boost::json::object user,
-                                        std::string token);
+                                        boost::json::string_view token);
 
-            void group_dm_remove_recipient(std::string channel_id,
-                                           std::string user_id,
-                                           std::string token);
+            void group_dm_remove_recipient(snowflake channel_id,
+                                           snowflake user_id,
+                                           boost::json::string_view token);
 
         }
     }
@@ -0,0 +1,145 @@
+/*! \file edit_coalescer.hpp
+ *  \brief Collapses bursts of edits to the same object into one request
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EDIT_COALESCER_HPP
+#define EDIT_COALESCER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "core/dis.hpp"
+#include "core/flat_map.hpp"
+#include "core/snowflake.hpp"
+#include "rest/rate_limit.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        class edit_coalescer
+        {
+            /*! \class edit_coalescer
+             *  \brief Sends message and channel edits, last writer wins
+             *
+             *  Edits are queued per target: (channel, message) for
+             *  #edit_message, the channel for #modify_channel. While an edit
+             *  waits for its rate limit bucket, later edits of the same target
+             *  are merged into it key by key, newer values winning, so only
+             *  the latest state goes out once the bucket has room. Every
+             *  caller whose edit was folded in gets the object the API sent
+             *  back for the merged request.
+             *
+             *  An edit already on the wire is never merged into; edits made
+             *  meanwhile queue up behind it. Requests are sent from a worker
+             *  thread of the coalescer's own, and edits still queued when it
+             *  is destroyed fail with std::runtime_error, as do edits the API
+             *  answers with any other status than 2xx (a 429 while the
+             *  coalescer is being destroyed included).
+             */
+            public:
+                explicit edit_coalescer(std::string token);
+                ~edit_coalescer();
+
+                edit_coalescer(const edit_coalescer &) = delete;
+                edit_coalescer &operator=(const edit_coalescer &) = delete;
+
+                std::future<::discpp::message> edit_message(snowflake channel_id,
+                                                            snowflake message_id,
+                                                            boost::json::object patch);
+                std::future<::discpp::channel> modify_channel(snowflake channel_id,
+                                                              boost::json::object patch);
+
+                struct statistics
+                {
+                    /*! Edits handed to the coalescer */
+                    std::uint64_t submitted = 0;
+                    /*! Requests actually sent, retries included */
+                    std::uint64_t sent = 0;
+                    /*! Edits folded into another before being sent */
+                    std::uint64_t merged = 0;
+                };
+                statistics stats() const;
+
+            private:
+                /*! What an edit applies to; message_id is zero for channels */
+                struct target
+                {
+                    snowflake channel_id;
+                    snowflake message_id;
+
+                    bool operator==(const target &o) const
+                    {
+                        return channel_id == o.channel_id && message_id == o.message_id;
+                    }
+                };
+
+                struct target_hash
+                {
+                    std::size_t operator()(const target &t) const
+                    {
+                        const std::uint64_t h = t.channel_id.value()
+                                                ^ (t.message_id.value() * 0x9E3779B97F4A7C15ull);
+                        return static_cast<std::size_t>(h ^ (h >> 32));
+                    }
+                };
+
+                struct pending_edit
+                {
+                    boost::json::object patch;
+                    std::vector<std::promise<boost::json::object>> waiters;
+                };
+
+                std::future<boost::json::object> submit(target t, boost::json::object patch);
+                /*! Merges `patch` into `into`, keeping the keys `into` already has */
+                static void merge_under(boost::json::object &into, const boost::json::object &patch);
+
+                void run();
+                /*! Sends one edit, requeueing it if the API refused it for
+                 *  the rate limit */
+                void send(target t, pending_edit edit);
+                rate_limit &bucket(const target &t);
+
+                const std::string token;
+
+                mutable std::mutex mutex;
+                std::condition_variable wakeup;
+                /*! Targets with a queued edit, oldest first */
+                std::deque<target> order;
+                flat_hash_map<target, pending_edit, target_hash> pending;
+                /*! Edits share a bucket per channel; so do channel changes */
+                snowflake_map<rate_limit> message_buckets;
+                snowflake_map<rate_limit> channel_buckets;
+                statistics counters;
+                bool stopping = false;
+
+                std::thread worker;
+        }; // class edit_coalescer
+    } // namespace rest
+} // namespace discpp
+
+#endif
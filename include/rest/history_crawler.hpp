@@ -0,0 +1,163 @@
+/*! \file history_crawler.hpp
+ *  \brief Walks whole channel histories, many channels at once
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HISTORY_CRAWLER_HPP
+#define HISTORY_CRAWLER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "core/flat_map.hpp"
+#include "core/snowflake.hpp"
+#include "rest/rate_limit.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        class history_crawler
+        {
+            /*! \class history_crawler
+             *  \brief Pages through channel histories, newest to oldest
+             *
+             *  Each crawl asks for 100 messages at a time with `before` set
+             *  to the oldest message seen so far, until a short page says the
+             *  start of the channel has been reached. Channels are crawled
+             *  side by side by a pool of worker threads; a channel's next page
+             *  is only requested once its rate limit bucket has room, so a
+             *  limited channel never holds up the others.
+             *
+             *  Pages go to the crawl's handler as they arrive and are not
+             *  kept, so memory stays at about one page per worker. A
+             *  channel's pages reach its handler in order and never two at a
+             *  time; handlers of different channels may run concurrently.
+             */
+            public:
+                /*! Receives one page, newest message first */
+                using page_handler = std::function<void(snowflake channel_id,
+                                                        const boost::json::array &page)>;
+
+                /*! Messages asked for per request; the API's maximum */
+                static constexpr unsigned int page_size = 100;
+
+                explicit history_crawler(std::string token, std::size_t workers = 4);
+                /*! Waits for the pages being fetched; crawls not finished by
+                 *  then fail with std::runtime_error */
+                ~history_crawler();
+
+                history_crawler(const history_crawler &) = delete;
+                history_crawler &operator=(const history_crawler &) = delete;
+
+                /*! Crawls `channel_id` from `before` (the newest message when
+                 *  zero) back to its first message. The future resolves with
+                 *  the number of messages delivered, or with the exception a
+                 *  request or the handler threw. A page refused with 429 or a
+                 *  5xx is asked for again later; any other status besides 2xx
+                 *  fails the crawl with std::runtime_error, as do 5xx answers
+                 *  that keep coming. Throws std::logic_error if the channel
+                 *  is already being crawled. */
+                std::future<std::size_t> crawl(snowflake channel_id,
+                                               page_handler handler,
+                                               snowflake before = snowflake());
+
+                /*! The oldest message delivered so far by the crawl of
+                 *  `channel_id`, to resume from with #crawl; zero if none */
+                snowflake checkpoint(snowflake channel_id) const;
+
+            private:
+                struct job
+                {
+                    snowflake channel_id;
+                    snowflake before;
+                    page_handler handler;
+                    std::size_t delivered = 0;
+                    std::promise<std::size_t> done;
+                    /*! 5xx answers in a row, and when to ask again after the
+                     *  last of them */
+                    unsigned int server_errors = 0;
+                    rate_limit::clock::time_point retry_at;
+                };
+
+                void run();
+                /*! Fetches and delivers one page; false once the crawl is over */
+                bool step(job &j);
+
+                const std::string token;
+
+                mutable std::mutex mutex;
+                std::condition_variable wakeup;
+                snowflake_map<std::unique_ptr<job>> jobs;
+                /*! Channels waiting for their next page, oldest first */
+                std::deque<snowflake> idle;
+                snowflake_map<rate_limit> buckets;
+                bool stopping = false;
+
+                std::vector<std::thread> workers;
+        }; // class history_crawler
+
+        class ndjson_writer
+        {
+            /*! \class ndjson_writer
+             *  \brief Appends crawled messages to a file, one JSON object per line
+             *
+             *  Pass #handler to history_crawler::crawl. After every page the
+             *  oldest message written for the channel is recorded in a
+             *  checkpoint file next to the output (`path` + ".checkpoint"),
+             *  which #resume_point reads back when a crawl is restarted with
+             *  the same path. The page is flushed before its checkpoint is
+             *  replaced, so after a crash the file may repeat up to one page
+             *  per channel but never skips any.
+             */
+            public:
+                /*! Opens `path` for appending; throws std::runtime_error if it
+                 *  can't be opened */
+                explicit ndjson_writer(std::string path);
+
+                void write(snowflake channel_id, const boost::json::array &page);
+                history_crawler::page_handler handler();
+
+                /*! Where a crawl of `channel_id` left off, or zero to start
+                 *  from the newest message */
+                snowflake resume_point(snowflake channel_id) const;
+
+            private:
+                void save_checkpoints();
+
+                const std::string path;
+
+                mutable std::mutex mutex;
+                std::ofstream out;
+                snowflake_map<snowflake> checkpoints;
+        }; // class ndjson_writer
+    } // namespace rest
+} // namespace discpp
+
+#endif
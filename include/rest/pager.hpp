@@ -0,0 +1,126 @@
+/*! \file pager.hpp
+ *  \brief Walks paginated list endpoints a page at a time
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PAGER_HPP
+#define PAGER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <iterator>
+
+#include <boost/json.hpp>
+
+#include "core/snowflake.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        class pager
+        {
+            /*! \class pager
+             *  \brief A list endpoint as a range, fetched as it is walked
+             *
+             *  Nothing is requested until #begin. From then on the pager
+             *  holds one page: once the walk is three quarters through it,
+             *  the next one is fetched on a detached thread, and it replaces
+             *  the current page (freeing it) once the walk reaches its end. A
+             *  page shorter than the page size, or an empty one, ends the
+             *  range. A pager given up early costs at most that one request,
+             *  and its destructor doesn't wait for it.
+             *
+             *  Each page is fetched with the id of the previous page's last
+             *  item as its cursor, starting from the cursor given to the
+             *  constructor. Errors from fetching are thrown from #begin or
+             *  from the increment that needed the page.
+             *
+             *  A pager is an input range: it can be walked once.
+             */
+            public:
+                /*! Fetches the page that follows `cursor` */
+                using fetch_function = std::function<boost::json::array(snowflake cursor)>;
+
+                class iterator
+                {
+                    public:
+                        using iterator_category = std::input_iterator_tag;
+                        using value_type = boost::json::value;
+                        using difference_type = std::ptrdiff_t;
+                        using pointer = const boost::json::value *;
+                        using reference = const boost::json::value &;
+
+                        iterator() = default;
+
+                        reference operator*() const { return owner->current(); }
+                        pointer operator->() const { return &owner->current(); }
+                        iterator &operator++() { owner->advance(); return *this; }
+                        /*! Steps forward; the old position can't be read
+                         *  afterwards, as with any input iterator */
+                        void operator++(int) { owner->advance(); }
+
+                        bool operator==(const iterator &o) const
+                        {
+                            return at_end() == o.at_end() && (at_end() || owner == o.owner);
+                        }
+                        bool operator!=(const iterator &o) const { return !(*this == o); }
+
+                    private:
+                        friend class pager;
+                        explicit iterator(pager *owner) : owner(owner) {}
+                        bool at_end() const { return !owner || owner->exhausted; }
+
+                        pager *owner = nullptr;
+                };
+
+                /*! `page_size` is the most items a page can hold; zero means
+                 *  the endpoint isn't paginated and has a single page */
+                pager(fetch_function fetch, std::size_t page_size, snowflake start = snowflake());
+
+                pager(pager &&) = default;
+                pager &operator=(pager &&) = default;
+
+                iterator begin();
+                iterator end() { return iterator(); }
+
+            private:
+                const boost::json::value &current() const;
+                void advance();
+                /*! Takes `fetched` as the current page */
+                void load(boost::json::array fetched);
+                /*! Starts fetching the page after the current one, if any */
+                void prefetch_next();
+
+                fetch_function fetch;
+                std::size_t page_size;
+                snowflake cursor;
+
+                bool started = false;
+                bool exhausted = false;
+                boost::json::array page;
+                std::size_t index = 0;
+                /*! The index at which the next page is requested */
+                std::size_t prefetch_at = 0;
+                std::future<boost::json::array> next;
+        }; // class pager
+    } // namespace rest
+} // namespace discpp
+
+#endif
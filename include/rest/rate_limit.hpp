@@ -0,0 +1,79 @@
+/*! \file rate_limit.hpp
+ *  \brief Tracks the state of REST rate limit buckets
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RATE_LIMIT_HPP
+#define RATE_LIMIT_HPP
+
+#include <chrono>
+
+#include <boost/json.hpp>
+
+namespace discpp
+{
+    namespace rest
+    {
+        class rate_limit
+        {
+            /*! \class rate_limit
+             *  \brief One rate limit bucket, as last reported by the API
+             *
+             *  Feed it every response of a route with #update; #ready_at then
+             *  tells when the next request may go out without being refused.
+             *  Until the first response, requests are assumed to be allowed.
+             */
+            public:
+                using clock = std::chrono::steady_clock;
+
+                /*! Reads the X-RateLimit-Remaining, X-RateLimit-Reset-After and
+                 *  Retry-After headers of a beast response */
+                template <class Response>
+                void update(const Response &res)
+                {
+                    update(as_view(res["x-ratelimit-remaining"]),
+                           as_view(res["x-ratelimit-reset-after"]),
+                           as_view(res["retry-after"]),
+                           res.result_int() == 429);
+                }
+
+                void update(boost::json::string_view remaining,
+                            boost::json::string_view reset_after,
+                            boost::json::string_view retry_after,
+                            bool too_many_requests);
+
+                /*! When the next request may be sent */
+                clock::time_point ready_at() const;
+                bool ready(clock::time_point now = clock::now()) const { return ready_at() <= now; }
+
+            private:
+                template <class View>
+                static boost::json::string_view as_view(const View &v)
+                {
+                    return boost::json::string_view(v.data(), v.size());
+                }
+
+                /*! Requests left in the current window */
+                long remaining = 1;
+                /*! When the window resets */
+                clock::time_point reset;
+        };
+    } // namespace rest
+} // namespace discpp
+
+#endif
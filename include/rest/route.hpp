@@ -0,0 +1,152 @@
+/*! \file route.hpp
+ *  \brief REST routes, rendered without touching the heap
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROUTE_HPP
+#define ROUTE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <boost/json.hpp>
+
+#include "core/snowflake.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        template <std::size_t Placeholders>
+        class route_template
+        {
+            /*! \class route_template
+             *  \brief A route with `{}` wherever an argument goes
+             *
+             *  Declared constexpr, a template whose text doesn't have exactly
+             *  `Placeholders` placeholders fails to compile.
+             */
+            public:
+                template <std::size_t N>
+                constexpr route_template(const char (&text)[N])
+                    : text(text), length(N - 1)
+                {
+                    count(text, N - 1) == Placeholders
+                        ? void()
+                        : throw std::logic_error("route_template placeholder count mismatch");
+                }
+
+                constexpr const char *data() const { return text; }
+                constexpr std::size_t size() const { return length; }
+
+            private:
+                static constexpr std::size_t count(const char *s, std::size_t n)
+                {
+                    std::size_t found = 0;
+                    for (std::size_t i = 0; i + 1 < n; ++i)
+                    {
+                        if (s[i] == '{' && s[i + 1] == '}')
+                        {
+                            ++found;
+                        }
+                    }
+                    return found;
+                }
+
+                const char *text;
+                std::size_t length;
+        };
+
+        /*! One argument of a route: an id, or text that is already escaped */
+        class route_arg
+        {
+            public:
+                route_arg() = default;
+                route_arg(snowflake id) : id(id), is_id(true) {}
+                route_arg(boost::json::string_view text) : text(text) {}
+                route_arg(const std::string &text) : text(text.data(), text.size()) {}
+                route_arg(const char *text) : text(text) {}
+
+            private:
+                friend class route;
+                snowflake id;
+                boost::json::string_view text;
+                bool is_id = false;
+        };
+
+        class route
+        {
+            /*! \class route
+             *  \brief A route rendered into a buffer of its own
+             *
+             *  The buffer is a fixed array inside the object, so a route
+             *  built on the stack never allocates. Appending past #capacity
+             *  throws std::length_error.
+             */
+            public:
+                static constexpr std::size_t capacity = 512;
+
+                template <std::size_t Placeholders, class... Args>
+                explicit route(const route_template<Placeholders> &t, const Args &... args)
+                {
+                    static_assert(sizeof...(Args) == Placeholders,
+                                  "route arguments don't match the template's placeholders");
+                    // One spare element, so there's an array even without
+                    // arguments
+                    const route_arg a[] = { route_arg(args)..., route_arg() };
+                    render(t.data(), t.size(), a);
+                }
+
+                route &append(boost::json::string_view s);
+                route &append(snowflake id);
+                route &append(unsigned int n);
+                /*! Appends `s` percent-encoded, as http::url_encode does */
+                route &append_encoded(boost::json::string_view s);
+
+                boost::json::string_view view() const { return boost::json::string_view(buffer, length); }
+                std::string str() const { return std::string(buffer, length); }
+
+            private:
+                void render(const char *text, std::size_t size, const route_arg *args);
+                route &append_decimal(std::uint64_t v);
+
+                char buffer[capacity];
+                std::size_t length = 0;
+        };
+
+        /*! Templates for the routes the REST wrappers call */
+        namespace routes
+        {
+            constexpr route_template<1> channel("/channels/{}");
+            constexpr route_template<1> channel_messages("/channels/{}/messages");
+            constexpr route_template<2> channel_message("/channels/{}/messages/{}");
+            constexpr route_template<1> bulk_delete("/channels/{}/messages/bulk-delete");
+            constexpr route_template<2> reactions("/channels/{}/messages/{}/reactions");
+            constexpr route_template<2> permission_overwrite("/channels/{}/permissions/{}");
+            constexpr route_template<1> channel_invites("/channels/{}/invites");
+            constexpr route_template<1> typing("/channels/{}/typing");
+            constexpr route_template<1> pins("/channels/{}/pins");
+            constexpr route_template<2> pin("/channels/{}/pins/{}");
+            constexpr route_template<2> recipient("/channels/{}/recipients/{}");
+        }
+    } // namespace rest
+} // namespace discpp
+
+#endif
@@ -0,0 +1,778 @@
+/*! \file entity_cache.cpp
+ *  \brief In-memory cache of guild state built from gateway events
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iterator>
+
+#include "cache/entity_cache.hpp"
+
+namespace discpp
+{
+    namespace cache
+    {
+        namespace
+        {
+            namespace json = boost::json;
+            using gateway::event;
+
+            /*! Events that change what the cache holds */
+            const event tracked_events[] =
+            {
+                event::ready,
+                event::guild_create, event::guild_update, event::guild_delete,
+                event::channel_create, event::channel_update, event::channel_delete,
+                event::thread_create, event::thread_update, event::thread_delete,
+                event::guild_role_create, event::guild_role_update, event::guild_role_delete,
+                event::guild_member_add, event::guild_member_update, event::guild_member_remove,
+                event::guild_members_chunk, event::guild_emojis_update,
+                event::user_update
+            };
+
+            /*! GUILD_CREATE arrays that are stored in their own tables, or not
+             *  at all, rather than in the guild object */
+            const json::string_view guild_arrays[] =
+            {
+                "channels", "threads", "roles", "members", "emojis",
+                "presences", "voice_states", "stage_instances",
+                "guild_scheduled_events"
+            };
+
+            snowflake id_at(const json::object &obj, json::string_view key)
+            {
+                const json::value *v = obj.if_contains(key);
+                return v ? snowflake::from_json(*v) : snowflake();
+            }
+
+            const json::object *object_at(const json::object &obj, json::string_view key)
+            {
+                const json::value *v = obj.if_contains(key);
+                return v ? v->if_object() : nullptr;
+            }
+
+            const json::array *array_at(const json::object &obj, json::string_view key)
+            {
+                const json::value *v = obj.if_contains(key);
+                return v ? v->if_array() : nullptr;
+            }
+
+            std::uint64_t count_at(const json::object &obj, json::string_view key)
+            {
+                const json::value *v = obj.if_contains(key);
+                if (v && v->is_int64() && v->get_int64() >= 0)
+                {
+                    return static_cast<std::uint64_t>(v->get_int64());
+                }
+                return v && v->is_uint64() ? v->get_uint64() : 0;
+            }
+
+            bool flag_at(const json::object &obj, json::string_view key)
+            {
+                const json::value *v = obj.if_contains(key);
+                return v && v->is_bool() && v->get_bool();
+            }
+
+            /*! Copies a guild object, leaving out #guild_arrays */
+            json::object without_arrays(const json::object &d)
+            {
+                json::object out;
+                for (const auto &kv : d)
+                {
+                    if (std::find(std::begin(guild_arrays), std::end(guild_arrays), kv.key())
+                            == std::end(guild_arrays))
+                    {
+                        out[kv.key()] = kv.value();
+                    }
+                }
+                return out;
+            }
+
+            /*! Applies a partial update on top of a cached object's fields */
+            json::object merged(const types::lazy_object *old, const json::object &delta)
+            {
+                json::object out = old ? old->json() : json::object();
+                for (const auto &kv : delta)
+                {
+                    out[kv.key()] = kv.value();
+                }
+                return out;
+            }
+
+            /*! The id a table key contributes to its guild's index */
+            snowflake indexed_id(snowflake key) { return key; }
+            snowflake indexed_id(const member_key &key) { return key.user; }
+
+            /*! Builds one table entry per object element of `arr` */
+            template <typename T>
+            void collect(const json::array *arr, snowflake guild_id,
+                         std::vector<std::pair<snowflake, std::shared_ptr<const T>>> &out)
+            {
+                if (!arr)
+                {
+                    return;
+                }
+                for (const json::value &v : *arr)
+                {
+                    if (const json::object *obj = v.if_object())
+                    {
+                        auto p = std::make_shared<const T>(*obj, guild_id);
+                        const snowflake id = p->id();
+                        out.emplace_back(id, std::move(p));
+                    }
+                }
+            }
+        } // anonymous namespace
+
+        void entity_cache::apply(const boost::json::value &payload)
+        {
+            const json::object *p = payload.if_object();
+            const json::value *t = p ? p->if_contains("t") : nullptr;
+            const json::object *d = p ? object_at(*p, "d") : nullptr;
+            if (!t || !t->is_string() || !d)
+            {
+                return;
+            }
+
+            const event e = gateway::to_event(t->get_string());
+            switch (e)
+            {
+                case event::ready:
+                    on_ready(*d);
+                    break;
+
+                case event::guild_create:
+                    on_guild_create(*d);
+                    break;
+
+                case event::guild_update:
+                    put_guild(*d);
+                    break;
+
+                case event::guild_delete:
+                    on_guild_delete(*d);
+                    break;
+
+                case event::channel_create:
+                case event::channel_update:
+                case event::thread_create:
+                case event::thread_update:
+                {
+                    const snowflake id = id_at(*d, "id");
+                    snowflake guild_id;
+                    channels.update(id, [d, &guild_id](const types::channel *old)
+                    {
+                        auto c = std::make_shared<const types::channel>(merged(old, *d));
+                        guild_id = c->guild_id();
+                        return c;
+                    });
+                    index_add(guild_id, &guild_index::channels, id);
+                    break;
+                }
+
+                case event::channel_delete:
+                case event::thread_delete:
+                {
+                    const snowflake id = id_at(*d, "id");
+                    if (const pointer<types::channel> c = channels.find(id))
+                    {
+                        index_remove(c->guild_id(), &guild_index::channels, id);
+                    }
+                    channels.erase(id);
+                    break;
+                }
+
+                case event::guild_role_create:
+                case event::guild_role_update:
+                    if (const json::object *r = object_at(*d, "role"))
+                    {
+                        const snowflake guild_id = id_at(*d, "guild_id");
+                        const snowflake id = id_at(*r, "id");
+                        roles.upsert(id, std::make_shared<const types::role>(*r, guild_id));
+                        index_add(guild_id, &guild_index::roles, id);
+                    }
+                    break;
+
+                case event::guild_role_delete:
+                {
+                    const snowflake id = id_at(*d, "role_id");
+                    index_remove(id_at(*d, "guild_id"), &guild_index::roles, id);
+                    roles.erase(id);
+                    break;
+                }
+
+                case event::guild_member_add:
+                case event::guild_member_update:
+                {
+                    const snowflake guild_id = id_at(*d, "guild_id");
+                    const json::object *u = object_at(*d, "user");
+                    if (!u)
+                    {
+                        return;
+                    }
+                    const snowflake user_id = id_at(*u, "id");
+                    members.update(member_key{guild_id, user_id},
+                        [d, guild_id](const types::guild_member *old)
+                        {
+                            return std::make_shared<const types::guild_member>(
+                                merged(old, *d), guild_id);
+                        });
+                    index_add(guild_id, &guild_index::members, user_id);
+                    break;
+                }
+
+                case event::guild_member_remove:
+                {
+                    const json::object *u = object_at(*d, "user");
+                    if (!u)
+                    {
+                        return;
+                    }
+                    const member_key key{id_at(*d, "guild_id"), id_at(*u, "id")};
+                    index_remove(key.guild, &guild_index::members, key.user);
+                    members.erase(key);
+                    break;
+                }
+
+                case event::guild_members_chunk:
+                {
+                    const snowflake guild_id = id_at(*d, "guild_id");
+                    if (const json::array *arr = array_at(*d, "members"))
+                    {
+                        on_members(guild_id, *arr);
+                    }
+                    if (count_at(*d, "chunk_index") + 1 >= count_at(*d, "chunk_count"))
+                    {
+                        reconcile_members(guild_id);
+                    }
+                    break;
+                }
+
+                case event::guild_emojis_update:
+                    if (const json::array *arr = array_at(*d, "emojis"))
+                    {
+                        on_emojis(id_at(*d, "guild_id"), *arr);
+                    }
+                    break;
+
+                case event::user_update:
+                {
+                    const pointer<types::user> old = self();
+                    if (old && old->id() == id_at(*d, "id"))
+                    {
+                        std::atomic_store(&self_user, pointer<types::user>(
+                            std::make_shared<const types::user>(merged(old.get(), *d))));
+                    }
+                    break;
+                }
+
+                default:
+                    return;
+            }
+
+            switch (e)
+            {
+                case event::ready:
+                    // Touches guilds wholesale, and may drop stale ones
+                    touched_all();
+                    break;
+                case event::user_update:
+                    ++current_generation;
+                    break;
+                case event::guild_create:
+                case event::guild_update:
+                case event::guild_delete:
+                    touched(id_at(*d, "id"));
+                    break;
+                default:
+                    touched(id_at(*d, "guild_id"));
+                    break;
+            }
+        }
+
+        void entity_cache::attach(gateway::dispatcher &d)
+        {
+            for (event e : tracked_events)
+            {
+                d.on(e, [this](const boost::json::value &payload) { apply(payload); },
+                     gateway::execution::sync);
+            }
+        }
+
+        gateway::guild_stream_handlers entity_cache::stream_handlers()
+        {
+            gateway::guild_stream_handlers h;
+            h.on_member = [this](json::string_view guild, ::discpp::guild_member &&m)
+            {
+                const json::object *u = object_at(m, "user");
+                if (guild.empty() || !u)
+                {
+                    return;
+                }
+                const snowflake guild_id = snowflake::from_string(guild);
+                const snowflake user_id = id_at(*u, "id");
+                auto p = std::make_shared<const types::guild_member>(m, guild_id);
+
+                std::lock_guard<std::mutex> g(staging_mutex);
+                staging[guild_id].members.emplace_back(member_key{guild_id, user_id}, std::move(p));
+            };
+            h.on_channel = [this](json::string_view guild, ::discpp::channel &&c)
+            {
+                if (guild.empty())
+                {
+                    return;
+                }
+                const snowflake guild_id = snowflake::from_string(guild);
+                auto p = std::make_shared<const types::channel>(c, guild_id);
+
+                std::lock_guard<std::mutex> g(staging_mutex);
+                staging[guild_id].channels.emplace_back(p->id(), std::move(p));
+            };
+            h.on_role = [this](json::string_view guild, ::discpp::role &&r)
+            {
+                if (guild.empty())
+                {
+                    return;
+                }
+                const snowflake guild_id = snowflake::from_string(guild);
+                auto p = std::make_shared<const types::role>(r, guild_id);
+
+                std::lock_guard<std::mutex> g(staging_mutex);
+                staging[guild_id].roles.emplace_back(p->id(), std::move(p));
+            };
+            h.on_guild = [this](::discpp::guild &&g)
+            {
+                // Events read before this GUILD_CREATE may not have been
+                // applied yet, so the batch waits for the trimmed event,
+                // which on_guild_create sees in socket order
+                const snowflake guild_id = id_at(g, "id");
+                std::lock_guard<std::mutex> lock(staging_mutex);
+                staged_guild batch;
+                if (staged_guild *s = staging.find(guild_id))
+                {
+                    batch = std::move(*s);
+                    staging.erase(guild_id);
+                }
+                streamed[guild_id].push_back(std::move(batch));
+            };
+            return h;
+        }
+
+        std::vector<entity_cache::pointer<types::channel>>
+        entity_cache::guild_channels(snowflake guild_id) const
+        {
+            std::vector<pointer<types::channel>> out;
+            for (snowflake id : indexed(guild_id, &guild_index::channels))
+            {
+                if (pointer<types::channel> c = channels.find(id))
+                {
+                    out.push_back(std::move(c));
+                }
+            }
+            return out;
+        }
+
+        std::vector<entity_cache::pointer<types::role>>
+        entity_cache::guild_roles(snowflake guild_id) const
+        {
+            std::vector<pointer<types::role>> out;
+            for (snowflake id : indexed(guild_id, &guild_index::roles))
+            {
+                if (pointer<types::role> r = roles.find(id))
+                {
+                    out.push_back(std::move(r));
+                }
+            }
+            return out;
+        }
+
+        std::vector<entity_cache::pointer<types::guild_member>>
+        entity_cache::guild_members(snowflake guild_id) const
+        {
+            std::vector<pointer<types::guild_member>> out;
+            for (snowflake user_id : indexed(guild_id, &guild_index::members))
+            {
+                if (pointer<types::guild_member> m = members.find(member_key{guild_id, user_id}))
+                {
+                    out.push_back(std::move(m));
+                }
+            }
+            return out;
+        }
+
+        entity_counts entity_cache::counts() const
+        {
+            return entity_counts{guilds.size(), channels.size(), roles.size(),
+                                 members.size(), emojis.size()};
+        }
+
+        void entity_cache::on_ready(const boost::json::object &d)
+        {
+            if (const json::object *u = object_at(d, "user"))
+            {
+                std::atomic_store(&self_user, pointer<types::user>(
+                    std::make_shared<const types::user>(*u)));
+            }
+            // READY only lists the guilds, as unavailable; their contents
+            // follow in GUILD_CREATEs. Keep whatever we already know of them.
+            snowflake_map<bool> listed;
+            if (const json::array *arr = array_at(d, "guilds"))
+            {
+                for (const json::value &v : *arr)
+                {
+                    if (const json::object *g = v.if_object())
+                    {
+                        const snowflake guild_id = id_at(*g, "id");
+                        listed.insert(guild_id, true);
+                        guilds.update(guild_id, [g](const types::guild *old)
+                        {
+                            return std::make_shared<const types::guild>(merged(old, *g));
+                        });
+                    }
+                }
+            }
+
+            // Guilds restored from a snapshot that READY doesn't list were
+            // left while we were away
+            std::vector<snowflake> gone;
+            {
+                std::lock_guard<std::mutex> g(stale_mutex);
+                stale.erase_if([&](snowflake guild_id, bool)
+                {
+                    if (listed.contains(guild_id))
+                    {
+                        return false;
+                    }
+                    gone.push_back(guild_id);
+                    return true;
+                });
+            }
+            for (snowflake guild_id : gone)
+            {
+                guilds.erase(guild_id);
+                forget_guild(guild_id);
+            }
+        }
+
+        void entity_cache::on_guild_create(const boost::json::object &d)
+        {
+            const snowflake guild_id = id_at(d, "id");
+            if (flag_at(d, "unavailable"))
+            {
+                put_guild(d);
+                return;
+            }
+
+            // A streamed GUILD_CREATE (see stream_handlers) arrives without
+            // its streamed arrays, which wait in a batch of their own
+            staged_guild batch;
+            bool was_streamed = false;
+            {
+                std::lock_guard<std::mutex> g(staging_mutex);
+                if (std::deque<staged_guild> *q = streamed.find(guild_id))
+                {
+                    batch = std::move(q->front());
+                    q->pop_front();
+                    if (q->empty())
+                    {
+                        streamed.erase(guild_id);
+                    }
+                    was_streamed = true;
+                }
+            }
+
+            // Either way it's the full state of the guild. The guild itself
+            // goes first, so its contents never show up under the old one.
+            guilds.upsert(guild_id, std::make_shared<const types::guild>(without_arrays(d)));
+            if (was_streamed || array_at(d, "channels"))
+            {
+                forget_guild(guild_id, !flag_at(d, "large"));
+
+                // Threads aren't streamed, so they are in the event either way
+                std::vector<entry<types::channel>> new_channels = std::move(batch.channels);
+                collect<types::channel>(array_at(d, "channels"), guild_id, new_channels);
+                collect<types::channel>(array_at(d, "threads"), guild_id, new_channels);
+                index_add(guild_id, &guild_index::channels, new_channels);
+                channels.upsert_many(std::move(new_channels));
+
+                std::vector<entry<types::role>> new_roles = std::move(batch.roles);
+                collect<types::role>(array_at(d, "roles"), guild_id, new_roles);
+                index_add(guild_id, &guild_index::roles, new_roles);
+                roles.upsert_many(std::move(new_roles));
+
+                index_add(guild_id, &guild_index::members, batch.members);
+                members.upsert_many(std::move(batch.members));
+            }
+            if (const json::array *arr = array_at(d, "members"))
+            {
+                on_members(guild_id, *arr);
+            }
+            if (const json::array *arr = array_at(d, "emojis"))
+            {
+                on_emojis(guild_id, *arr);
+            }
+            mark_fresh(guild_id);
+        }
+
+        void entity_cache::on_guild_delete(const boost::json::object &d)
+        {
+            const snowflake guild_id = id_at(d, "id");
+            if (flag_at(d, "unavailable"))
+            {
+                // An outage: the guild is still ours, so keep its state
+                put_guild(d);
+                return;
+            }
+            guilds.erase(guild_id);
+            forget_guild(guild_id);
+        }
+
+        void entity_cache::on_members(snowflake guild_id, const boost::json::array &arr)
+        {
+            std::vector<std::pair<member_key, pointer<types::guild_member>>> batch;
+            batch.reserve(arr.size());
+            for (const json::value &v : arr)
+            {
+                const json::object *m = v.if_object();
+                const json::object *u = m ? object_at(*m, "user") : nullptr;
+                if (u)
+                {
+                    batch.emplace_back(member_key{guild_id, id_at(*u, "id")},
+                        std::make_shared<const types::guild_member>(*m, guild_id));
+                }
+            }
+            index_add(guild_id, &guild_index::members, batch);
+            members.upsert_many(std::move(batch));
+        }
+
+        void entity_cache::on_emojis(snowflake guild_id, const boost::json::array &arr)
+        {
+            // The list is always complete, so emojis missing from it are gone
+            std::vector<snowflake> old_ids;
+            {
+                std::lock_guard<std::mutex> g(index_mutex);
+                if (guild_index *ix = by_guild.find(guild_id))
+                {
+                    ix->emojis.for_each([&old_ids](snowflake id, bool) { old_ids.push_back(id); });
+                    ix->emojis.clear();
+                }
+            }
+            emojis.erase_many(std::move(old_ids));
+
+            std::vector<entry<types::emoji>> batch;
+            collect<types::emoji>(&arr, guild_id, batch);
+            index_add(guild_id, &guild_index::emojis, batch);
+            emojis.upsert_many(std::move(batch));
+        }
+
+        void entity_cache::forget_guild(snowflake guild_id, bool forget_members)
+        {
+            guild_index ix;
+            {
+                std::lock_guard<std::mutex> g(index_mutex);
+                guild_index *current = by_guild.find(guild_id);
+                if (!current)
+                {
+                    return;
+                }
+                ix.channels = std::move(current->channels);
+                ix.roles = std::move(current->roles);
+                ix.emojis = std::move(current->emojis);
+                current->channels.clear();
+                current->roles.clear();
+                current->emojis.clear();
+                if (forget_members)
+                {
+                    ix.members = std::move(current->members);
+                    by_guild.erase(guild_id);
+                }
+                else
+                {
+                    // Kept, but the guild's member list hasn't vouched for
+                    // them; see reconcile_members
+                    current->unconfirmed = current->members;
+                }
+            }
+
+            const auto ids = [](const snowflake_map<bool> &set)
+            {
+                std::vector<snowflake> out;
+                out.reserve(set.size());
+                set.for_each([&out](snowflake id, bool) { out.push_back(id); });
+                return out;
+            };
+            channels.erase_many(ids(ix.channels));
+            roles.erase_many(ids(ix.roles));
+            emojis.erase_many(ids(ix.emojis));
+
+            std::vector<member_key> keys;
+            keys.reserve(ix.members.size());
+            ix.members.for_each([&keys, guild_id](snowflake user_id, bool)
+            {
+                keys.push_back(member_key{guild_id, user_id});
+            });
+            members.erase_many(std::move(keys));
+        }
+
+        void entity_cache::index_add(snowflake guild_id, id_set ids, snowflake id)
+        {
+            if (!guild_id)
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> g(index_mutex);
+            guild_index &ix = by_guild[guild_id];
+            (ix.*ids).insert(id, true);
+            if (ids == &guild_index::members)
+            {
+                ix.unconfirmed.erase(id);
+            }
+        }
+
+        template <typename Key, typename T>
+        void entity_cache::index_add(snowflake guild_id, id_set ids,
+                                     const std::vector<std::pair<Key, pointer<T>>> &batch)
+        {
+            if (!guild_id || batch.empty())
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> g(index_mutex);
+            guild_index &ix = by_guild[guild_id];
+            snowflake_map<bool> &set = ix.*ids;
+            set.reserve(set.size() + batch.size());
+            const bool confirms = ids == &guild_index::members && !ix.unconfirmed.empty();
+            for (const auto &e : batch)
+            {
+                set.insert(indexed_id(e.first), true);
+                if (confirms)
+                {
+                    ix.unconfirmed.erase(indexed_id(e.first));
+                }
+            }
+        }
+
+        void entity_cache::index_remove(snowflake guild_id, id_set ids, snowflake id)
+        {
+            std::lock_guard<std::mutex> g(index_mutex);
+            if (guild_index *ix = by_guild.find(guild_id))
+            {
+                (ix->*ids).erase(id);
+                ix->unconfirmed.erase(id);
+            }
+        }
+
+        void entity_cache::reconcile_members(snowflake guild_id)
+        {
+            const pointer<types::guild> g = guild(guild_id);
+            if (!g || !g->has(types::guild::field::member_count))
+            {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(index_mutex);
+                const guild_index *ix = by_guild.find(guild_id);
+                if (!ix || ix->unconfirmed.empty()
+                    || ix->members.size() - ix->unconfirmed.size() < g->member_count())
+                {
+                    return;
+                }
+            }
+            drop_unconfirmed_members(guild_id);
+        }
+
+        std::size_t entity_cache::drop_unconfirmed_members(snowflake guild_id)
+        {
+            std::vector<member_key> keys;
+            {
+                std::lock_guard<std::mutex> g(index_mutex);
+                guild_index *ix = by_guild.find(guild_id);
+                if (!ix)
+                {
+                    return 0;
+                }
+                keys.reserve(ix->unconfirmed.size());
+                ix->unconfirmed.for_each([&](snowflake user_id, bool)
+                {
+                    keys.push_back(member_key{guild_id, user_id});
+                    ix->members.erase(user_id);
+                });
+                ix->unconfirmed.clear();
+            }
+            const std::size_t dropped = members.erase_many(std::move(keys));
+            if (dropped)
+            {
+                touched(guild_id);
+            }
+            return dropped;
+        }
+
+        std::uint64_t entity_cache::generation(snowflake guild_id) const
+        {
+            std::lock_guard<std::mutex> g(generation_mutex);
+            const std::uint64_t *last = guild_generations.find(guild_id);
+            return std::max(last ? *last : 0, all_generation);
+        }
+
+        void entity_cache::touched(snowflake guild_id)
+        {
+            std::lock_guard<std::mutex> g(generation_mutex);
+            guild_generations.insert_or_assign(guild_id, ++current_generation);
+        }
+
+        void entity_cache::touched_all()
+        {
+            std::lock_guard<std::mutex> g(generation_mutex);
+            all_generation = ++current_generation;
+        }
+
+        std::vector<snowflake> entity_cache::indexed(snowflake guild_id, id_set ids) const
+        {
+            std::vector<snowflake> out;
+            std::lock_guard<std::mutex> g(index_mutex);
+            if (const guild_index *ix = by_guild.find(guild_id))
+            {
+                const snowflake_map<bool> &set = ix->*ids;
+                out.reserve(set.size());
+                set.for_each([&out](snowflake id, bool) { out.push_back(id); });
+            }
+            return out;
+        }
+
+        void entity_cache::mark_fresh(snowflake guild_id)
+        {
+            std::lock_guard<std::mutex> g(stale_mutex);
+            stale.erase(guild_id);
+        }
+
+        bool entity_cache::is_stale(snowflake guild_id) const
+        {
+            std::lock_guard<std::mutex> g(stale_mutex);
+            return stale.contains(guild_id);
+        }
+
+        void entity_cache::put_guild(const boost::json::object &d)
+        {
+            const json::object delta = without_arrays(d);
+            guilds.update(id_at(d, "id"), [&delta](const types::guild *old)
+            {
+                return std::make_shared<const types::guild>(merged(old, delta));
+            });
+        }
+    } // namespace cache
+} // namespace discpp
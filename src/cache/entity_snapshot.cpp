@@ -0,0 +1,638 @@
+/*! \file entity_snapshot.cpp
+ *  \brief Saving and restoring an entity_cache through a snapshot file
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*  Layout of a snapshot, all integers in host byte order:
+ *
+ *      char[8]  magic, "DISCPPSN"
+ *      u32      0x01020304, to reject files from hosts of other endianness
+ *      u32      version
+ *      u32      number of tables
+ *
+ *  then for each table:
+ *
+ *      u32      kind (table_kind below)
+ *      u64      number of records
+ *      u64      size of the records, in bytes
+ *
+ *  Records are the typed objects' own fields, written as they are held in
+ *  memory (see snapshot_codec), so loading copies them back without parsing
+ *  any JSON. Strings are a u32 length followed by their bytes, and arrays a
+ *  u32 count followed by their elements. Unknown table kinds are skipped,
+ *  so new kinds can be added without a version bump; a change to the fields
+ *  of a type needs one.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <unistd.h>
+
+#include "cache/entity_cache.hpp"
+#include "core/mapped_file.hpp"
+
+namespace discpp
+{
+    namespace cache
+    {
+        namespace
+        {
+            const char magic[8] = {'D', 'I', 'S', 'C', 'P', 'P', 'S', 'N'};
+            constexpr std::uint32_t snapshot_version = 2;
+            constexpr std::uint32_t endian_check = 0x01020304;
+            constexpr std::uint32_t endian_swapped = 0x04030201;
+
+            enum class table_kind : std::uint32_t
+            {
+                guilds   = 1,
+                channels = 2,
+                roles    = 3,
+                members  = 4,
+                emojis   = 5,
+                self     = 6
+            };
+
+            class snapshot_writer
+            {
+                public:
+                    explicit snapshot_writer(const std::string &path)
+                        : path(path), file(std::fopen(path.c_str(), "wb"))
+                    {
+                        if (!file)
+                        {
+                            throw std::system_error(errno, std::generic_category(), "open " + path);
+                        }
+                    }
+
+                    ~snapshot_writer()
+                    {
+                        if (file)
+                        {
+                            std::fclose(file);
+                            std::remove(path.c_str());
+                        }
+                    }
+
+                    template <typename T>
+                    void put(const T &v)
+                    {
+                        write(&v, sizeof(v));
+                    }
+
+                    void write(const void *p, std::size_t n)
+                    {
+                        if (n > 0 && std::fwrite(p, 1, n, file) != n)
+                        {
+                            fail("write");
+                        }
+                    }
+
+                    /*! Writes one table; the records are encoded into #buffer
+                     *  first, so the table's size is known up front */
+                    template <typename T>
+                    void table(table_kind kind, const std::vector<std::shared_ptr<const T>> &records);
+
+                    /*! Flushes the file to disk and closes it */
+                    void commit()
+                    {
+                        if (std::fflush(file) != 0 || ::fsync(fileno(file)) != 0)
+                        {
+                            fail("sync");
+                        }
+                        std::FILE *f = file;
+                        file = nullptr;
+                        if (std::fclose(f) != 0)
+                        {
+                            const int err = errno;
+                            std::remove(path.c_str());
+                            throw std::system_error(err, std::generic_category(), "close " + path);
+                        }
+                    }
+
+                private:
+                    [[noreturn]] void fail(const char *what)
+                    {
+                        throw std::system_error(errno, std::generic_category(),
+                                                std::string(what) + " " + path);
+                    }
+
+                    const std::string path;
+                    std::FILE *file;
+                    std::string buffer;
+            };
+
+            class snapshot_reader
+            {
+                public:
+                    snapshot_reader(const char *begin, const char *end)
+                        : pos(begin), end(end) {}
+
+                    template <typename T>
+                    T get()
+                    {
+                        T v;
+                        std::memcpy(&v, take(sizeof(v)), sizeof(v));
+                        return v;
+                    }
+
+                    const char *take(std::size_t n)
+                    {
+                        if (static_cast<std::size_t>(end - pos) < n)
+                        {
+                            throw std::runtime_error("snapshot: truncated file");
+                        }
+                        const char *p = pos;
+                        pos += n;
+                        return p;
+                    }
+
+                    bool done() const { return pos == end; }
+
+                private:
+                    const char *pos;
+                    const char *end;
+            };
+
+            /*! Appends fields to a buffer */
+            class encoder
+            {
+                public:
+                    explicit encoder(std::string &out) : out(out) {}
+
+                    template <typename T>
+                    void operator()(const T &v)
+                    {
+                        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                                      "no encoding for this type");
+                        out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+                    }
+
+                    void operator()(const snowflake &v) { (*this)(v.value()); }
+
+                    void operator()(const types::text_ref &v)
+                    {
+                        (*this)(v.offset);
+                        (*this)(v.size);
+                    }
+
+                    void operator()(const std::string &v)
+                    {
+                        (*this)(static_cast<std::uint32_t>(v.size()));
+                        out.append(v);
+                    }
+
+                    void operator()(const types::overwrite &v)
+                    {
+                        (*this)(v.id);
+                        (*this)(v.type);
+                        (*this)(v.allow);
+                        (*this)(v.deny);
+                    }
+
+                    template <typename T>
+                    void operator()(const std::vector<T> &v)
+                    {
+                        (*this)(static_cast<std::uint32_t>(v.size()));
+                        for (const T &e : v)
+                        {
+                            (*this)(e);
+                        }
+                    }
+
+                    /*! Only the decoder checks text fields */
+                    void strings(const std::string &, const std::string &) {}
+
+                private:
+                    std::string &out;
+            };
+
+            /*! Reads fields back, checking that they stay within the record */
+            class decoder
+            {
+                public:
+                    explicit decoder(snapshot_reader &in) : in(in) {}
+
+                    template <typename T>
+                    void operator()(T &v)
+                    {
+                        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                                      "no decoding for this type");
+                        v = in.get<T>();
+                    }
+
+                    void operator()(snowflake &v) { v = snowflake(in.get<std::uint64_t>()); }
+
+                    void operator()(types::text_ref &v)
+                    {
+                        (*this)(v.offset);
+                        (*this)(v.size);
+                        // A text field is a view into one of the object's
+                        // strings, so it must not point past them
+                        const bool unescaped = v.size & types::text_ref::unescaped;
+                        const std::size_t limit = unescaped ? text_size : source_size;
+                        const std::size_t size = v.size & ~types::text_ref::unescaped;
+                        if (v.offset > limit || size > limit - v.offset)
+                        {
+                            throw std::runtime_error("snapshot: text field out of bounds");
+                        }
+                    }
+
+                    void operator()(std::string &v)
+                    {
+                        const std::uint32_t size = in.get<std::uint32_t>();
+                        v.assign(in.take(size), size);
+                    }
+
+                    void operator()(types::overwrite &v)
+                    {
+                        (*this)(v.id);
+                        (*this)(v.type);
+                        (*this)(v.allow);
+                        (*this)(v.deny);
+                    }
+
+                    template <typename T>
+                    void operator()(std::vector<T> &v)
+                    {
+                        // Not reserved up front, so a corrupt count runs into
+                        // the end of the table instead of exhausting memory
+                        const std::uint32_t count = in.get<std::uint32_t>();
+                        v.clear();
+                        for (std::uint32_t i = 0; i < count; ++i)
+                        {
+                            v.emplace_back();
+                            (*this)(v.back());
+                        }
+                    }
+
+                    void strings(const std::string &source, const std::string &text)
+                    {
+                        source_size = source.size();
+                        text_size = text.size();
+                    }
+
+                private:
+                    snapshot_reader &in;
+                    std::size_t source_size = 0;
+                    std::size_t text_size = 0;
+            };
+
+            template <typename T>
+            std::vector<std::shared_ptr<const T>> contents(const rcu_table<snowflake, T> &table)
+            {
+                std::vector<std::shared_ptr<const T>> out;
+                out.reserve(table.size());
+                table.for_each([&](snowflake, const std::shared_ptr<const T> &v)
+                {
+                    out.push_back(v);
+                });
+                return out;
+            }
+        } // anonymous namespace
+    } // namespace cache
+
+    namespace types
+    {
+        namespace detail
+        {
+            /*! Lists the fields of each typed object, in snapshot order. The
+             *  same list drives the encoder and the decoder, so they can't
+             *  drift apart. */
+            struct snapshot_codec
+            {
+                template <typename Archive>
+                static void base(Archive &a, lazy_object &o)
+                {
+                    a(o._source);
+                    a(o._text);
+                    std::uint64_t extra = o._extra_bytes;
+                    a(extra);
+                    o._extra_bytes = static_cast<std::size_t>(extra);
+                    a.strings(o._source, o._text);
+                }
+
+                template <typename Archive>
+                static void fields(Archive &a, user &o)
+                {
+                    base(a, o);
+                    a(o._id);
+                    a(o._username);
+                    a(o._global_name);
+                    a(o._avatar);
+                    a(o._present);
+                }
+
+                template <typename Archive>
+                static void fields(Archive &a, guild_member &o)
+                {
+                    base(a, o);
+                    a(o._user_id);
+                    a(o._guild_id);
+                    a(o._roles);
+                    a(o._nick);
+                    a(o._joined_at);
+                    a(o._present);
+                }
+
+                template <typename Archive>
+                static void fields(Archive &a, role &o)
+                {
+                    base(a, o);
+                    a(o._id);
+                    a(o._guild_id);
+                    a(o._name);
+                    a(o._permissions);
+                    a(o._position);
+                    a(o._color);
+                    a(o._present);
+                }
+
+                template <typename Archive>
+                static void fields(Archive &a, channel &o)
+                {
+                    base(a, o);
+                    a(o._id);
+                    a(o._guild_id);
+                    a(o._parent_id);
+                    a(o._overwrites);
+                    a(o._name);
+                    a(o._topic);
+                    a(o._position);
+                    a(o._type);
+                    a(o._present);
+                }
+
+                template <typename Archive>
+                static void fields(Archive &a, emoji &o)
+                {
+                    base(a, o);
+                    a(o._id);
+                    a(o._guild_id);
+                    a(o._name);
+                    a(o._present);
+                }
+
+                template <typename Archive>
+                static void fields(Archive &a, guild &o)
+                {
+                    base(a, o);
+                    a(o._id);
+                    a(o._owner_id);
+                    a(o._name);
+                    a(o._icon);
+                    a(o._member_count);
+                    a(o._present);
+                }
+
+                template <typename T>
+                static void encode(cache::encoder &a, const T &o)
+                {
+                    // The encoder only reads, so the cast is safe
+                    fields(a, const_cast<T&>(o));
+                }
+
+                template <typename T>
+                static std::shared_ptr<const T> decode(cache::decoder &a)
+                {
+                    auto o = std::make_shared<T>();
+                    fields(a, *o);
+                    return o;
+                }
+            };
+        } // namespace detail
+    } // namespace types
+
+    namespace cache
+    {
+        namespace
+        {
+            using types::detail::snapshot_codec;
+
+            template <typename T>
+            void snapshot_writer::table(table_kind kind,
+                                        const std::vector<std::shared_ptr<const T>> &records)
+            {
+                buffer.clear();
+                encoder e(buffer);
+                for (const auto &r : records)
+                {
+                    snapshot_codec::encode(e, *r);
+                }
+                put(static_cast<std::uint32_t>(kind));
+                put(static_cast<std::uint64_t>(records.size()));
+                put(static_cast<std::uint64_t>(buffer.size()));
+                write(buffer.data(), buffer.size());
+            }
+
+            template <typename T>
+            void decode_table(decoder &d, std::uint64_t count,
+                              std::vector<std::pair<snowflake, std::shared_ptr<const T>>> &out)
+            {
+                for (std::uint64_t i = 0; i < count; ++i)
+                {
+                    std::shared_ptr<const T> o = snapshot_codec::decode<T>(d);
+                    const snowflake id = o->id();
+                    out.emplace_back(id, std::move(o));
+                }
+            }
+
+            void decode_table(decoder &d, std::uint64_t count,
+                              std::vector<std::pair<member_key,
+                                                    std::shared_ptr<const types::guild_member>>> &out)
+            {
+                for (std::uint64_t i = 0; i < count; ++i)
+                {
+                    auto m = snapshot_codec::decode<types::guild_member>(d);
+                    const member_key key{m->guild_id(), m->user_id()};
+                    out.emplace_back(key, std::move(m));
+                }
+            }
+        } // anonymous namespace
+
+        void entity_cache::save_snapshot(const std::string &path) const
+        {
+            const std::string temp = path + ".tmp";
+            snapshot_writer w(temp);
+
+            std::vector<pointer<types::guild_member>> member_list;
+            member_list.reserve(members.size());
+            members.for_each([&](const member_key &, const pointer<types::guild_member> &m)
+            {
+                member_list.push_back(m);
+            });
+            std::vector<pointer<types::user>> self_list;
+            if (pointer<types::user> u = self())
+            {
+                self_list.push_back(std::move(u));
+            }
+
+            w.write(magic, sizeof(magic));
+            w.put(endian_check);
+            w.put(snapshot_version);
+            w.put(std::uint32_t(6));
+            w.table(table_kind::guilds, contents(guilds));
+            w.table(table_kind::channels, contents(channels));
+            w.table(table_kind::roles, contents(roles));
+            w.table(table_kind::members, member_list);
+            w.table(table_kind::emojis, contents(emojis));
+            w.table(table_kind::self, self_list);
+            w.commit();
+
+            if (std::rename(temp.c_str(), path.c_str()) != 0)
+            {
+                const int err = errno;
+                std::remove(temp.c_str());
+                throw std::system_error(err, std::generic_category(), "rename " + temp);
+            }
+        }
+
+        std::size_t entity_cache::load_snapshot(const std::string &path)
+        {
+            const mapped_file file(path, mapped_file::access_hint::sequential);
+            snapshot_reader r(file.data(), file.data() + file.size());
+
+            if (std::memcmp(r.take(sizeof(magic)), magic, sizeof(magic)) != 0)
+            {
+                throw std::runtime_error("snapshot: not a snapshot file");
+            }
+            // Checked before the version, which would read byte-swapped too
+            const std::uint32_t endian = r.get<std::uint32_t>();
+            if (endian == endian_swapped)
+            {
+                throw std::runtime_error("snapshot: written on a host of different byte order");
+            }
+            if (endian != endian_check || r.get<std::uint32_t>() != snapshot_version)
+            {
+                // Version 1 had the version where the marker now is
+                throw std::runtime_error("snapshot: unsupported version");
+            }
+
+            // Everything is decoded first, so a corrupt file changes nothing
+            std::vector<entry<types::guild>> new_guilds;
+            std::vector<entry<types::channel>> new_channels;
+            std::vector<entry<types::role>> new_roles;
+            std::vector<std::pair<member_key, pointer<types::guild_member>>> new_members;
+            std::vector<entry<types::emoji>> new_emojis;
+            pointer<types::user> new_self;
+
+            const std::uint32_t tables = r.get<std::uint32_t>();
+            std::size_t records = 0;
+            for (std::uint32_t t = 0; t < tables; ++t)
+            {
+                const auto kind = static_cast<table_kind>(r.get<std::uint32_t>());
+                const std::uint64_t count = r.get<std::uint64_t>();
+                const std::uint64_t bytes = r.get<std::uint64_t>();
+                if (bytes > std::numeric_limits<std::size_t>::max())
+                {
+                    throw std::runtime_error("snapshot: truncated file");
+                }
+                const char *begin = r.take(static_cast<std::size_t>(bytes));
+                snapshot_reader table(begin, begin + bytes);
+                decoder d(table);
+
+                switch (kind)
+                {
+                    case table_kind::guilds:
+                        decode_table(d, count, new_guilds);
+                        break;
+                    case table_kind::channels:
+                        decode_table(d, count, new_channels);
+                        break;
+                    case table_kind::roles:
+                        decode_table(d, count, new_roles);
+                        break;
+                    case table_kind::members:
+                        decode_table(d, count, new_members);
+                        break;
+                    case table_kind::emojis:
+                        decode_table(d, count, new_emojis);
+                        break;
+                    case table_kind::self:
+                        for (std::uint64_t i = 0; i < count; ++i)
+                        {
+                            new_self = snapshot_codec::decode<types::user>(d);
+                        }
+                        break;
+                    default:
+                        continue;
+                }
+                if (!table.done())
+                {
+                    throw std::runtime_error("snapshot: trailing data in a table");
+                }
+                records += static_cast<std::size_t>(count);
+            }
+            if (!r.done())
+            {
+                throw std::runtime_error("snapshot: trailing data");
+            }
+
+            {
+                std::lock_guard<std::mutex> g(stale_mutex);
+                for (const auto &e : new_guilds)
+                {
+                    stale.insert_or_assign(e.first, true);
+                }
+            }
+            {
+                std::lock_guard<std::mutex> g(index_mutex);
+                const auto index = [this](snowflake guild_id, id_set ids, snowflake id)
+                {
+                    if (guild_id)
+                    {
+                        (by_guild[guild_id].*ids).insert(id, true);
+                    }
+                };
+                for (const auto &e : new_channels)
+                {
+                    index(e.second->guild_id(), &guild_index::channels, e.first);
+                }
+                for (const auto &e : new_roles)
+                {
+                    index(e.second->guild_id(), &guild_index::roles, e.first);
+                }
+                for (const auto &e : new_members)
+                {
+                    index(e.first.guild, &guild_index::members, e.first.user);
+                }
+                for (const auto &e : new_emojis)
+                {
+                    index(e.second->guild_id(), &guild_index::emojis, e.first);
+                }
+            }
+            guilds.upsert_many(std::move(new_guilds));
+            channels.upsert_many(std::move(new_channels));
+            roles.upsert_many(std::move(new_roles));
+            members.upsert_many(std::move(new_members));
+            emojis.upsert_many(std::move(new_emojis));
+            if (new_self && !self())
+            {
+                std::atomic_store(&self_user, new_self);
+            }
+            touched_all();
+            return records;
+        }
+    } // namespace cache
+} // namespace discpp
@@ -0,0 +1,426 @@
+/*! \file message_cache.cpp
+ *  \brief Memory-bounded cache of recent channel messages
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+#include "cache/message_cache.hpp"
+
+namespace discpp
+{
+    namespace cache
+    {
+        namespace
+        {
+            namespace json = boost::json;
+            using gateway::event;
+
+            snowflake id_at(const json::object &obj, json::string_view key)
+            {
+                const json::value *v = obj.if_contains(key);
+                return v ? snowflake::from_json(*v) : snowflake();
+            }
+
+            bool id_less(const message_cache::pointer &m, snowflake id)
+            {
+                return m->id() < id;
+            }
+
+            bool less_id(snowflake id, const message_cache::pointer &m)
+            {
+                return id < m->id();
+            }
+        } // anonymous namespace
+
+        constexpr std::size_t message_cache::default_limit;
+        constexpr std::size_t message_cache::max_limit;
+
+        message_cache::message_cache(std::size_t byte_budget, std::size_t per_channel)
+            : budget(byte_budget),
+              per_channel(per_channel ? per_channel : 1),
+              started(snowflake::from_time(std::chrono::system_clock::now()))
+        {
+        }
+
+        void message_cache::apply(const boost::json::value &payload)
+        {
+            const json::object *p = payload.if_object();
+            const json::value *t = p ? p->if_contains("t") : nullptr;
+            const json::value *dv = p ? p->if_contains("d") : nullptr;
+            const json::object *d = dv ? dv->if_object() : nullptr;
+            if (!t || !t->is_string() || !d)
+            {
+                return;
+            }
+
+            const snowflake channel_id = id_at(*d, "channel_id");
+            switch (gateway::to_event(t->get_string()))
+            {
+                case event::message_create:
+                {
+                    auto m = std::make_shared<const types::message>(*d);
+                    std::lock_guard<std::mutex> g(mutex);
+                    add(ring_for(channel_id), std::move(m));
+                    enforce_budget();
+                    break;
+                }
+
+                case event::message_update:
+                {
+                    std::lock_guard<std::mutex> g(mutex);
+                    channel_ring *r = touch(channel_id);
+                    const snowflake id = id_at(*d, "id");
+                    auto it = r ? std::lower_bound(r->messages.begin(), r->messages.end(), id, id_less)
+                                : std::deque<pointer>::iterator();
+                    if (!r || it == r->messages.end() || (*it)->id() != id)
+                    {
+                        // We can't merge an edit into a message we don't have
+                        return;
+                    }
+
+                    // Updates only carry the fields that changed
+                    json::object merged = (*it)->json();
+                    for (const auto &kv : *d)
+                    {
+                        merged[kv.key()] = kv.value();
+                    }
+                    pointer updated = std::make_shared<const types::message>(merged);
+                    const std::size_t old_cost = cost(*it);
+                    const std::size_t new_cost = cost(updated);
+                    r->bytes = r->bytes - old_cost + new_cost;
+                    total_bytes = total_bytes - old_cost + new_cost;
+                    *it = std::move(updated);
+                    enforce_budget();
+                    break;
+                }
+
+                case event::message_delete:
+                {
+                    std::lock_guard<std::mutex> g(mutex);
+                    if (channel_ring *r = touch(channel_id))
+                    {
+                        remove(*r, id_at(*d, "id"));
+                    }
+                    break;
+                }
+
+                case event::message_delete_bulk:
+                {
+                    const json::value *ids = d->if_contains("ids");
+                    const json::array *arr = ids ? ids->if_array() : nullptr;
+                    std::lock_guard<std::mutex> g(mutex);
+                    channel_ring *r = touch(channel_id);
+                    if (!r || !arr)
+                    {
+                        return;
+                    }
+                    for (const json::value &id : *arr)
+                    {
+                        remove(*r, snowflake::from_json(id));
+                    }
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        }
+
+        void message_cache::attach(gateway::dispatcher &d)
+        {
+            for (event e : {event::message_create, event::message_update,
+                            event::message_delete, event::message_delete_bulk})
+            {
+                d.on(e, [this](const boost::json::value &payload) { apply(payload); },
+                     gateway::execution::sync);
+            }
+        }
+
+        void message_cache::insert(pointer m)
+        {
+            const snowflake channel_id = m->channel_id();
+            std::lock_guard<std::mutex> g(mutex);
+            add(ring_for(channel_id), std::move(m));
+            enforce_budget();
+        }
+
+        message_cache::pointer message_cache::find(snowflake channel_id, snowflake message_id)
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            channel_ring *r = touch(channel_id);
+            if (!r)
+            {
+                return pointer();
+            }
+            auto it = std::lower_bound(r->messages.begin(), r->messages.end(), message_id, id_less);
+            return (it != r->messages.end() && (*it)->id() == message_id) ? *it : pointer();
+        }
+
+        boost::optional<std::vector<message_cache::pointer>>
+        message_cache::latest(snowflake channel_id, std::size_t limit)
+        {
+            return before(channel_id, snowflake(~std::uint64_t(0)), limit);
+        }
+
+        boost::optional<std::vector<message_cache::pointer>>
+        message_cache::before(snowflake channel_id, snowflake id, std::size_t limit)
+        {
+            limit = std::min(limit, max_limit);
+            std::lock_guard<std::mutex> g(mutex);
+            channel_ring empty;
+            const channel_ring &r = ring_or_empty(channel_id, empty);
+            const auto pos = std::lower_bound(r.messages.cbegin(), r.messages.cend(), id, id_less);
+            return take_before(r, channel_id, pos, limit);
+        }
+
+        boost::optional<std::vector<message_cache::pointer>>
+        message_cache::after(snowflake channel_id, snowflake id, std::size_t limit)
+        {
+            limit = std::min(limit, max_limit);
+            std::lock_guard<std::mutex> g(mutex);
+            channel_ring empty;
+            const channel_ring &r = ring_or_empty(channel_id, empty);
+
+            // Everything newer than `id` must be covered
+            if (snowflake(id.value() + 1) < r.complete_from && !has_full_history(r, channel_id))
+            {
+                return boost::none;
+            }
+            const auto first = std::upper_bound(r.messages.cbegin(), r.messages.cend(), id, less_id);
+            const auto n = std::min<std::size_t>(limit, std::distance(first, r.messages.cend()));
+            return newest_first(first, first + n);
+        }
+
+        boost::optional<std::vector<message_cache::pointer>>
+        message_cache::around(snowflake channel_id, snowflake id, std::size_t limit)
+        {
+            limit = std::min(limit, max_limit);
+            const std::size_t older = limit / 2;
+            const std::size_t newer = limit - older;
+
+            std::lock_guard<std::mutex> g(mutex);
+            channel_ring empty;
+            const channel_ring &r = ring_or_empty(channel_id, empty);
+
+            if (id < r.complete_from && !has_full_history(r, channel_id))
+            {
+                return boost::none;
+            }
+            const auto pos = std::lower_bound(r.messages.cbegin(), r.messages.cend(), id, id_less);
+            boost::optional<std::vector<pointer>> before_part = take_before(r, channel_id, pos, older);
+            if (!before_part)
+            {
+                return boost::none;
+            }
+            const auto n = std::min<std::size_t>(newer, std::distance(pos, r.messages.cend()));
+            std::vector<pointer> out = newest_first(pos, pos + n);
+            out.insert(out.end(), before_part->begin(), before_part->end());
+            return out;
+        }
+
+        void message_cache::reset_coverage()
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            started = snowflake::from_time(std::chrono::system_clock::now());
+            channels.for_each([this](snowflake, std::unique_ptr<channel_ring> &r)
+            {
+                r->complete_from = std::max(r->complete_from, started);
+            });
+            dropped.clear();
+        }
+
+        message_cache_stats message_cache::stats() const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            return message_cache_stats{total_bytes, total_messages, channels.size(), evictions};
+        }
+
+        message_cache::channel_ring &message_cache::ring_for(snowflake channel_id)
+        {
+            if (channel_ring *r = touch(channel_id))
+            {
+                return *r;
+            }
+
+            std::unique_ptr<channel_ring> r(new channel_ring());
+            const snowflake *from = dropped.find(channel_id);
+            r->complete_from = from ? *from : started;
+            dropped.erase(channel_id);
+            lru.push_front(channel_id);
+            r->lru = lru.begin();
+
+            channel_ring &ref = *r;
+            channels.insert(channel_id, std::move(r));
+            return ref;
+        }
+
+        const message_cache::channel_ring &message_cache::ring_or_empty(snowflake channel_id,
+                                                                         channel_ring &empty)
+        {
+            if (const channel_ring *r = touch(channel_id))
+            {
+                return *r;
+            }
+            // No ring means no messages since the channel's coverage started
+            const snowflake *from = dropped.find(channel_id);
+            empty.complete_from = from ? *from : started;
+            return empty;
+        }
+
+        message_cache::channel_ring *message_cache::touch(snowflake channel_id)
+        {
+            std::unique_ptr<channel_ring> *r = channels.find(channel_id);
+            if (!r)
+            {
+                return nullptr;
+            }
+            lru.splice(lru.begin(), lru, (*r)->lru);
+            return r->get();
+        }
+
+        void message_cache::add(channel_ring &r, pointer m)
+        {
+            const std::size_t c = cost(m);
+            if (r.messages.empty() || r.messages.back()->id() < m->id())
+            {
+                // The usual case: a new message
+                r.messages.push_back(std::move(m));
+            }
+            else
+            {
+                auto it = std::lower_bound(r.messages.begin(), r.messages.end(), m->id(), id_less);
+                if (it != r.messages.end() && (*it)->id() == m->id())
+                {
+                    const std::size_t old_cost = cost(*it);
+                    r.bytes -= old_cost;
+                    total_bytes -= old_cost;
+                    --total_messages;
+                    *it = std::move(m);
+                }
+                else
+                {
+                    r.messages.insert(it, std::move(m));
+                }
+            }
+            r.bytes += c;
+            total_bytes += c;
+            ++total_messages;
+
+            while (r.messages.size() > per_channel)
+            {
+                evict_oldest(r);
+            }
+        }
+
+        void message_cache::remove(channel_ring &r, snowflake message_id)
+        {
+            auto it = std::lower_bound(r.messages.begin(), r.messages.end(), message_id, id_less);
+            if (it == r.messages.end() || (*it)->id() != message_id)
+            {
+                return;
+            }
+            // Deleted messages are gone from the API too, so the complete
+            // range is unaffected
+            const std::size_t c = cost(*it);
+            r.bytes -= c;
+            total_bytes -= c;
+            --total_messages;
+            r.messages.erase(it);
+        }
+
+        void message_cache::evict_oldest(channel_ring &r)
+        {
+            const pointer &m = r.messages.front();
+            r.complete_from = std::max(r.complete_from, snowflake(m->id().value() + 1));
+            const std::size_t c = cost(m);
+            r.bytes -= c;
+            total_bytes -= c;
+            --total_messages;
+            ++evictions;
+            r.messages.pop_front();
+        }
+
+        void message_cache::enforce_budget()
+        {
+            while (total_bytes > budget && !lru.empty())
+            {
+                const snowflake channel_id = lru.back();
+                channel_ring &r = **channels.find(channel_id);
+                if (!r.messages.empty())
+                {
+                    evict_oldest(r);
+                }
+                if (r.messages.empty())
+                {
+                    drop_channel(channel_id);
+                }
+            }
+        }
+
+        void message_cache::drop_channel(snowflake channel_id)
+        {
+            std::unique_ptr<channel_ring> *r = channels.find(channel_id);
+            dropped.insert_or_assign(channel_id, (*r)->complete_from);
+            lru.erase((*r)->lru);
+            channels.erase(channel_id);
+        }
+
+        bool message_cache::has_full_history(const channel_ring &r, snowflake channel_id)
+        {
+            // No message is older than its channel
+            return r.complete_from <= channel_id;
+        }
+
+        std::vector<message_cache::pointer> message_cache::newest_first(ring_iterator first,
+                                                                        ring_iterator last)
+        {
+            return std::vector<pointer>(std::make_reverse_iterator(last),
+                                        std::make_reverse_iterator(first));
+        }
+
+        boost::optional<std::vector<message_cache::pointer>> message_cache::take_before(
+            const channel_ring &r, snowflake channel_id, ring_iterator pos, std::size_t limit)
+        {
+            const auto lo = std::lower_bound(r.messages.cbegin(), r.messages.cend(),
+                                             r.complete_from, id_less);
+            const std::size_t available = (pos > lo) ? static_cast<std::size_t>(pos - lo) : 0;
+            if (available >= limit)
+            {
+                return newest_first(pos - limit, pos);
+            }
+            if (!has_full_history(r, channel_id))
+            {
+                return boost::none;
+            }
+            // The whole channel is here, so fewer messages means there are no
+            // more
+            const std::size_t n = std::min<std::size_t>(limit, pos - r.messages.cbegin());
+            return newest_first(pos - n, pos);
+        }
+
+        std::size_t message_cache::cost(const pointer &m)
+        {
+            // The object, its heap data, and roughly a shared_ptr control
+            // block plus a ring slot
+            return sizeof(types::message) + m->footprint() + 4 * sizeof(void*);
+        }
+    } // namespace cache
+} // namespace discpp
@@ -0,0 +1,321 @@
+/*! \file permissions.cpp
+ *  \brief Effective permissions of members, computed from the entity cache
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "cache/permissions.hpp"
+
+namespace discpp
+{
+    namespace cache
+    {
+        namespace
+        {
+            bool is_thread(const types::channel &c)
+            {
+                // ANNOUNCEMENT_THREAD, PUBLIC_THREAD, PRIVATE_THREAD
+                return c.type() >= 10 && c.type() <= 12;
+            }
+
+            std::uint64_t base_of(const entity_cache &entities, const types::guild &g,
+                                  const types::guild_member &m)
+            {
+                if (g.owner_id() == m.user_id())
+                {
+                    return permission::all;
+                }
+                // @everyone shares its id with the guild
+                std::uint64_t p = 0;
+                if (auto everyone = entities.role(g.id()))
+                {
+                    p = everyone->permissions();
+                }
+                for (snowflake id : m.roles())
+                {
+                    if (auto r = entities.role(id))
+                    {
+                        p |= r->permissions();
+                    }
+                }
+                return (p & permission::administrator) ? permission::all : p;
+            }
+
+            std::uint64_t apply_overwrites(std::uint64_t p, const types::channel &c,
+                                           const types::guild_member &m)
+            {
+                std::uint64_t role_allow = 0, role_deny = 0;
+                std::uint64_t member_allow = 0, member_deny = 0;
+                for (const types::overwrite &o : c.overwrites())
+                {
+                    if (o.type == types::overwrite::target::member)
+                    {
+                        if (o.id == m.user_id())
+                        {
+                            member_allow = o.allow;
+                            member_deny = o.deny;
+                        }
+                    }
+                    else if (o.id == c.guild_id())
+                    {
+                        p = (p & ~o.deny) | o.allow;
+                    }
+                    else if (std::find(m.roles().begin(), m.roles().end(), o.id) != m.roles().end())
+                    {
+                        role_allow |= o.allow;
+                        role_deny |= o.deny;
+                    }
+                }
+                p = (p & ~role_deny) | role_allow;
+                p = (p & ~member_deny) | member_allow;
+                return (p & permission::view_channel) ? p : 0;
+            }
+        }
+
+        permission_engine::permission_engine(const entity_cache &entities)
+            : entities(entities)
+        {
+        }
+
+        permission_engine::memo_map &permission_engine::memo_for(snowflake guild_id,
+                                                                 std::uint64_t generation)
+        {
+            guild_memo &m = memo[guild_id];
+            if (m.generation != generation)
+            {
+                m.entries.clear();
+                m.generation = generation;
+            }
+            return m.entries;
+        }
+
+        boost::optional<std::uint64_t> permission_engine::recall(snowflake guild_id,
+                                                                 std::uint64_t generation,
+                                                                 const memo_key &key)
+        {
+            if (const std::uint64_t *p = memo_for(guild_id, generation).find(key))
+            {
+                return *p;
+            }
+            return boost::none;
+        }
+
+        void permission_engine::remember(snowflake guild_id, std::uint64_t generation,
+                                         const memo_key &key, std::uint64_t p)
+        {
+            // Don't memoize what may have been computed from older state
+            const std::uint64_t current = entities.generation(guild_id);
+            std::lock_guard<std::mutex> g(mutex);
+            if (current == generation)
+            {
+                memo_for(guild_id, generation).insert_or_assign(key, p);
+            }
+        }
+
+        entity_cache::pointer<types::channel> permission_engine::overwrite_source(snowflake channel_id) const
+        {
+            auto c = entities.channel(channel_id);
+            if (c && is_thread(*c) && c->parent_id())
+            {
+                return entities.channel(c->parent_id());
+            }
+            return c;
+        }
+
+        boost::optional<std::uint64_t> permission_engine::base_permissions(snowflake guild_id,
+                                                                           snowflake user_id)
+        {
+            const memo_key key{memo_key::kind::guild, guild_id, user_id};
+            const std::uint64_t generation = entities.generation(guild_id);
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                if (const auto p = recall(guild_id, generation, key))
+                {
+                    return p;
+                }
+            }
+
+            auto guild = entities.guild(guild_id);
+            auto member = entities.member(guild_id, user_id);
+            if (!guild || !member)
+            {
+                return boost::none;
+            }
+            const std::uint64_t p = base_of(entities, *guild, *member);
+            remember(guild_id, generation, key, p);
+            return p;
+        }
+
+        boost::optional<std::uint64_t> permission_engine::permissions(snowflake channel_id,
+                                                                      snowflake user_id)
+        {
+            const memo_key key{memo_key::kind::channel, channel_id, user_id};
+            snowflake guild_id;
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                if (const snowflake *known = channel_guilds.find(channel_id))
+                {
+                    guild_id = *known;
+                }
+            }
+            if (!guild_id)
+            {
+                const auto c = entities.channel(channel_id);
+                if (!c || !c->guild_id())
+                {
+                    return boost::none;
+                }
+                guild_id = c->guild_id();
+                std::lock_guard<std::mutex> g(mutex);
+                channel_guilds.insert(channel_id, guild_id);
+            }
+
+            // Read before the state the result is computed from
+            const std::uint64_t generation = entities.generation(guild_id);
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                if (const auto p = recall(guild_id, generation, key))
+                {
+                    return p;
+                }
+            }
+
+            auto source = overwrite_source(channel_id);
+            auto guild = entities.guild(guild_id);
+            auto member = entities.member(guild_id, user_id);
+            if (!source || !guild || !member)
+            {
+                return boost::none;
+            }
+            std::uint64_t p = base_of(entities, *guild, *member);
+            if (p != permission::all)
+            {
+                p = apply_overwrites(p, *source, *member);
+            }
+            remember(guild_id, generation, key, p);
+            return p;
+        }
+
+        bool permission_engine::has(snowflake channel_id, snowflake user_id, std::uint64_t required)
+        {
+            const boost::optional<std::uint64_t> p = permissions(channel_id, user_id);
+            return p && (*p & required) == required;
+        }
+
+        channel_permissions permission_engine::bulk(snowflake channel_id) const
+        {
+            channel_permissions out;
+            auto source = overwrite_source(channel_id);
+            if (!source || !source->guild_id())
+            {
+                return out;
+            }
+            const snowflake guild_id = source->guild_id();
+            auto guild = entities.guild(guild_id);
+            if (!guild)
+            {
+                return out;
+            }
+
+            // Everything a member's permissions depend on, flattened once per
+            // channel rather than looked up once per member
+            struct role_bits
+            {
+                std::uint64_t permissions = 0;
+                std::uint64_t allow = 0;
+                std::uint64_t deny = 0;
+            };
+            snowflake_map<role_bits> roles;
+            for (const auto &r : entities.guild_roles(guild_id))
+            {
+                roles[r->id()].permissions = r->permissions();
+            }
+            std::uint64_t everyone_allow = 0, everyone_deny = 0;
+            snowflake_map<std::pair<std::uint64_t, std::uint64_t>> member_overwrites;
+            for (const types::overwrite &o : source->overwrites())
+            {
+                if (o.type == types::overwrite::target::member)
+                {
+                    member_overwrites.insert_or_assign(o.id, std::make_pair(o.allow, o.deny));
+                }
+                else if (o.id == guild_id)
+                {
+                    everyone_allow = o.allow;
+                    everyone_deny = o.deny;
+                }
+                else if (role_bits *b = roles.find(o.id))
+                {
+                    b->allow = o.allow;
+                    b->deny = o.deny;
+                }
+            }
+            const role_bits *everyone = roles.find(guild_id);
+            const std::uint64_t everyone_permissions = everyone ? everyone->permissions : 0;
+
+            const auto members = entities.guild_members(guild_id);
+            const std::size_t n = members.size();
+            std::vector<std::uint64_t> base(n), role_allow(n), role_deny(n);
+            std::vector<std::uint64_t> member_allow(n), member_deny(n), owner(n);
+            out.users.resize(n);
+            out.permissions.resize(n);
+
+            // Gather: one walk over each member's roles
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                const types::guild_member &m = *members[i];
+                out.users[i] = m.user_id();
+                std::uint64_t p = everyone_permissions, allow = 0, deny = 0;
+                for (snowflake id : m.roles())
+                {
+                    if (const role_bits *b = roles.find(id))
+                    {
+                        p |= b->permissions;
+                        allow |= b->allow;
+                        deny |= b->deny;
+                    }
+                }
+                base[i] = p;
+                role_allow[i] = allow;
+                role_deny[i] = deny;
+                if (const auto *o = member_overwrites.find(m.user_id()))
+                {
+                    member_allow[i] = o->first;
+                    member_deny[i] = o->second;
+                }
+                owner[i] = m.user_id() == guild->owner_id() ? permission::all : 0;
+            }
+
+            // Resolve: branch-free over the flat arrays, so the compiler can
+            // vectorize it
+            static_assert(permission::administrator == 1ULL << 3, "administrator bit");
+            static_assert(permission::view_channel == 1ULL << 10, "view_channel bit");
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                const std::uint64_t b = base[i];
+                const std::uint64_t full = owner[i] | (0 - ((b >> 3) & 1));
+                std::uint64_t p = (b & ~everyone_deny) | everyone_allow;
+                p = (p & ~role_deny[i]) | role_allow[i];
+                p = (p & ~member_deny[i]) | member_allow[i];
+                const std::uint64_t visible = 0 - ((p >> 10) & 1);
+                out.permissions[i] = (p & visible) | full;
+            }
+            return out;
+        }
+    } // namespace cache
+} // namespace discpp
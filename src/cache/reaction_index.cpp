@@ -0,0 +1,308 @@
+/*! \file reaction_index.cpp
+ *  \brief Who reacted with what, kept current from gateway events
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iterator>
+
+#include "cache/reaction_index.hpp"
+
+namespace discpp
+{
+    namespace cache
+    {
+        namespace
+        {
+            namespace json = boost::json;
+            using gateway::event;
+
+            const event indexed_events[] =
+            {
+                event::ready, event::message_create, event::message_delete, event::message_delete_bulk,
+                event::message_reaction_add, event::message_reaction_remove,
+                event::message_reaction_remove_all, event::message_reaction_remove_emoji
+            };
+
+            snowflake id_at(const json::object &obj, json::string_view key)
+            {
+                const json::value *v = obj.if_contains(key);
+                return v ? snowflake::from_json(*v) : snowflake();
+            }
+
+            template <typename Reactions>
+            auto find_emoji(Reactions &reactions, json::string_view emoji)
+                -> decltype(reactions.begin())
+            {
+                return std::find_if(reactions.begin(), reactions.end(),
+                    [emoji](const std::pair<std::string, std::vector<snowflake>> &r)
+                    {
+                        return json::string_view(r.first) == emoji;
+                    });
+            }
+        }
+
+        reaction_index::reaction_index(std::size_t max_messages)
+            : max_messages(std::max<std::size_t>(max_messages, 1))
+        {
+        }
+
+        std::string reaction_index::emoji_key(const json::object &emoji)
+        {
+            const json::value *id = emoji.if_contains("id");
+            if (id && !id->is_null())
+            {
+                return snowflake::from_json(*id).to_string();
+            }
+            const json::value *name = emoji.if_contains("name");
+            if (name && name->is_string())
+            {
+                const json::string_view s = name->get_string();
+                return std::string(s.data(), s.size());
+            }
+            return std::string();
+        }
+
+        void reaction_index::attach(gateway::dispatcher &d)
+        {
+            for (event e : indexed_events)
+            {
+                d.on(e, [this](const json::value &payload)
+                {
+                    apply(payload);
+                }, gateway::execution::sync);
+            }
+        }
+
+        void reaction_index::apply(const json::value &payload)
+        {
+            const json::object *obj = payload.if_object();
+            const json::value *t = obj ? obj->if_contains("t") : nullptr;
+            const json::value *dv = obj ? obj->if_contains("d") : nullptr;
+            const json::object *d = dv ? dv->if_object() : nullptr;
+            if (!t || !t->is_string() || !d)
+            {
+                return;
+            }
+
+            auto emoji_of = [d]()
+            {
+                const json::value *e = d->if_contains("emoji");
+                const json::object *eo = e ? e->if_object() : nullptr;
+                return eo ? emoji_key(*eo) : std::string();
+            };
+
+            std::lock_guard<std::mutex> g(mutex);
+            switch (gateway::to_event(t->get_string()))
+            {
+                case event::ready:
+                    // Reactions made while we were away were never seen, so
+                    // no tracked message is complete anymore
+                    messages.clear();
+                    order.clear();
+                    break;
+                case event::message_create:
+                    track(id_at(*d, "id"));
+                    break;
+                case event::message_delete:
+                    forget(id_at(*d, "id"));
+                    break;
+                case event::message_delete_bulk:
+                    if (const json::value *ids = d->if_contains("ids"))
+                    {
+                        if (const json::array *arr = ids->if_array())
+                        {
+                            for (const json::value &id : *arr)
+                            {
+                                forget(snowflake::from_json(id));
+                            }
+                        }
+                    }
+                    break;
+                case event::message_reaction_add:
+                    add(id_at(*d, "message_id"), emoji_of(), id_at(*d, "user_id"));
+                    break;
+                case event::message_reaction_remove:
+                    remove(id_at(*d, "message_id"), emoji_of(), id_at(*d, "user_id"));
+                    break;
+                case event::message_reaction_remove_emoji:
+                    remove_emoji(id_at(*d, "message_id"), emoji_of());
+                    break;
+                case event::message_reaction_remove_all:
+                    clear(id_at(*d, "message_id"));
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        void reaction_index::track(snowflake message_id)
+        {
+            if (!message_id || !messages.insert(message_id, tracked_message()).second)
+            {
+                return;
+            }
+            order.push_back(message_id);
+
+            while (messages.size() > max_messages && !order.empty())
+            {
+                messages.erase(order.front());
+                order.pop_front();
+            }
+            // Deleted messages leave their ids behind; don't let them pile up
+            if (order.size() > 2 * max_messages)
+            {
+                order.erase(std::remove_if(order.begin(), order.end(),
+                    [this](snowflake id)
+                    {
+                        return !messages.contains(id);
+                    }), order.end());
+            }
+        }
+
+        void reaction_index::forget(snowflake message_id)
+        {
+            messages.erase(message_id);
+        }
+
+        void reaction_index::add(snowflake message_id, std::string emoji, snowflake user_id)
+        {
+            tracked_message *m = messages.find(message_id);
+            if (!m || emoji.empty() || !user_id)
+            {
+                return;
+            }
+            auto r = find_emoji(m->reactions, emoji);
+            if (r == m->reactions.end())
+            {
+                m->reactions.emplace_back(std::move(emoji), std::vector<snowflake>());
+                r = std::prev(m->reactions.end());
+            }
+            std::vector<snowflake> &users = r->second;
+            auto pos = std::lower_bound(users.begin(), users.end(), user_id);
+            if (pos == users.end() || *pos != user_id)
+            {
+                users.insert(pos, user_id);
+            }
+        }
+
+        void reaction_index::remove(snowflake message_id, const std::string &emoji, snowflake user_id)
+        {
+            tracked_message *m = messages.find(message_id);
+            if (!m)
+            {
+                return;
+            }
+            auto r = find_emoji(m->reactions, emoji);
+            if (r == m->reactions.end())
+            {
+                return;
+            }
+            std::vector<snowflake> &users = r->second;
+            auto pos = std::lower_bound(users.begin(), users.end(), user_id);
+            if (pos != users.end() && *pos == user_id)
+            {
+                users.erase(pos);
+            }
+            if (users.empty())
+            {
+                m->reactions.erase(r);
+            }
+        }
+
+        void reaction_index::remove_emoji(snowflake message_id, const std::string &emoji)
+        {
+            if (tracked_message *m = messages.find(message_id))
+            {
+                auto r = find_emoji(m->reactions, emoji);
+                if (r != m->reactions.end())
+                {
+                    m->reactions.erase(r);
+                }
+            }
+        }
+
+        void reaction_index::clear(snowflake message_id)
+        {
+            if (tracked_message *m = messages.find(message_id))
+            {
+                m->reactions.clear();
+            }
+        }
+
+        bool reaction_index::tracks(snowflake message_id) const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            return messages.contains(message_id);
+        }
+
+        boost::optional<std::vector<snowflake>> reaction_index::users(snowflake message_id,
+                                                                      json::string_view emoji,
+                                                                      snowflake after,
+                                                                      std::size_t limit) const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            const tracked_message *m = messages.find(message_id);
+            if (!m)
+            {
+                return boost::none;
+            }
+            std::vector<snowflake> out;
+            auto r = find_emoji(m->reactions, emoji);
+            if (r != m->reactions.end())
+            {
+                const std::vector<snowflake> &users = r->second;
+                auto first = std::upper_bound(users.begin(), users.end(), after);
+                const std::size_t n = std::min<std::size_t>(limit, users.end() - first);
+                out.assign(first, first + n);
+            }
+            return out;
+        }
+
+        boost::optional<std::size_t> reaction_index::count(snowflake message_id,
+                                                           json::string_view emoji) const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            const tracked_message *m = messages.find(message_id);
+            if (!m)
+            {
+                return boost::none;
+            }
+            auto r = find_emoji(m->reactions, emoji);
+            return r == m->reactions.end() ? 0 : r->second.size();
+        }
+
+        boost::optional<std::vector<std::pair<std::string, std::size_t>>>
+        reaction_index::counts(snowflake message_id) const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            const tracked_message *m = messages.find(message_id);
+            if (!m)
+            {
+                return boost::none;
+            }
+            std::vector<std::pair<std::string, std::size_t>> out;
+            out.reserve(m->reactions.size());
+            for (const auto &r : m->reactions)
+            {
+                out.emplace_back(r.first, r.second.size());
+            }
+            return out;
+        }
+    } // namespace cache
+} // namespace discpp
@@ -0,0 +1,326 @@
+/*! \file command_router.cpp
+ *  \brief Routes MESSAGE_CREATEs to commands through a compiled trie
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#include "core/command_router.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        namespace json = boost::json;
+
+        namespace
+        {
+            bool is_space(char c)
+            {
+                return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+            }
+
+            std::size_t skip_space(json::string_view s, std::size_t pos)
+            {
+                while (pos < s.size() && is_space(s[pos]))
+                {
+                    ++pos;
+                }
+                return pos;
+            }
+
+            const json::value *field(const json::object &obj, json::string_view key)
+            {
+                return obj.if_contains(key);
+            }
+        }
+
+        boost::optional<json::string_view> arguments::next()
+        {
+            pos = skip_space(text, pos);
+            if (pos == text.size())
+            {
+                return boost::none;
+            }
+
+            if (text[pos] == '"')
+            {
+                const std::size_t close = text.find('"', pos + 1);
+                if (close != json::string_view::npos)
+                {
+                    const json::string_view arg = text.substr(pos + 1, close - pos - 1);
+                    pos = close + 1;
+                    return arg;
+                }
+                // An unmatched quote is just part of the argument
+            }
+
+            const std::size_t start = pos;
+            while (pos < text.size() && !is_space(text[pos]))
+            {
+                ++pos;
+            }
+            return text.substr(start, pos - start);
+        }
+
+        json::string_view arguments::rest() const
+        {
+            return text.substr(skip_space(text, pos));
+        }
+
+        command_router::command_router(std::string default_prefix, bool case_sensitive)
+            : default_prefix(std::move(default_prefix)), case_sensitive(case_sensitive)
+        {
+        }
+
+        char command_router::fold(char c) const
+        {
+            return (!case_sensitive && c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        void command_router::add(json::string_view name, command_handler handler,
+                                 const std::vector<std::string> &aliases)
+        {
+            if (compiled)
+            {
+                throw std::logic_error("command_router: commands must be added before compiling");
+            }
+
+            const std::size_t index = commands.size();
+            std::vector<std::string> new_names;
+            new_names.emplace_back(name.data(), name.size());
+            new_names.insert(new_names.end(), aliases.begin(), aliases.end());
+            for (std::string &n : new_names)
+            {
+                if (n.empty() || is_space(n.front()) || is_space(n.back()))
+                {
+                    throw std::invalid_argument("command_router: malformed command name \"" + n + "\"");
+                }
+                std::transform(n.begin(), n.end(), n.begin(), [this](char c) { return fold(c); });
+                for (const auto &existing : names)
+                {
+                    if (existing.first == n)
+                    {
+                        throw std::invalid_argument("command_router: \"" + n + "\" is already taken");
+                    }
+                }
+            }
+
+            for (std::string &n : new_names)
+            {
+                names.emplace_back(std::move(n), index);
+            }
+            commands.push_back(command{std::string(name.data(), name.size()), std::move(handler)});
+        }
+
+        void command_router::set_prefix(snowflake guild_id, std::string prefix)
+        {
+            std::lock_guard<std::mutex> g(prefix_mutex);
+            prefixes.insert_or_assign(guild_id, std::move(prefix));
+        }
+
+        void command_router::reset_prefix(snowflake guild_id)
+        {
+            std::lock_guard<std::mutex> g(prefix_mutex);
+            prefixes.erase(guild_id);
+        }
+
+        void command_router::compile()
+        {
+            if (compiled)
+            {
+                return;
+            }
+
+            // Build a plain trie first, then lay it out flat; node ids carry
+            // over, and std::map keeps each node's edges sorted
+            std::vector<std::map<char, std::uint32_t>> children(1);
+            std::vector<std::int32_t> terminal(1, -1);
+            for (const auto &n : names)
+            {
+                std::uint32_t at = 0;
+                for (char c : n.first)
+                {
+                    auto it = children[at].find(c);
+                    if (it == children[at].end())
+                    {
+                        const auto next = static_cast<std::uint32_t>(children.size());
+                        children[at].emplace(c, next);
+                        children.emplace_back();
+                        terminal.push_back(-1);
+                        at = next;
+                    }
+                    else
+                    {
+                        at = it->second;
+                    }
+                }
+                terminal[at] = static_cast<std::int32_t>(n.second);
+            }
+
+            nodes.resize(children.size());
+            for (std::size_t i = 0; i < children.size(); ++i)
+            {
+                nodes[i].first_edge = static_cast<std::uint32_t>(edge_labels.size());
+                nodes[i].edges = static_cast<std::uint32_t>(children[i].size());
+                nodes[i].command = terminal[i];
+                for (const auto &edge : children[i])
+                {
+                    edge_labels.push_back(edge.first);
+                    edge_targets.push_back(edge.second);
+                }
+            }
+
+            names.clear();
+            names.shrink_to_fit();
+            compiled = true;
+        }
+
+        void command_router::attach(dispatcher &d, execution mode)
+        {
+            compile();
+            d.on(event::message_create, [this](const json::value &payload)
+            {
+                route(payload);
+            }, mode);
+        }
+
+        boost::optional<std::pair<std::size_t, std::size_t>> command_router::match(
+            json::string_view content) const
+        {
+            if (!compiled)
+            {
+                throw std::logic_error("command_router: match() before compile()");
+            }
+
+            boost::optional<std::pair<std::size_t, std::size_t>> best;
+            std::uint32_t at = 0;
+            std::size_t pos = 0;
+            while (true)
+            {
+                const node &n = nodes[at];
+                if (n.command >= 0 && (pos == content.size() || is_space(content[pos])))
+                {
+                    best = std::make_pair(static_cast<std::size_t>(n.command), pos);
+                }
+                if (pos == content.size())
+                {
+                    break;
+                }
+
+                const char c = fold(content[pos]);
+                const char *first = edge_labels.data() + n.first_edge;
+                const char *last = first + n.edges;
+                const char *edge = std::lower_bound(first, last, c);
+                if (edge == last || *edge != c)
+                {
+                    break;
+                }
+                at = edge_targets[static_cast<std::size_t>(edge - edge_labels.data())];
+                ++pos;
+            }
+
+            if (best)
+            {
+                best->second = skip_space(content, best->second);
+            }
+            return best;
+        }
+
+        boost::optional<std::size_t> command_router::prefix_length(snowflake guild_id,
+                                                                    json::string_view content) const
+        {
+            std::lock_guard<std::mutex> g(prefix_mutex);
+            const std::string *prefix = guild_id ? prefixes.find(guild_id) : nullptr;
+            if (!prefix)
+            {
+                prefix = &default_prefix;
+            }
+            if (content.size() < prefix->size() ||
+                    content.substr(0, prefix->size()) != json::string_view(*prefix))
+            {
+                return boost::none;
+            }
+            return prefix->size();
+        }
+
+        bool command_router::route(const json::value &payload) const
+        {
+            if (!compiled)
+            {
+                throw std::logic_error("command_router: route() before compile()");
+            }
+
+            const json::object *obj = payload.if_object();
+            const json::value *d = obj ? field(*obj, "d") : nullptr;
+            const json::object *msg = d ? d->if_object() : nullptr;
+            const json::value *content = msg ? field(*msg, "content") : nullptr;
+            if (!content || !content->is_string())
+            {
+                return false;
+            }
+
+            const json::value *author = field(*msg, "author");
+            const json::object *author_obj = author ? author->if_object() : nullptr;
+            if (author_obj)
+            {
+                const json::value *bot = field(*author_obj, "bot");
+                if (bot && bot->is_bool() && bot->get_bool())
+                {
+                    return false;
+                }
+            }
+
+            const json::value *guild = field(*msg, "guild_id");
+            const snowflake guild_id = guild ? snowflake::from_json(*guild) : snowflake();
+
+            const json::string_view text = content->get_string();
+            const boost::optional<std::size_t> skip = prefix_length(guild_id, text);
+            if (!skip)
+            {
+                return false;
+            }
+            const json::string_view rest = text.substr(*skip);
+            const auto found = match(rest);
+            if (!found)
+            {
+                return false;
+            }
+
+            const command &cmd = commands[found->first];
+            if (!cmd.handler)
+            {
+                return false;
+            }
+
+            const json::value *channel = field(*msg, "channel_id");
+            const json::value *author_id = author_obj ? field(*author_obj, "id") : nullptr;
+            const command_context ctx{
+                payload, *msg, guild_id,
+                channel ? snowflake::from_json(*channel) : snowflake(),
+                author_id ? snowflake::from_json(*author_id) : snowflake(),
+                json::string_view(cmd.name),
+                rest.substr(found->second)
+            };
+            cmd.handler(ctx);
+            return true;
+        }
+    } // namespace gateway
+} // namespace discpp
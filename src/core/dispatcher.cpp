@@ -0,0 +1,206 @@
+/*! \file dispatcher.cpp
+ *  \brief Per-event handler registry for gateway dispatches
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdexcept>
+
+#include <boost/log/trivial.hpp>
+
+#include "core/dispatcher.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        dispatcher::dispatcher(std::size_t threads)
+            : pool(new boost::asio::thread_pool(threads ? threads : 1))
+        {
+        }
+
+        dispatcher::dispatcher(exec::keyed_executor &executor)
+            : executor(&executor)
+        {
+        }
+
+        dispatcher::~dispatcher()
+        {
+            if (pool)
+            {
+                pool->join();
+            }
+            std::unique_lock<std::mutex> g(in_flight_mutex);
+            drained.wait(g, [this]() { return in_flight == 0; });
+        }
+
+        void dispatcher::on(event e, event_handler handler, execution mode)
+        {
+            const auto i = static_cast<std::size_t>(e);
+            handlers[i].push_back(entry{mode, std::make_shared<const event_handler>(std::move(handler))});
+            has_async[i] = has_async[i] || mode == execution::async;
+        }
+
+        void dispatcher::on(boost::json::string_view name, event_handler handler,
+                            execution mode)
+        {
+            const event e = to_event(name);
+            if (e == event::unknown)
+            {
+                throw std::invalid_argument("Unknown gateway event: " + std::string(name));
+            }
+            on(e, std::move(handler), mode);
+        }
+
+        void dispatcher::dispatch(const message &msg)
+        {
+            const boost::json::object *payload = msg.first.if_object();
+            if (!payload)
+            {
+                return;
+            }
+            const boost::json::value *op = payload->if_contains("op");
+            const boost::json::value *t = payload->if_contains("t");
+            if (!op || !op->is_int64() || op->get_int64() != static_cast<int>(opcode::dispatch)
+                || !t || !t->is_string())
+            {
+                return;
+            }
+
+            const auto i = static_cast<std::size_t>(to_event(t->get_string()));
+            const std::vector<entry> &entries = handlers[i];
+            if (entries.empty())
+            {
+                return;
+            }
+
+            // Async handlers share one copy of the payload, which lives until
+            // the last of them finishes
+            std::shared_ptr<const boost::json::value> shared;
+            snowflake key;
+            if (has_async[i])
+            {
+                shared = std::make_shared<const boost::json::value>(msg.first);
+                if (executor)
+                {
+                    key = exec::ordering_key(msg.first);
+                }
+            }
+
+            for (const entry &e : entries)
+            {
+                if (e.mode == execution::sync)
+                {
+                    // Logged like async handlers, so one bad handler can't
+                    // end run() or keep later handlers from seeing the event
+                    try
+                    {
+                        (*e.handler)(msg.first);
+                    }
+                    catch (const std::exception &ex)
+                    {
+                        BOOST_LOG_TRIVIAL(error) << "Event handler threw: " << ex.what();
+                    }
+                    continue;
+                }
+                const std::shared_ptr<const event_handler> &handler = e.handler;
+                if (executor)
+                {
+                    post_to_executor(key, handler, shared);
+                    continue;
+                }
+                boost::asio::post(*pool, [handler, shared]()
+                {
+                    try
+                    {
+                        (*handler)(*shared);
+                    }
+                    catch (const std::exception &ex)
+                    {
+                        BOOST_LOG_TRIVIAL(error) << "Event handler threw: " << ex.what();
+                    }
+                });
+            }
+        }
+
+        void dispatcher::post_to_executor(snowflake key,
+                                          std::shared_ptr<const event_handler> handler,
+                                          std::shared_ptr<const boost::json::value> payload)
+        {
+            {
+                std::lock_guard<std::mutex> g(in_flight_mutex);
+                ++in_flight;
+            }
+            // Decrements on the way out even if the handler throws; the
+            // executor logs the exception
+            struct done
+            {
+                dispatcher *self;
+                ~done()
+                {
+                    // Notified under the lock, so the destructor can't wake
+                    // and free us before we are done with the mutex
+                    std::lock_guard<std::mutex> g(self->in_flight_mutex);
+                    if (--self->in_flight == 0)
+                    {
+                        self->drained.notify_all();
+                    }
+                }
+            };
+            executor->post(key, [this, handler, payload]()
+            {
+                done d{this};
+                (*handler)(*payload);
+            });
+        }
+
+        void dispatcher::run(connection &cxn)
+        {
+            running = &cxn;
+            keep_going = true;
+            while (keep_going)
+            {
+                cxn.read_queue.wait_until_nonempty();
+                dispatch(cxn.pop());
+            }
+            running = nullptr;
+        }
+
+        void dispatcher::stop()
+        {
+            keep_going = false;
+            // Wake run() up with a null payload, which dispatch() ignores
+            if (connection *cxn = running)
+            {
+                cxn->read_queue.push(message());
+            }
+        }
+
+        std::vector<event> dispatcher::registered_events() const
+        {
+            std::vector<event> events;
+            for (std::size_t i = 0; i < event_count; ++i)
+            {
+                if (!handlers[i].empty())
+                {
+                    events.push_back(static_cast<event>(i));
+                }
+            }
+            return events;
+        }
+    } // namespace gateway
+} // namespace discpp
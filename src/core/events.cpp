@@ -0,0 +1,127 @@
+/*! \file events.cpp
+ *  \brief Gateway dispatch event names
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <array>
+
+#include "core/events.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        namespace
+        {
+            const boost::json::string_view names[] =
+            {
+#define DISCPP_EVENT_NAME(id, name) name,
+                DISCPP_GATEWAY_EVENTS(DISCPP_EVENT_NAME)
+#undef DISCPP_EVENT_NAME
+                "UNKNOWN"
+            };
+
+            static_assert(sizeof(names) / sizeof(names[0]) == event_count,
+                          "event name table out of sync with enum");
+            static_assert(event_count < 0xFF, "event ids must fit in a table slot");
+
+            constexpr std::size_t table_size = 1024;
+            constexpr std::size_t table_mask = table_size - 1;
+            constexpr std::uint8_t empty_slot = 0xFF;
+
+            /*! Seeded FNV-1a, with a final multiply so the low bits we index
+             *  with depend on every input byte */
+            std::uint64_t hash(boost::json::string_view s, std::uint64_t seed)
+            {
+                std::uint64_t h = 0xCBF29CE484222325ULL ^ seed;
+                for (char c : s)
+                {
+                    h ^= static_cast<unsigned char>(c);
+                    h *= 0x100000001B3ULL;
+                }
+                h ^= h >> 29;
+                h *= 0xBF58476D1CE4E5B9ULL;
+                return h ^ (h >> 32);
+            }
+
+            class perfect_table
+            {
+                /*! \class perfect_table
+                 *  \brief Collision-free name -> event table
+                 *
+                 *  With ~60 names and 1024 slots, a random seed is
+                 *  collision-free about one time in ten, so the search below
+                 *  finishes after a handful of attempts.
+                 */
+                public:
+                    perfect_table()
+                    {
+                        for (std::uint64_t seed = 1; ; ++seed)
+                        {
+                            if (try_seed(seed))
+                            {
+                                _seed = seed;
+                                return;
+                            }
+                        }
+                    }
+
+                    event find(boost::json::string_view name) const
+                    {
+                        const std::uint8_t slot = _slots[hash(name, _seed) & table_mask];
+                        if (slot != empty_slot && names[slot] == name)
+                        {
+                            return static_cast<event>(slot);
+                        }
+                        return event::unknown;
+                    }
+
+                private:
+                    bool try_seed(std::uint64_t seed)
+                    {
+                        _slots.fill(empty_slot);
+                        for (std::size_t i = 0; i < event_count - 1; ++i)
+                        {
+                            std::uint8_t &slot = _slots[hash(names[i], seed) & table_mask];
+                            if (slot != empty_slot)
+                            {
+                                return false;
+                            }
+                            slot = static_cast<std::uint8_t>(i);
+                        }
+                        return true;
+                    }
+
+                    std::array<std::uint8_t, table_size> _slots;
+                    std::uint64_t _seed = 0;
+            };
+        } // anonymous namespace
+
+        boost::json::string_view event_name(event e)
+        {
+            const auto i = static_cast<std::size_t>(e);
+            return i < event_count ? names[i] : names[event_count - 1];
+        }
+
+        event to_event(boost::json::string_view name)
+        {
+            static const perfect_table table;
+            return table.find(name);
+        }
+    } // namespace gateway
+} // namespace discpp
@@ -0,0 +1,306 @@
+/*! \file executor.cpp
+ *  \brief Work-stealing thread pool and per-key serial executor
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <exception>
+
+#include <boost/log/trivial.hpp>
+
+#include "core/executor.hpp"
+
+namespace discpp
+{
+    namespace exec
+    {
+        namespace
+        {
+            /*! The pool and queue index of the current thread, if it is a
+             *  worker; lets submit() keep a worker's follow-up tasks local */
+            thread_local const work_stealing_pool *current_pool = nullptr;
+            thread_local std::size_t current_index = 0;
+
+            void run_task(task &t)
+            {
+                try
+                {
+                    t();
+                }
+                catch (const std::exception &ex)
+                {
+                    BOOST_LOG_TRIVIAL(error) << "Task threw: " << ex.what();
+                }
+            }
+        } // anonymous namespace
+
+        work_stealing_pool::work_stealing_pool(std::size_t threads)
+        {
+            threads = threads ? threads : 1;
+            for (std::size_t i = 0; i < threads; ++i)
+            {
+                queues.emplace_back(new worker_queue());
+            }
+            for (std::size_t i = 0; i < threads; ++i)
+            {
+                workers.emplace_back(&work_stealing_pool::work, this, i);
+            }
+        }
+
+        work_stealing_pool::~work_stealing_pool()
+        {
+            {
+                std::lock_guard<std::mutex> g(idle_mutex);
+                stopping = true;
+            }
+            idle.notify_all();
+            for (auto &w : workers)
+            {
+                w.join();
+            }
+        }
+
+        void work_stealing_pool::submit(task t)
+        {
+            const std::size_t i = (current_pool == this) ?
+                current_index : next_queue.fetch_add(1) % queues.size();
+            // Count the task before it becomes visible, so a worker taking it
+            // never sees the count go below zero. The count is bumped before
+            // taking idle_mutex: a worker checks it under that mutex, so it
+            // either sees the task or gets notified.
+            ++pending;
+            {
+                std::lock_guard<std::mutex> g(queues[i]->mutex);
+                queues[i]->tasks.push_back(std::move(t));
+            }
+            {
+                std::lock_guard<std::mutex> g(idle_mutex);
+            }
+            idle.notify_one();
+        }
+
+        bool work_stealing_pool::take(std::size_t index, task &out)
+        {
+            {
+                worker_queue &own = *queues[index];
+                std::lock_guard<std::mutex> g(own.mutex);
+                if (!own.tasks.empty())
+                {
+                    out = std::move(own.tasks.front());
+                    own.tasks.pop_front();
+                    return true;
+                }
+            }
+            for (std::size_t n = 1; n < queues.size(); ++n)
+            {
+                worker_queue &victim = *queues[(index + n) % queues.size()];
+                std::lock_guard<std::mutex> g(victim.mutex);
+                if (!victim.tasks.empty())
+                {
+                    out = std::move(victim.tasks.back());
+                    victim.tasks.pop_back();
+                    ++steal_count;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void work_stealing_pool::work(std::size_t index)
+        {
+            current_pool = this;
+            current_index = index;
+
+            task t;
+            for (;;)
+            {
+                if (take(index, t))
+                {
+                    --pending;
+                    run_task(t);
+                    t = nullptr;
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> g(idle_mutex);
+                idle.wait(g, [this]() { return stopping || pending > 0; });
+                if (stopping && pending == 0)
+                {
+                    return;
+                }
+            }
+        }
+
+        keyed_executor::keyed_executor(std::size_t threads)
+            : workers(threads)
+        {
+        }
+
+        void keyed_executor::post(snowflake key, task t)
+        {
+            lane *l;
+            bool schedule;
+            {
+                // Held until the task is queued, so retire() can't drop the
+                // lane in between
+                std::lock_guard<std::mutex> g(lanes_mutex);
+                std::unique_ptr<lane> &slot = lanes[key];
+                if (!slot)
+                {
+                    slot.reset(new lane(key));
+                    // Pick up where a dropped lane of this key left off
+                    const auto old = std::find_if(history.begin(), history.end(),
+                        [key](const key_stats &s) { return s.key == key; });
+                    if (old != history.end())
+                    {
+                        slot->max_depth = old->max_depth;
+                        slot->executed = old->executed;
+                        history.erase(old);
+                    }
+                }
+                l = slot.get();
+
+                std::lock_guard<std::mutex> lg(l->mutex);
+                l->tasks.push_back(std::move(t));
+                l->max_depth = std::max(l->max_depth, l->tasks.size());
+                schedule = !l->scheduled;
+                l->scheduled = true;
+            }
+            if (schedule)
+            {
+                workers.submit([this, l]() { drain(l); });
+            }
+        }
+
+        void keyed_executor::drain(lane *l)
+        {
+            for (std::size_t n = 0; n < batch; ++n)
+            {
+                task t;
+                {
+                    std::unique_lock<std::mutex> g(l->mutex);
+                    if (l->tasks.empty())
+                    {
+                        g.unlock();
+                        if (retire(l))
+                        {
+                            return;
+                        }
+                        g.lock();
+                    }
+                    t = std::move(l->tasks.front());
+                    l->tasks.pop_front();
+                    ++l->executed;
+                }
+                run_task(t);
+            }
+            // Still busy: requeue ourselves behind other lanes' work. The lane
+            // stays scheduled, so nothing else drains it in the meantime.
+            workers.submit([this, l]() { drain(l); });
+        }
+
+        bool keyed_executor::retire(lane *l)
+        {
+            std::lock_guard<std::mutex> g(lanes_mutex);
+            {
+                std::lock_guard<std::mutex> lg(l->mutex);
+                if (!l->tasks.empty())
+                {
+                    return false;
+                }
+            }
+
+            // Nothing can reach the lane but through #lanes, which we hold
+            const key_stats last{l->key, 0, l->max_depth, l->executed};
+            if (history.size() < retained)
+            {
+                history.push_back(last);
+            }
+            else
+            {
+                const auto coldest = std::min_element(history.begin(), history.end(),
+                    [](const key_stats &a, const key_stats &b) { return a.max_depth < b.max_depth; });
+                if (coldest->max_depth < last.max_depth)
+                {
+                    *coldest = last;
+                }
+            }
+            lanes.erase(l->key);
+            return true;
+        }
+
+        std::vector<key_stats> keyed_executor::stats() const
+        {
+            std::lock_guard<std::mutex> g(lanes_mutex);
+            std::vector<key_stats> out(history);
+            out.reserve(history.size() + lanes.size());
+            lanes.for_each([&out](snowflake key, const std::unique_ptr<lane> &l)
+            {
+                std::lock_guard<std::mutex> lg(l->mutex);
+                out.push_back(key_stats{key, l->tasks.size(), l->max_depth, l->executed});
+            });
+            return out;
+        }
+
+        std::vector<key_stats> keyed_executor::hottest(std::size_t n) const
+        {
+            std::vector<key_stats> all = stats();
+            n = std::min(n, all.size());
+            std::partial_sort(all.begin(), all.begin() + n, all.end(),
+                [](const key_stats &a, const key_stats &b) { return a.depth > b.depth; });
+            all.resize(n);
+            return all;
+        }
+
+        snowflake ordering_key(const boost::json::value &payload)
+        {
+            const boost::json::object *obj = payload.if_object();
+            const boost::json::value *d = obj ? obj->if_contains("d") : nullptr;
+            const boost::json::object *data = d ? d->if_object() : nullptr;
+            if (!data)
+            {
+                return snowflake();
+            }
+
+            if (const boost::json::value *guild = data->if_contains("guild_id"))
+            {
+                if (const snowflake id = snowflake::from_json(*guild))
+                {
+                    return id;
+                }
+            }
+            if (const boost::json::value *channel = data->if_contains("channel_id"))
+            {
+                if (const snowflake id = snowflake::from_json(*channel))
+                {
+                    return id;
+                }
+            }
+            // GUILD_CREATE/UPDATE/DELETE carry the guild itself as "d"
+            const boost::json::value *t = obj->if_contains("t");
+            if (t && t->is_string() && t->get_string().starts_with("GUILD_"))
+            {
+                if (const boost::json::value *id = data->if_contains("id"))
+                {
+                    return snowflake::from_json(*id);
+                }
+            }
+            return snowflake();
+        }
+    } // namespace exec
+} // namespace discpp
@@ -0,0 +1,291 @@
+/*! \file frame_scanner.cpp
+ *  \brief Lightweight scanner for gateway payload headers
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core/frame_scanner.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        namespace
+        {
+            /*! A cursor over the frame; all helpers advance `pos` and return
+             *  false on malformed input (including running off the end). */
+            struct cursor
+            {
+                const char *pos;
+                const char *end;
+
+                bool skip_ws()
+                {
+                    while (pos != end &&
+                           (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r'))
+                    {
+                        ++pos;
+                    }
+                    return pos != end;
+                }
+
+                bool expect(char c)
+                {
+                    if (!skip_ws() || *pos != c)
+                    {
+                        return false;
+                    }
+                    ++pos;
+                    return true;
+                }
+
+                /*! Reads a string starting at its opening quote, leaving
+                 *  `out` pointing at the raw (still escaped) contents */
+                bool read_string(boost::json::string_view &out)
+                {
+                    if (!expect('"'))
+                    {
+                        return false;
+                    }
+                    const char *begin = pos;
+                    while (pos < end && *pos != '"')
+                    {
+                        // Escapes are at least two characters long, and the
+                        // second one is never a terminating quote on its own
+                        pos += (*pos == '\\') ? 2 : 1;
+                    }
+                    if (pos >= end)
+                    {
+                        return false;
+                    }
+                    out = boost::json::string_view(begin, pos - begin);
+                    ++pos;
+                    return true;
+                }
+
+                bool read_int(std::int64_t &out)
+                {
+                    if (!skip_ws())
+                    {
+                        return false;
+                    }
+                    bool negative = (*pos == '-');
+                    if (negative)
+                    {
+                        ++pos;
+                    }
+                    if (pos == end || *pos < '0' || *pos > '9')
+                    {
+                        return false;
+                    }
+                    std::int64_t v = 0;
+                    while (pos != end && *pos >= '0' && *pos <= '9')
+                    {
+                        v = v * 10 + (*pos - '0');
+                        ++pos;
+                    }
+                    out = negative ? -v : v;
+                    return true;
+                }
+
+                bool read_null()
+                {
+                    if (!skip_ws() || end - pos < 4 ||
+                        boost::json::string_view(pos, 4) != "null")
+                    {
+                        return false;
+                    }
+                    pos += 4;
+                    return true;
+                }
+
+                /*! Steps over any value without looking at what's inside it */
+                bool skip_value()
+                {
+                    if (!skip_ws())
+                    {
+                        return false;
+                    }
+                    if (*pos == '"')
+                    {
+                        boost::json::string_view ignored;
+                        return read_string(ignored);
+                    }
+                    if (*pos != '{' && *pos != '[')
+                    {
+                        // Scalars run until the next delimiter
+                        while (pos != end && *pos != ',' && *pos != '}' && *pos != ']')
+                        {
+                            ++pos;
+                        }
+                        return pos != end;
+                    }
+
+                    // Objects and arrays: track nesting depth, hopping over
+                    // strings so that brackets inside them don't count
+                    std::size_t depth = 0;
+                    while (pos != end)
+                    {
+                        switch (*pos)
+                        {
+                            case '"':
+                            {
+                                boost::json::string_view ignored;
+                                if (!read_string(ignored))
+                                {
+                                    return false;
+                                }
+                                continue;
+                            }
+                            case '{':
+                            case '[':
+                                ++depth;
+                                break;
+                            case '}':
+                            case ']':
+                                if (--depth == 0)
+                                {
+                                    ++pos;
+                                    return true;
+                                }
+                                break;
+                            default:
+                                break;
+                        }
+                        ++pos;
+                    }
+                    return false;
+                }
+            };
+        } // anonymous namespace
+
+        bool peek_header(boost::json::string_view frame, frame_header &header)
+        {
+            const unsigned seen_op = 1, seen_s = 2, seen_t = 4;
+            unsigned seen = 0;
+
+            cursor c{frame.data(), frame.data() + frame.size()};
+            if (!c.expect('{'))
+            {
+                return false;
+            }
+            if (c.skip_ws() && *c.pos == '}')
+            {
+                return true;
+            }
+
+            while (seen != (seen_op | seen_s | seen_t))
+            {
+                boost::json::string_view key;
+                if (!c.read_string(key) || !c.expect(':') || !c.skip_ws())
+                {
+                    return false;
+                }
+
+                bool ok = true;
+                if (key == "op")
+                {
+                    ok = c.read_int(header.op);
+                    seen |= seen_op;
+                }
+                else if (key == "s")
+                {
+                    std::int64_t s;
+                    if (*c.pos == 'n')
+                    {
+                        ok = c.read_null();
+                    }
+                    else if ((ok = c.read_int(s)))
+                    {
+                        header.s = s;
+                    }
+                    seen |= seen_s;
+                }
+                else if (key == "t")
+                {
+                    ok = (*c.pos == 'n') ? c.read_null() : c.read_string(header.t);
+                    seen |= seen_t;
+                }
+                else
+                {
+                    ok = c.skip_value();
+                }
+
+                if (!ok || !c.skip_ws())
+                {
+                    return false;
+                }
+                if (*c.pos == '}')
+                {
+                    return true;
+                }
+                if (*c.pos != ',')
+                {
+                    return false;
+                }
+                ++c.pos;
+            }
+
+            return true;
+        }
+
+        bool peek_member(boost::json::string_view object,
+                         boost::json::string_view key,
+                         boost::json::string_view &value)
+        {
+            cursor c{object.data(), object.data() + object.size()};
+            if (!c.expect('{') || !c.skip_ws() || *c.pos == '}')
+            {
+                return false;
+            }
+
+            for (;;)
+            {
+                boost::json::string_view k;
+                if (!c.read_string(k) || !c.expect(':') || !c.skip_ws())
+                {
+                    return false;
+                }
+
+                const char *begin = c.pos;
+                if (!c.skip_value())
+                {
+                    return false;
+                }
+                if (k == key)
+                {
+                    // Scalars are skipped up to the delimiter, so trim any
+                    // trailing whitespace they picked up
+                    const char *end = c.pos;
+                    while (end != begin && (end[-1] == ' ' || end[-1] == '\t' ||
+                                            end[-1] == '\n' || end[-1] == '\r'))
+                    {
+                        --end;
+                    }
+                    value = boost::json::string_view(begin, end - begin);
+                    return true;
+                }
+
+                if (!c.skip_ws() || *c.pos != ',')
+                {
+                    return false;
+                }
+                ++c.pos;
+            }
+        }
+    } // namespace gateway
+} // namespace discpp
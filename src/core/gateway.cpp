@@ -19,6 +19,7 @@
 #include "core/gateway.hpp"
 #include "net/http.hpp"
 #include "net/ws.hpp"
+#include "core/ondemand.hpp"
 // boost::log
 #define BOOST_LOG_DYN_LINK 1
 #include <boost/log/core.hpp>
@@ -37,6 +38,8 @@
 #include <fstream>
 // std::bind
 #include <functional>
+// std::sort, std::binary_search
+#include <algorithm>
 
 namespace discpp
 {
@@ -61,6 +64,22 @@ namespace discpp
 
             pending_write = false;
             keep_going = true;
+            last_sequence = -1;
+            frames_skipped = 0;
+            bytes_skipped = 0;
+        }
+
+        connection::~connection()
+        {
+            if (session_writer.joinable())
+            {
+                {
+                    std::lock_guard<std::mutex> g(save_mutex);
+                    stop_session_writer = true;
+                }
+                save_wanted.notify_one();
+                session_writer.join();
+            }
         }
 
         void connection::init_logger()
@@ -96,6 +115,182 @@ namespace discpp
             }
         }
 
+        void connection::enable_parse_offload(std::size_t threads)
+        {
+            BOOST_LOG_TRIVIAL(debug) << "Offloading frame parsing to "
+                << threads << " worker thread(s)";
+            parse_pool = std::make_unique<net::thread_pool>(threads);
+        }
+
+        void connection::set_event_filter(std::vector<std::string> events)
+        {
+            std::sort(events.begin(), events.end());
+            event_filter = std::move(events);
+        }
+
+        void connection::set_raw_handler(raw_handler handler)
+        {
+            raw_frame_handler = std::move(handler);
+        }
+
+        const raw_handler &connection::get_raw_handler() const
+        {
+            return raw_frame_handler;
+        }
+
+        filter_stats connection::get_filter_stats() const
+        {
+            return filter_stats{frames_skipped, bytes_skipped};
+        }
+
+        std::int64_t connection::sequence() const
+        {
+            return last_sequence;
+        }
+
+        void connection::use_session_store(session_store &store, std::uint32_t shard,
+                                           std::chrono::seconds interval)
+        {
+            sessions = &store;
+            shard_id = shard;
+            session_save_interval = interval;
+            if (!session_writer.joinable())
+            {
+                session_writer = std::thread(&connection::write_sessions, this);
+            }
+        }
+
+        void connection::request_session_save()
+        {
+            {
+                std::lock_guard<std::mutex> g(save_mutex);
+                save_requested = true;
+            }
+            save_wanted.notify_one();
+        }
+
+        void connection::write_sessions()
+        {
+            std::unique_lock<std::mutex> g(save_mutex);
+            for (;;)
+            {
+                save_wanted.wait(g, [this]() { return save_requested || stop_session_writer; });
+                if (!save_requested)
+                {
+                    return;
+                }
+                save_requested = false;
+                g.unlock();
+                save_session();
+                g.lock();
+            }
+        }
+
+        void connection::restore_session(const session_state &state)
+        {
+            std::lock_guard<std::mutex> g(session_mutex);
+            session_id = state.session_id;
+            resume_url = state.resume_url;
+            last_sequence = state.sequence;
+        }
+
+        session_state connection::session() const
+        {
+            session_state state;
+            {
+                std::lock_guard<std::mutex> g(session_mutex);
+                state.session_id = session_id;
+                state.resume_url = resume_url;
+            }
+            state.sequence = last_sequence;
+            return state;
+        }
+
+        void connection::save_session()
+        {
+            if (!sessions)
+            {
+                return;
+            }
+            session_state state = session();
+            if (state.session_id.empty())
+            {
+                return;
+            }
+            try
+            {
+                std::lock_guard<std::mutex> g(session_io_mutex);
+                sessions->save(shard_id, std::move(state));
+            }
+            catch (const std::system_error &e)
+            {
+                // Not being able to resume later is no reason to stop now
+                BOOST_LOG_TRIVIAL(warning) << "Couldn't save the session: " << e.what();
+            }
+        }
+
+        void connection::track_session(boost::json::string_view frame, const frame_header &header)
+        {
+            using namespace std::chrono;
+            const auto op = static_cast<opcode>(header.op);
+            if (op == opcode::dispatch && header.t == "READY")
+            {
+                ondemand::document doc(frame);
+                const ondemand::value d = doc.root()["d"];
+                const ondemand::value id = d["session_id"];
+                const ondemand::value url = d["resume_gateway_url"];
+                std::lock_guard<std::mutex> g(session_mutex);
+                session_id = id ? id.get_string() : std::string();
+                resume_url = url ? url.get_string() : std::string();
+            }
+            else if (op == opcode::invalid_session)
+            {
+                // "d" tells whether the session may still be resumed
+                ondemand::document doc(frame);
+                const ondemand::value d = doc.root()["d"];
+                if (!d || d.kind() != ondemand::kind::boolean || !d.get_bool())
+                {
+                    {
+                        std::lock_guard<std::mutex> g(session_mutex);
+                        session_id.clear();
+                        resume_url.clear();
+                    }
+                    if (sessions)
+                    {
+                        sessions->clear(shard_id);
+                    }
+                }
+                return;
+            }
+
+            if (!sessions)
+            {
+                return;
+            }
+            const auto now = steady_clock::now();
+            if (header.t == "READY" || header.t == "RESUMED" ||
+                    now - last_session_save >= session_save_interval)
+            {
+                last_session_save = now;
+                request_session_save();
+            }
+        }
+
+        bool connection::wants_frame(const frame_header &header) const
+        {
+            if (static_cast<opcode>(header.op) != opcode::dispatch ||
+                    event_filter.empty() ||
+                    header.t == "READY" || header.t == "RESUMED")
+            {
+                return true;
+            }
+            return std::binary_search(event_filter.begin(), event_filter.end(), header.t,
+                [](boost::json::string_view a, boost::json::string_view b)
+                {
+                    return a < b;
+                });
+        }
+
         context &connection::get_context()
         {
             return discpp_context;
@@ -113,6 +308,17 @@ namespace discpp
             write_queue.push(msg);
         }
 
+        void connection::identify(const identify_options &options, const dispatcher &handlers)
+        {
+            check_intents(handlers, options.requested);
+            push(message(identify_payload(options), boost::none));
+        }
+
+        void connection::update_presence(const presence &p)
+        {
+            push(message(presence_payload(p), boost::none));
+        }
+
         void connection::start_reading()
         {
             BOOST_LOG_TRIVIAL(debug) << "Read loop started.";
@@ -129,10 +335,18 @@ namespace discpp
             // the call handler will handle locking the queue, pushing onto it,
             // and then calling async_read again.
             // TODO: change hard coded infinite loop to check some atomic bool
-            BOOST_LOG_TRIVIAL(debug) << "Calling async_read()...";
+            queue_read();
+        }
+
+        void connection::queue_read()
+        {
+            // We want to reset the buffer, but beast doesn't currently (1.73)
+            // support reusing asio dynamic buffers. So we'll just keep making
+            // new ones for now (letting the destructor free the memory)
             read_buffer = std::make_unique<beast::flat_buffer>();
+            BOOST_LOG_TRIVIAL(debug) << "Calling async_read()...";
             gateway_stream.async_read(*read_buffer, beast::bind_front_handler(
-                            &connection::on_read, shared_from_this()));
+                        &connection::on_read, shared_from_this()));
         }
 
         void connection::on_read(beast::error_code ec, std::size_t bytes_written)
@@ -156,20 +370,99 @@ namespace discpp
                 return;
             }
 
-            BOOST_LOG_TRIVIAL(debug) << "Message contents:\n"
-                << beast::buffers_to_string(read_buffer->data());
+            // Peek at the routing fields first; flat_buffer storage is
+            // contiguous, so we can scan it in place without copying.
+            auto data = read_buffer->data();
+            boost::json::string_view raw(static_cast<const char*>(data.data()), data.size());
+            frame_header header;
+            if (peek_header(raw, header))
+            {
+                if (header.s)
+                {
+                    last_sequence = *header.s;
+                }
+                track_session(raw, header);
+                if (!wants_frame(header))
+                {
+                    BOOST_LOG_TRIVIAL(trace) << "Skipping filtered " << header.t << " event";
+                    frames_skipped++;
+                    bytes_skipped += raw.size();
+                    queue_read();
+                    return;
+                }
+                if (raw_frame_handler && raw_frame_handler(raw, header))
+                {
+                    queue_read();
+                    return;
+                }
+            }
+
+            // Copy the raw frame off the socket buffer, so that we can queue
+            // up the next read before doing any real work on this one.
+            std::string frame(raw.data(), raw.size());
+            BOOST_LOG_TRIVIAL(debug) << "Message contents:\n" << frame;
+            queue_read();
+
+            parse_in_order([self = shared_from_this(), frame = std::move(frame)]()
+            {
+                return boost::make_optional(self->parse_frame(frame));
+            });
+        }
+
+        void connection::parse_in_order(std::function<boost::optional<message>()> parse)
+        {
+            const auto deliver = [this](boost::optional<message> &&msg)
+            {
+                if (msg)
+                {
+                    read_queue.push(std::move(*msg));
+                }
+            };
+
+            if (!parse_pool)
+            {
+                deliver(parse_or_skip(parse));
+                return;
+            }
+
+            // Parsing a large frame (think GUILD_CREATE) can take a while, so
+            // hand it to the pool and let the reorder buffer restore socket
+            // order once the workers are done with it. A frame that fails to
+            // parse still takes its turn, or every later one would wait on it.
+            auto self = shared_from_this();
+            auto seq = read_sequence++;
+            net::post(*parse_pool, [self, seq, deliver, parse = std::move(parse)]()
+            {
+                self->parse_reorder.push(seq, self->parse_or_skip(parse), deliver);
+            });
+        }
 
+        boost::optional<message> connection::parse_or_skip(const std::function<boost::optional<message>()> &parse)
+        {
+            try
+            {
+                return parse();
+            }
+            catch (const std::exception &e)
+            {
+                BOOST_LOG_TRIVIAL(error) << "Dropping a frame that failed to parse: " << e.what();
+                return boost::none;
+            }
+        }
+
+        message connection::parse_frame(const std::string &frame)
+        {
             // This will hold our parsed JSON event data from the gateway
             boost::json::value v;
             try
             {
-                v = boost::json::parse(beast::buffers_to_string(read_buffer->data()));
+                v = boost::json::parse(frame);
             }
             catch(const std::exception& e)
             {
                 BOOST_LOG_TRIVIAL(error) << "Exception " << e.what() << " received.\n"
-                    << "Message contents:\n" << beast::buffers_to_string(read_buffer->data());
-                std::terminate();
+                    << "Message contents:\n" << frame;
+                throw;
             }
 
             // We want to keep track of priority of every message, and pass it along
@@ -202,19 +495,11 @@ namespace discpp
                     // Leave as optional
                     break;
                 default:
-                    throw std::runtime_error("Task failed successfully");
+                    throw std::runtime_error("Unknown gateway opcode " + std::to_string(op));
                     break;
             }
 
-            read_queue.push(std::pair<boost::json::value, boost::optional<time_point<steady_clock>>>(v,deadline));
-
-            // Queue another read! We want to reset the buffer, but beast doesn't
-            // currently (1.73) support reusing asio dynamic buffers. So we'll just
-            // keep making new ones for now (letting the destructor free the memory)
-            read_buffer = std::make_unique<beast::flat_buffer>();
-            BOOST_LOG_TRIVIAL(debug) << "Calling async_read()...";
-            gateway_stream.async_read(*read_buffer, beast::bind_front_handler(
-                        &connection::on_read, shared_from_this()));
+            return message(std::move(v), deadline);
         }
 
         void connection::start_writing()
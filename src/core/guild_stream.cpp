@@ -0,0 +1,452 @@
+/*! \file guild_stream.cpp
+ *  \brief Streaming ingestion of large GUILD_CREATE payloads
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core/guild_stream.hpp"
+#include "core/frame_scanner.hpp"
+
+// boost::json::basic_parser
+#include <boost/json/basic_parser_impl.hpp>
+// boost::log
+#define BOOST_LOG_DYN_LINK 1
+#include <boost/log/trivial.hpp>
+
+#include <string>
+
+namespace discpp
+{
+    namespace gateway
+    {
+        namespace
+        {
+            namespace json = boost::json;
+
+            /*! Depth (number of open containers) at which members of `d` live */
+            const std::size_t d_depth = 2;
+
+            class stream_handler
+            {
+                /*! \class stream_handler
+                 *  \brief basic_parser handler splitting out GUILD_CREATE arrays
+                 *
+                 *  Everything inside `d` that isn't one of the streamed arrays is
+                 *  forwarded to #skeleton, while each element of a streamed
+                 *  array is built on its own in #element and handed off as soon
+                 *  as it closes. Anything outside of `d` is ignored.
+                 */
+                public:
+                    constexpr static std::size_t max_object_size = std::size_t(-1);
+                    constexpr static std::size_t max_array_size = std::size_t(-1);
+                    constexpr static std::size_t max_key_size = std::size_t(-1);
+                    constexpr static std::size_t max_string_size = std::size_t(-1);
+
+                    stream_handler(const guild_stream_handlers &handlers,
+                                   json::string_view guild_id)
+                        : handlers(handlers), guild_id(guild_id)
+                    {
+                    }
+
+                    /*! The trimmed guild, once `d` has closed */
+                    json::value guild;
+
+                    bool on_document_begin(json::error_code&) { return true; }
+                    bool on_document_end(json::error_code&) { return true; }
+
+                    bool on_object_begin(json::error_code&)
+                    {
+                        if (where == state::outside && depth == 1 && next_is_d)
+                        {
+                            where = state::in_d;
+                            d_members = 0;
+                            skeleton.reset();
+                            ++depth;
+                            return true;
+                        }
+                        begin_value();
+                        ++depth;
+                        return true;
+                    }
+
+                    bool on_object_end(std::size_t n, json::error_code&)
+                    {
+                        --depth;
+                        if (where == state::in_d && depth == d_depth - 1)
+                        {
+                            skeleton.push_object(d_members);
+                            guild = skeleton.release();
+                            where = state::done;
+                            return true;
+                        }
+                        if (auto t = target())
+                        {
+                            t->push_object(n);
+                        }
+                        end_value();
+                        return true;
+                    }
+
+                    bool on_array_begin(json::error_code&)
+                    {
+                        if (where == state::in_d && depth == d_depth && !pending_key.empty())
+                        {
+                            streaming = pending_key;
+                            pending_key.clear();
+                            where = state::in_array;
+                            ++depth;
+                            return true;
+                        }
+                        begin_value();
+                        ++depth;
+                        return true;
+                    }
+
+                    bool on_array_end(std::size_t n, json::error_code&)
+                    {
+                        --depth;
+                        if (where == state::in_array && depth == d_depth)
+                        {
+                            where = state::in_d;
+                            return true;
+                        }
+                        if (auto t = target())
+                        {
+                            t->push_array(n);
+                        }
+                        end_value();
+                        return true;
+                    }
+
+                    bool on_key_part(json::string_view s, std::size_t, json::error_code&)
+                    {
+                        key.append(s.data(), s.size());
+                        return true;
+                    }
+
+                    bool on_key(json::string_view s, std::size_t, json::error_code&)
+                    {
+                        key.append(s.data(), s.size());
+                        if (where == state::outside && depth == 1)
+                        {
+                            next_is_d = (key == "d");
+                        }
+                        else if (where == state::in_d && depth == d_depth && is_streamed(key))
+                        {
+                            // Hold off until we know the value really is an array
+                            pending_key = key;
+                        }
+                        else if (auto t = target())
+                        {
+                            t->push_key(key);
+                            if (where == state::in_d && depth == d_depth)
+                            {
+                                ++d_members;
+                            }
+                        }
+                        key.clear();
+                        return true;
+                    }
+
+                    bool on_string_part(json::string_view s, std::size_t, json::error_code&)
+                    {
+                        begin_value();
+                        mid_scalar = true;
+                        if (auto t = target())
+                        {
+                            t->push_chars(s);
+                        }
+                        return true;
+                    }
+
+                    bool on_string(json::string_view s, std::size_t, json::error_code&)
+                    {
+                        begin_value();
+                        if (auto t = target())
+                        {
+                            t->push_string(s);
+                        }
+                        end_value();
+                        return true;
+                    }
+
+                    bool on_number_part(json::string_view, json::error_code&)
+                    {
+                        begin_value();
+                        mid_scalar = true;
+                        return true;
+                    }
+
+                    bool on_int64(std::int64_t i, json::string_view, json::error_code&)
+                    {
+                        begin_value();
+                        if (auto t = target())
+                        {
+                            t->push_int64(i);
+                        }
+                        end_value();
+                        return true;
+                    }
+
+                    bool on_uint64(std::uint64_t u, json::string_view, json::error_code&)
+                    {
+                        begin_value();
+                        if (auto t = target())
+                        {
+                            t->push_uint64(u);
+                        }
+                        end_value();
+                        return true;
+                    }
+
+                    bool on_double(double d, json::string_view, json::error_code&)
+                    {
+                        begin_value();
+                        if (auto t = target())
+                        {
+                            t->push_double(d);
+                        }
+                        end_value();
+                        return true;
+                    }
+
+                    bool on_bool(bool b, json::error_code&)
+                    {
+                        begin_value();
+                        if (auto t = target())
+                        {
+                            t->push_bool(b);
+                        }
+                        end_value();
+                        return true;
+                    }
+
+                    bool on_null(json::error_code&)
+                    {
+                        begin_value();
+                        if (auto t = target())
+                        {
+                            t->push_null();
+                        }
+                        end_value();
+                        return true;
+                    }
+
+                    bool on_comment_part(json::string_view, json::error_code&) { return true; }
+                    bool on_comment(json::string_view, json::error_code&) { return true; }
+
+                private:
+                    enum class state
+                    {
+                        outside,  // not (yet) inside `d`
+                        in_d,     // inside `d`, outside of any streamed array
+                        in_array, // directly inside a streamed array
+                        in_element, // inside an element of a streamed array
+                        done      // `d` has been closed
+                    };
+
+                    static bool is_streamed(const std::string &k)
+                    {
+                        return k == "members" || k == "channels" ||
+                               k == "roles" || k == "presences";
+                    }
+
+                    /*! The stack receiving the current value, if any */
+                    json::value_stack *target()
+                    {
+                        switch (where)
+                        {
+                            case state::in_element:
+                                return &element;
+                            case state::in_d:
+                                return &skeleton;
+                            default:
+                                return nullptr;
+                        }
+                    }
+
+                    /*! Called at the start of every value */
+                    void begin_value()
+                    {
+                        if (mid_scalar)
+                        {
+                            return;
+                        }
+                        if (where == state::in_array && depth == d_depth + 1)
+                        {
+                            element.reset();
+                            where = state::in_element;
+                        }
+                        else if (where == state::in_d && depth == d_depth && !pending_key.empty())
+                        {
+                            // A "streamed" key whose value wasn't an array after
+                            // all; keep it in the skeleton instead
+                            skeleton.push_key(pending_key);
+                            pending_key.clear();
+                            ++d_members;
+                        }
+                    }
+
+                    /*! Called at the end of every value */
+                    void end_value()
+                    {
+                        mid_scalar = false;
+                        if (where != state::in_element || depth != d_depth + 1)
+                        {
+                            return;
+                        }
+
+                        where = state::in_array;
+                        json::value v = element.release();
+                        if (!v.is_object())
+                        {
+                            return;
+                        }
+                        if (streaming == "members" && handlers.on_member)
+                        {
+                            handlers.on_member(guild_id, std::move(v.as_object()));
+                        }
+                        else if (streaming == "channels" && handlers.on_channel)
+                        {
+                            handlers.on_channel(guild_id, std::move(v.as_object()));
+                        }
+                        else if (streaming == "roles" && handlers.on_role)
+                        {
+                            handlers.on_role(guild_id, std::move(v.as_object()));
+                        }
+                        else if (streaming == "presences" && handlers.on_presence)
+                        {
+                            handlers.on_presence(guild_id, std::move(v.as_object()));
+                        }
+                    }
+
+                    const guild_stream_handlers &handlers;
+                    json::string_view guild_id;
+
+                    state where = state::outside;
+                    /*! Number of currently open objects and arrays */
+                    std::size_t depth = 0;
+                    /*! Whether the last top level key was `d` */
+                    bool next_is_d = false;
+                    /*! Whether we're between the parts of a string or number */
+                    bool mid_scalar = false;
+                    /*! Members kept in the trimmed `d` so far */
+                    std::size_t d_members = 0;
+                    /*! The key being assembled from its parts */
+                    std::string key;
+                    /*! A streamed key whose value hasn't started yet */
+                    std::string pending_key;
+                    /*! Which array we're currently streaming */
+                    std::string streaming;
+
+                    json::value_stack skeleton;
+                    json::value_stack element;
+            };
+        } // anonymous namespace
+
+        guild_stream::guild_stream(guild_stream_handlers handlers)
+            : handlers(std::move(handlers))
+        {
+        }
+
+        void guild_stream::feed(boost::json::string_view frame)
+        {
+            // The element callbacks want to know which guild they belong to,
+            // but `d.id` may well come after the arrays; find it up front with
+            // the (allocation free) frame scanner.
+            boost::json::string_view d, id;
+            if (peek_member(frame, "d", d) && peek_member(d, "id", id) &&
+                    id.size() >= 2 && id.front() == '"')
+            {
+                id = id.substr(1, id.size() - 2);
+            }
+            else
+            {
+                id = boost::json::string_view();
+            }
+
+            json::basic_parser<stream_handler> parser(json::parse_options(), handlers, id);
+            json::error_code ec;
+            parser.write_some(false, frame.data(), frame.size(), ec);
+            if (ec)
+            {
+                throw boost::system::system_error(ec);
+            }
+
+            if (handlers.on_guild && parser.handler().guild.is_object())
+            {
+                handlers.on_guild(std::move(parser.handler().guild.as_object()));
+            }
+        }
+
+        void guild_stream::install(connection &cxn)
+        {
+            // Handlers installed before this one, such as a member
+            // requester's, still see every other frame
+            raw_handler next = cxn.get_raw_handler();
+            cxn.set_raw_handler([this, &cxn, next](boost::json::string_view frame,
+                                                   const frame_header &header)
+            {
+                if (header.t != "GUILD_CREATE")
+                {
+                    return next && next(frame, header);
+                }
+
+                // Streaming a large guild takes a while, so it runs on the
+                // parse pool like any other frame, and takes its turn in
+                // socket order. The frame has to outlive the read buffer.
+                std::string copy(frame.data(), frame.size());
+                const boost::optional<std::int64_t> s = header.s;
+                cxn.parse_in_order([this, copy = std::move(copy), s]()
+                {
+                    return boost::make_optional(stream(copy, s));
+                });
+                return true;
+            });
+        }
+
+        message guild_stream::stream(boost::json::string_view frame, boost::optional<std::int64_t> s)
+        {
+            BOOST_LOG_TRIVIAL(debug) << "Streaming GUILD_CREATE of "
+                << frame.size() << " bytes";
+
+            // Capture the trimmed guild on its way to the user's callback,
+            // so that the event itself still shows up in the read queue
+            ::discpp::guild trimmed;
+            guild_stream_handlers capture = handlers;
+            capture.on_guild = [&](::discpp::guild &&g)
+            {
+                if (handlers.on_guild)
+                {
+                    handlers.on_guild(::discpp::guild(g));
+                }
+                trimmed = std::move(g);
+            };
+            guild_stream(std::move(capture)).feed(frame);
+
+            boost::json::object payload;
+            payload["op"] = static_cast<int>(opcode::dispatch);
+            payload["t"] = "GUILD_CREATE";
+            if (s)
+            {
+                payload["s"] = *s;
+            }
+            payload["d"] = std::move(trimmed);
+            return message(boost::json::value(std::move(payload)), boost::none);
+        }
+    } // namespace gateway
+} // namespace discpp
@@ -0,0 +1,249 @@
+/*! \file identify.cpp
+ *  \brief IDENTIFY and presence payloads, and gateway intents
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdexcept>
+
+#include "core/dispatcher.hpp"
+#include "core/identify.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        static_assert(intents::unprivileged() ==
+            (intent::guilds | intent::guild_moderation | intent::guild_expressions |
+             intent::guild_integrations | intent::guild_webhooks | intent::guild_invites |
+             intent::guild_voice_states | intent::guild_messages |
+             intent::guild_message_reactions | intent::guild_message_typing |
+             intent::direct_messages | intent::direct_message_reactions |
+             intent::direct_message_typing | intent::guild_scheduled_events |
+             intent::auto_moderation_configuration | intent::auto_moderation_execution),
+            "unprivileged() must list every non-privileged intent");
+
+        intents intents_for(event e)
+        {
+            switch (e)
+            {
+                case event::guild_create:
+                case event::guild_update:
+                case event::guild_delete:
+                case event::guild_role_create:
+                case event::guild_role_update:
+                case event::guild_role_delete:
+                case event::channel_create:
+                case event::channel_update:
+                case event::channel_delete:
+                case event::thread_create:
+                case event::thread_update:
+                case event::thread_delete:
+                case event::thread_list_sync:
+                case event::thread_member_update:
+                case event::thread_members_update:
+                case event::stage_instance_create:
+                case event::stage_instance_update:
+                case event::stage_instance_delete:
+                    return intent::guilds;
+                case event::channel_pins_update:
+                    return intent::guilds | intent::direct_messages;
+
+                case event::guild_member_add:
+                case event::guild_member_update:
+                case event::guild_member_remove:
+                    return intent::guild_members;
+
+                case event::guild_audit_log_entry_create:
+                case event::guild_ban_add:
+                case event::guild_ban_remove:
+                    return intent::guild_moderation;
+
+                case event::guild_emojis_update:
+                case event::guild_stickers_update:
+                    return intent::guild_expressions;
+
+                case event::guild_integrations_update:
+                case event::integration_create:
+                case event::integration_update:
+                case event::integration_delete:
+                    return intent::guild_integrations;
+
+                case event::webhooks_update:
+                    return intent::guild_webhooks;
+
+                case event::invite_create:
+                case event::invite_delete:
+                    return intent::guild_invites;
+
+                case event::voice_state_update:
+                    return intent::guild_voice_states;
+
+                case event::presence_update:
+                    return intent::guild_presences;
+
+                case event::message_create:
+                case event::message_update:
+                case event::message_delete:
+                    return intent::guild_messages | intent::direct_messages;
+                case event::message_delete_bulk:
+                    return intent::guild_messages;
+
+                case event::message_reaction_add:
+                case event::message_reaction_remove:
+                case event::message_reaction_remove_all:
+                case event::message_reaction_remove_emoji:
+                    return intent::guild_message_reactions | intent::direct_message_reactions;
+
+                case event::typing_start:
+                    return intent::guild_message_typing | intent::direct_message_typing;
+
+                case event::guild_scheduled_event_create:
+                case event::guild_scheduled_event_update:
+                case event::guild_scheduled_event_delete:
+                case event::guild_scheduled_event_user_add:
+                case event::guild_scheduled_event_user_remove:
+                    return intent::guild_scheduled_events;
+
+                case event::auto_moderation_rule_create:
+                case event::auto_moderation_rule_update:
+                case event::auto_moderation_rule_delete:
+                    return intent::auto_moderation_configuration;
+                case event::auto_moderation_action_execution:
+                    return intent::auto_moderation_execution;
+
+                // Sent regardless of intents: session events, replies to our
+                // own requests, and interactions
+                case event::ready:
+                case event::resumed:
+                case event::user_update:
+                case event::interaction_create:
+                case event::voice_server_update:
+                case event::application_command_permissions_update:
+                case event::guild_members_chunk:
+                case event::unknown:
+                    break;
+            }
+            return intents();
+        }
+
+        std::vector<event> uncovered_events(const std::vector<event> &events, intents requested)
+        {
+            std::vector<event> out;
+            for (event e : events)
+            {
+                const intents needed = intents_for(e);
+                if (!needed.empty() && !requested.intersects(needed))
+                {
+                    out.push_back(e);
+                }
+            }
+            return out;
+        }
+
+        void check_intents(const dispatcher &d, intents requested)
+        {
+            const std::vector<event> missing = uncovered_events(d.registered_events(), requested);
+            if (missing.empty())
+            {
+                return;
+            }
+            std::string names;
+            for (event e : missing)
+            {
+                if (!names.empty())
+                {
+                    names += ", ";
+                }
+                names.append(event_name(e).data(), event_name(e).size());
+            }
+            throw std::invalid_argument("handlers registered for events the requested intents "
+                                        "don't cover: " + names);
+        }
+
+        boost::json::object presence::to_json() const
+        {
+            boost::json::object d;
+            if (since)
+            {
+                d["since"] = *since;
+            }
+            else
+            {
+                d["since"] = nullptr;
+            }
+            d["activities"] = activities;
+            d["status"] = boost::json::string_view(status);
+            d["afk"] = afk;
+            return d;
+        }
+
+        void identify_options::validate() const
+        {
+            if (token.empty())
+            {
+                throw std::invalid_argument("identify: no token");
+            }
+            if (large_threshold < 50 || large_threshold > 250)
+            {
+                throw std::invalid_argument("identify: large_threshold must be between 50 and 250");
+            }
+            if (shard_count == 0 || shard_id >= shard_count)
+            {
+                throw std::invalid_argument("identify: shard_id must be below shard_count");
+            }
+        }
+
+        boost::json::object identify_payload(const identify_options &options)
+        {
+            options.validate();
+
+            boost::json::object properties;
+            properties["os"] = boost::json::string_view(options.os);
+            properties["browser"] = boost::json::string_view(options.library);
+            properties["device"] = boost::json::string_view(options.library);
+
+            boost::json::array shard;
+            shard.emplace_back(options.shard_id);
+            shard.emplace_back(options.shard_count);
+
+            boost::json::object d;
+            d["token"] = boost::json::string_view(options.token);
+            d["properties"] = std::move(properties);
+            d["large_threshold"] = options.large_threshold;
+            d["shard"] = std::move(shard);
+            d["intents"] = options.requested.value();
+            if (options.initial_presence)
+            {
+                d["presence"] = options.initial_presence->to_json();
+            }
+
+            boost::json::object payload;
+            payload["op"] = static_cast<int>(opcode::identify);
+            payload["d"] = std::move(d);
+            return payload;
+        }
+
+        boost::json::object presence_payload(const presence &p)
+        {
+            boost::json::object payload;
+            payload["op"] = static_cast<int>(opcode::presence_update);
+            payload["d"] = p.to_json();
+            return payload;
+        }
+    } // namespace gateway
+} // namespace discpp
@@ -0,0 +1,106 @@
+/*! \file mapped_file.cpp
+ *  \brief Read-only memory-mapped files
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/mapped_file.hpp"
+
+namespace discpp
+{
+    mapped_file::mapped_file(const std::string &path, access_hint hint)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            const int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), "stat " + path);
+        }
+
+        _size = static_cast<std::size_t>(st.st_size);
+        if (_size > 0)
+        {
+            void *p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                const int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(), "mmap " + path);
+            }
+            _data = static_cast<const char*>(p);
+
+            if (hint != access_hint::normal)
+            {
+                // Only advice; failing to take it is harmless
+                ::madvise(p, _size, hint == access_hint::sequential ? MADV_SEQUENTIAL
+                                                                    : MADV_RANDOM);
+            }
+        }
+        // The mapping holds its own reference to the file
+        ::close(fd);
+    }
+
+    mapped_file::~mapped_file()
+    {
+        unmap();
+    }
+
+    mapped_file::mapped_file(mapped_file &&other) noexcept
+        : _data(other._data), _size(other._size)
+    {
+        other._data = nullptr;
+        other._size = 0;
+    }
+
+    mapped_file &mapped_file::operator=(mapped_file &&other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            _data = other._data;
+            _size = other._size;
+            other._data = nullptr;
+            other._size = 0;
+        }
+        return *this;
+    }
+
+    void mapped_file::unmap()
+    {
+        if (_data)
+        {
+            ::munmap(const_cast<char*>(_data), _size);
+            _data = nullptr;
+            _size = 0;
+        }
+    }
+} // namespace discpp
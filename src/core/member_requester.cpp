@@ -0,0 +1,267 @@
+/*! \file member_requester.cpp
+ *  \brief Requests for guild members, answered in GUILD_MEMBERS_CHUNKs
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include <boost/optional.hpp>
+
+#include "core/member_requester.hpp"
+#include "core/ondemand.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        namespace json = boost::json;
+
+        namespace
+        {
+            std::uint32_t count_at(const json::object &obj, json::string_view key, std::uint32_t fallback)
+            {
+                const json::value *v = obj.if_contains(key);
+                if (v && v->is_int64() && v->get_int64() >= 0)
+                {
+                    return static_cast<std::uint32_t>(v->get_int64());
+                }
+                if (v && v->is_uint64())
+                {
+                    return static_cast<std::uint32_t>(v->get_uint64());
+                }
+                return fallback;
+            }
+        } // anonymous namespace
+
+        member_requester::member_requester(connection &cxn, std::size_t max_in_flight,
+                                           std::chrono::steady_clock::duration timeout)
+            : cxn(cxn), max_in_flight(std::max<std::size_t>(max_in_flight, 1)), timeout(timeout)
+        {
+        }
+
+        void member_requester::attach(dispatcher &d)
+        {
+            d.on(event::guild_members_chunk, [this](const json::value &payload)
+            {
+                apply(payload);
+            }, execution::sync);
+
+            raw_handler next = cxn.get_raw_handler();
+            cxn.set_raw_handler([this, next](json::string_view frame, const frame_header &header)
+            {
+                const auto op = static_cast<opcode>(header.op);
+                if (op == opcode::dispatch && header.t == "READY")
+                {
+                    // A new session: nothing sent on the old one gets answered
+                    cancel_all();
+                }
+                else if (op == opcode::invalid_session)
+                {
+                    // "d" tells whether the session may still be resumed, in
+                    // which case the answers are replayed
+                    const ondemand::document doc(frame);
+                    const ondemand::value resumable = doc.root()["d"];
+                    if (!resumable || resumable.kind() != ondemand::kind::boolean ||
+                            !resumable.get_bool())
+                    {
+                        cancel_all();
+                    }
+                }
+                expire();
+                return next && next(frame, header);
+            });
+        }
+
+        std::future<std::size_t> member_requester::request(member_request req, chunk_handler on_chunk)
+        {
+            pending p;
+            p.req = std::move(req);
+            p.on_chunk = std::move(on_chunk);
+            std::future<std::size_t> result = p.done.get_future();
+
+            std::lock_guard<std::mutex> g(mutex);
+            // Nonces are at most 32 bytes, which a counter never comes near
+            p.nonce = std::to_string(next_nonce++);
+            waiting.push_back(std::move(p));
+            send_queued();
+            return result;
+        }
+
+        void member_requester::send_queued()
+        {
+            while (outstanding.size() < max_in_flight && !waiting.empty())
+            {
+                outstanding.push_back(std::move(waiting.front()));
+                waiting.pop_front();
+                outstanding.back().deadline = std::chrono::steady_clock::now() + timeout;
+                cxn.push(message(request_payload(outstanding.back()), boost::none));
+            }
+        }
+
+        json::object member_requester::request_payload(const pending &p)
+        {
+            json::object d;
+            d["guild_id"] = json::string_view(p.req.guild_id.to_string());
+            if (p.req.user_ids.empty())
+            {
+                d["query"] = json::string_view(p.req.query);
+                d["limit"] = p.req.limit;
+            }
+            else
+            {
+                json::array ids;
+                for (snowflake id : p.req.user_ids)
+                {
+                    ids.emplace_back(json::string_view(id.to_string()));
+                }
+                d["user_ids"] = std::move(ids);
+            }
+            d["presences"] = p.req.presences;
+            d["nonce"] = json::string_view(p.nonce);
+
+            json::object payload;
+            payload["op"] = static_cast<int>(opcode::request_guild_members);
+            payload["d"] = std::move(d);
+            return payload;
+        }
+
+        void member_requester::apply(const json::value &payload)
+        {
+            const json::object *obj = payload.if_object();
+            const json::value *d = obj ? obj->if_contains("d") : nullptr;
+            const json::object *chunk = d ? d->if_object() : nullptr;
+            const json::value *nonce = chunk ? chunk->if_contains("nonce") : nullptr;
+            if (!nonce || !nonce->is_string())
+            {
+                return;
+            }
+
+            const json::value *members = chunk->if_contains("members");
+            const std::uint32_t chunk_count = std::max<std::uint32_t>(count_at(*chunk, "chunk_count", 1), 1);
+            const std::uint32_t chunk_index = count_at(*chunk, "chunk_index", 0);
+
+            chunk_handler on_chunk;
+            boost::optional<pending> finished;
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                const json::string_view key = nonce->get_string();
+                auto it = std::find_if(outstanding.begin(), outstanding.end(),
+                    [key](const pending &p)
+                    {
+                        return json::string_view(p.nonce) == key;
+                    });
+                if (it == outstanding.end())
+                {
+                    return;
+                }
+
+                if (it->chunks.empty())
+                {
+                    it->chunks.resize(chunk_count);
+                }
+                if (chunk_index >= it->chunks.size() || it->chunks[chunk_index])
+                {
+                    // Out of range, or a repeat: counting it would complete
+                    // the request before every chunk is in
+                    return;
+                }
+                it->chunks[chunk_index] = true;
+                ++it->chunks_seen;
+                it->deadline = std::chrono::steady_clock::now() + timeout;
+                if (const json::array *arr = members ? members->if_array() : nullptr)
+                {
+                    it->members_seen += arr->size();
+                }
+                on_chunk = it->on_chunk;
+
+                if (it->chunks_seen == it->chunks.size())
+                {
+                    finished = std::move(*it);
+                    outstanding.erase(it);
+                    send_queued();
+                }
+            }
+
+            // Outside the lock, so handlers may issue requests of their own
+            if (on_chunk)
+            {
+                on_chunk(*chunk);
+            }
+            if (finished)
+            {
+                finished->done.set_value(finished->members_seen);
+            }
+        }
+
+        void member_requester::cancel_all()
+        {
+            std::vector<pending> cancelled;
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                cancelled = std::move(outstanding);
+                outstanding.clear();
+                for (pending &p : waiting)
+                {
+                    cancelled.push_back(std::move(p));
+                }
+                waiting.clear();
+            }
+            fail(cancelled, "member request cancelled");
+        }
+
+        void member_requester::expire(std::chrono::steady_clock::time_point now)
+        {
+            std::vector<pending> expired;
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                auto late = std::stable_partition(outstanding.begin(), outstanding.end(),
+                    [now](const pending &p) { return p.deadline > now; });
+                if (late == outstanding.end())
+                {
+                    return;
+                }
+                std::move(late, outstanding.end(), std::back_inserter(expired));
+                outstanding.erase(late, outstanding.end());
+                send_queued();
+            }
+            fail(expired, "member request timed out");
+        }
+
+        void member_requester::fail(std::vector<pending> &requests, const char *what)
+        {
+            for (pending &p : requests)
+            {
+                p.done.set_exception(std::make_exception_ptr(std::runtime_error(what)));
+            }
+        }
+
+        std::size_t member_requester::in_flight() const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            return outstanding.size();
+        }
+
+        std::size_t member_requester::queued() const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            return waiting.size();
+        }
+    } // namespace gateway
+} // namespace discpp
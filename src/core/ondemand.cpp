@@ -0,0 +1,626 @@
+/*! \file ondemand.cpp
+ *  \brief Lazy, index-based JSON field access for gateway frames
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core/ondemand.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISCPP_ONDEMAND_X86 1
+#include <immintrin.h>
+#endif
+
+namespace discpp
+{
+    namespace ondemand
+    {
+        namespace
+        {
+            /*! Character classes of one 64 byte block, one bit per byte */
+            struct block_masks
+            {
+                std::uint64_t quote;
+                std::uint64_t backslash;
+                /*! `{}[]:,` */
+                std::uint64_t op;
+            };
+
+            using classify_fn = void (*)(const char *, block_masks &);
+
+            void classify_scalar(const char *in, block_masks &m)
+            {
+                m = block_masks{0, 0, 0};
+                for (unsigned i = 0; i < 64; ++i)
+                {
+                    const unsigned char c = in[i];
+                    const std::uint64_t bit = std::uint64_t(1) << i;
+                    // '[' and ']' are '{' and '}' with bit 5 cleared
+                    if (c == '"')
+                    {
+                        m.quote |= bit;
+                    }
+                    else if (c == '\\')
+                    {
+                        m.backslash |= bit;
+                    }
+                    else if ((c | 0x20) == '{' || (c | 0x20) == '}' || c == ':' || c == ',')
+                    {
+                        m.op |= bit;
+                    }
+                }
+            }
+
+#ifdef DISCPP_ONDEMAND_X86
+            __attribute__((target("sse4.2")))
+            void classify_sse42(const char *in, block_masks &m)
+            {
+                const __m128i ops = _mm_setr_epi8('{', '}', '[', ']', ':', ',',
+                                                  0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+                const __m128i quote = _mm_set1_epi8('"');
+                const __m128i backslash = _mm_set1_epi8('\\');
+
+                m = block_masks{0, 0, 0};
+                for (unsigned i = 0; i < 4; ++i)
+                {
+                    const __m128i chunk =
+                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 16 * i));
+                    const std::uint64_t q = static_cast<std::uint16_t>(
+                        _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)));
+                    const std::uint64_t b = static_cast<std::uint16_t>(
+                        _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash)));
+                    // Explicit lengths, so that NUL bytes don't end the match
+                    const std::uint64_t o = static_cast<std::uint16_t>(_mm_cvtsi128_si32(
+                        _mm_cmpestrm(ops, 6, chunk, 16,
+                                     _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK)));
+                    m.quote |= q << (16 * i);
+                    m.backslash |= b << (16 * i);
+                    m.op |= o << (16 * i);
+                }
+            }
+
+            __attribute__((target("avx2")))
+            void classify_avx2(const char *in, block_masks &m)
+            {
+                const __m256i quote = _mm256_set1_epi8('"');
+                const __m256i backslash = _mm256_set1_epi8('\\');
+                const __m256i case_bit = _mm256_set1_epi8(0x20);
+                const __m256i open = _mm256_set1_epi8('{');
+                const __m256i close = _mm256_set1_epi8('}');
+                const __m256i colon = _mm256_set1_epi8(':');
+                const __m256i comma = _mm256_set1_epi8(',');
+
+                m = block_masks{0, 0, 0};
+                for (unsigned i = 0; i < 2; ++i)
+                {
+                    const __m256i chunk =
+                        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + 32 * i));
+                    // Folding bit 5 in lets '{' catch '[' and '}' catch ']'
+                    const __m256i folded = _mm256_or_si256(chunk, case_bit);
+                    const __m256i op = _mm256_or_si256(
+                        _mm256_or_si256(_mm256_cmpeq_epi8(folded, open),
+                                        _mm256_cmpeq_epi8(folded, close)),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, colon),
+                                        _mm256_cmpeq_epi8(chunk, comma)));
+
+                    const std::uint64_t q = static_cast<std::uint32_t>(
+                        _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, quote)));
+                    const std::uint64_t b = static_cast<std::uint32_t>(
+                        _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, backslash)));
+                    const std::uint64_t o = static_cast<std::uint32_t>(
+                        _mm256_movemask_epi8(op));
+                    m.quote |= q << (32 * i);
+                    m.backslash |= b << (32 * i);
+                    m.op |= o << (32 * i);
+                }
+            }
+#endif
+
+            classify_fn classifier(simd_level level)
+            {
+#ifdef DISCPP_ONDEMAND_X86
+                switch (level)
+                {
+                    case simd_level::avx2:
+                        return classify_avx2;
+                    case simd_level::sse42:
+                        return classify_sse42;
+                    case simd_level::scalar:
+                        break;
+                }
+#else
+                (void)level;
+#endif
+                return classify_scalar;
+            }
+
+            /*! Returns the characters escaped by a backslash, carrying runs of
+             *  backslashes across blocks through `prev_escaped`.
+             *
+             *  Runs starting on odd and even bits are told apart with a single
+             *  add, so that each run escapes exactly the character after its
+             *  last backslash when its length is odd.
+             */
+            std::uint64_t find_escaped(std::uint64_t backslash, std::uint64_t &prev_escaped)
+            {
+                const std::uint64_t even_bits = 0x5555555555555555ULL;
+
+                backslash &= ~prev_escaped;
+                const std::uint64_t follows_escape = (backslash << 1) | prev_escaped;
+                const std::uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+
+                const std::uint64_t even_starts = odd_starts + backslash;
+                prev_escaped = (even_starts < odd_starts) ? 1 : 0;
+
+                return (even_bits ^ (even_starts << 1)) & follows_escape;
+            }
+
+            /*! Bit i of the result is the XOR of bits 0..i of `x` */
+            std::uint64_t prefix_xor(std::uint64_t x)
+            {
+                x ^= x << 1;
+                x ^= x << 2;
+                x ^= x << 4;
+                x ^= x << 8;
+                x ^= x << 16;
+                x ^= x << 32;
+                return x;
+            }
+
+            bool is_ws(char c)
+            {
+                return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+            }
+
+            bool is_number_char(char c)
+            {
+                return (c >= '0' && c <= '9') || c == '-' || c == '+' ||
+                       c == '.' || c == 'e' || c == 'E';
+            }
+
+            void append_utf8(std::string &out, std::uint32_t cp)
+            {
+                if (cp < 0x80)
+                {
+                    out += static_cast<char>(cp);
+                }
+                else if (cp < 0x800)
+                {
+                    out += static_cast<char>(0xC0 | (cp >> 6));
+                    out += static_cast<char>(0x80 | (cp & 0x3F));
+                }
+                else if (cp < 0x10000)
+                {
+                    out += static_cast<char>(0xE0 | (cp >> 12));
+                    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (cp & 0x3F));
+                }
+                else
+                {
+                    out += static_cast<char>(0xF0 | (cp >> 18));
+                    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (cp & 0x3F));
+                }
+            }
+
+            std::uint32_t read_hex4(const char *p, const char *end)
+            {
+                if (end - p < 4)
+                {
+                    throw std::invalid_argument("Truncated \\u escape in JSON string");
+                }
+                std::uint32_t v = 0;
+                for (int i = 0; i < 4; ++i)
+                {
+                    const char c = p[i];
+                    v <<= 4;
+                    if (c >= '0' && c <= '9')      v |= c - '0';
+                    else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+                    else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+                    else throw std::invalid_argument("Invalid \\u escape in JSON string");
+                }
+                return v;
+            }
+        } // anonymous namespace
+
+        simd_level active_simd_level()
+        {
+#ifdef DISCPP_ONDEMAND_X86
+            static const simd_level level = []
+            {
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx2"))
+                {
+                    return simd_level::avx2;
+                }
+                if (__builtin_cpu_supports("sse4.2"))
+                {
+                    return simd_level::sse42;
+                }
+                return simd_level::scalar;
+            }();
+            return level;
+#else
+            return simd_level::scalar;
+#endif
+        }
+
+        document::document(boost::json::string_view json, simd_level level) : json(json)
+        {
+            if (json.size() >= std::numeric_limits<std::uint32_t>::max())
+            {
+                throw std::invalid_argument("JSON text too large to index");
+            }
+            // Never use more than the CPU actually has
+            if (static_cast<int>(level) > static_cast<int>(active_simd_level()))
+            {
+                level = active_simd_level();
+            }
+            const classify_fn classify = classifier(level);
+
+            // A rough guess; gateway payloads run at about one structural per
+            // six to eight bytes
+            structurals.reserve(json.size() / 6 + 2);
+
+            const char *data = json.data();
+            const std::size_t n = json.size();
+            std::uint64_t prev_escaped = 0;
+            std::uint64_t prev_in_string = 0;
+            char tail[64];
+
+            for (std::size_t base = 0; base < n; base += 64)
+            {
+                const char *block = data + base;
+                if (n - base < 64)
+                {
+                    // Pad the last block with whitespace, which is never
+                    // structural
+                    std::memset(tail, ' ', sizeof(tail));
+                    std::memcpy(tail, block, n - base);
+                    block = tail;
+                }
+
+                block_masks m;
+                classify(block, m);
+
+                const std::uint64_t escaped = (m.backslash | prev_escaped) ?
+                    find_escaped(m.backslash, prev_escaped) : 0;
+                const std::uint64_t quotes = m.quote & ~escaped;
+                // Opening quotes and string contents are set, closing quotes
+                // aren't; that's fine, since we record all quotes regardless
+                const std::uint64_t in_string = prefix_xor(quotes) ^ prev_in_string;
+                prev_in_string = (in_string >> 63) ? ~std::uint64_t(0) : 0;
+
+                std::uint64_t bits = (m.op & ~in_string) | quotes;
+                while (bits)
+                {
+                    structurals.push_back(static_cast<std::uint32_t>(
+                        base + __builtin_ctzll(bits)));
+                    bits &= bits - 1;
+                }
+            }
+
+            if (prev_in_string)
+            {
+                throw std::invalid_argument("Unterminated string in JSON text");
+            }
+            structurals.push_back(static_cast<std::uint32_t>(n));
+        }
+
+        value document::root() const
+        {
+            std::uint32_t p = 0;
+            while (p < json.size() && is_ws(json[p]))
+            {
+                ++p;
+            }
+            return value(this, p, 0);
+        }
+
+        enum kind value::kind() const
+        {
+            if (!doc || pos >= doc->json.size())
+            {
+                return kind::absent;
+            }
+            switch (doc->json[pos])
+            {
+                case '{': return kind::object;
+                case '[': return kind::array;
+                case '"': return kind::string;
+                case 't':
+                case 'f': return kind::boolean;
+                case 'n': return kind::null;
+                default:  return kind::number;
+            }
+        }
+
+        void value::expect(enum kind k) const
+        {
+            if (kind() != k)
+            {
+                throw std::invalid_argument("JSON value is not of the requested type");
+            }
+        }
+
+        value value::after(std::uint32_t i) const
+        {
+            std::uint32_t p = doc->offset(i) + 1;
+            while (p < doc->json.size() && is_ws(doc->json[p]))
+            {
+                ++p;
+            }
+            return value(doc, p, i + 1);
+        }
+
+        std::uint32_t value::skip() const
+        {
+            switch (kind())
+            {
+                case kind::object:
+                case kind::array:
+                {
+                    // Brackets inside strings were never indexed, so we can
+                    // just count nesting depth
+                    std::size_t depth = 0;
+                    for (std::uint32_t i = idx; ; ++i)
+                    {
+                        switch (doc->token(i))
+                        {
+                            case '{':
+                            case '[':
+                                ++depth;
+                                break;
+                            case '}':
+                            case ']':
+                                if (--depth == 0)
+                                {
+                                    return i + 1;
+                                }
+                                break;
+                            case '\0':
+                                throw std::invalid_argument("Unbalanced JSON text");
+                            default:
+                                break;
+                        }
+                    }
+                }
+                case kind::string:
+                    // Opening and closing quotes
+                    return idx + 2;
+                default:
+                    // Scalars contain no structurals at all
+                    return idx;
+            }
+        }
+
+        value value::operator[](boost::json::string_view key) const
+        {
+            if (!exists())
+            {
+                return value();
+            }
+            expect(kind::object);
+
+            std::uint32_t i = idx + 1;
+            while (doc->token(i) == '"')
+            {
+                boost::json::string_view k(doc->json.data() + doc->offset(i) + 1,
+                                           doc->offset(i + 1) - doc->offset(i) - 1);
+                value v = after(i + 2);
+                if (k == key)
+                {
+                    return v;
+                }
+                i = v.skip();
+                if (doc->token(i) != ',')
+                {
+                    break;
+                }
+                ++i;
+            }
+            return value();
+        }
+
+        value value::at(std::size_t n) const
+        {
+            if (!exists())
+            {
+                return value();
+            }
+            expect(kind::array);
+            if (after(idx).pos == doc->offset(idx + 1) && doc->token(idx + 1) == ']')
+            {
+                return value(); // empty array
+            }
+
+            // Skip the elements before the wanted one, and stop there
+            std::uint32_t i = idx;
+            for (;;)
+            {
+                value v = after(i);
+                if (n-- == 0)
+                {
+                    return v;
+                }
+                i = v.skip();
+                if (doc->token(i) != ',')
+                {
+                    return value();
+                }
+            }
+        }
+
+        value value::at_path(boost::json::string_view path) const
+        {
+            value v = *this;
+            while (v && !path.empty())
+            {
+                const auto dot = path.find('.');
+                v = v[path.substr(0, dot)];
+                path = (dot == boost::json::string_view::npos) ?
+                    boost::json::string_view() : path.substr(dot + 1);
+            }
+            return v;
+        }
+
+        boost::json::string_view value::get_raw_string() const
+        {
+            expect(kind::string);
+            return boost::json::string_view(doc->json.data() + pos + 1,
+                                            doc->offset(idx + 1) - pos - 1);
+        }
+
+        std::string value::get_string() const
+        {
+            const auto raw = get_raw_string();
+            const char *p = raw.data();
+            const char *end = p + raw.size();
+
+            std::string out;
+            out.reserve(raw.size());
+            while (p != end)
+            {
+                if (*p != '\\')
+                {
+                    out += *p++;
+                    continue;
+                }
+                if (++p == end)
+                {
+                    throw std::invalid_argument("Truncated escape in JSON string");
+                }
+                switch (*p++)
+                {
+                    case '"':  out += '"';  break;
+                    case '\\': out += '\\'; break;
+                    case '/':  out += '/';  break;
+                    case 'b':  out += '\b'; break;
+                    case 'f':  out += '\f'; break;
+                    case 'n':  out += '\n'; break;
+                    case 'r':  out += '\r'; break;
+                    case 't':  out += '\t'; break;
+                    case 'u':
+                    {
+                        std::uint32_t cp = read_hex4(p, end);
+                        p += 4;
+                        // Recombine UTF-16 surrogate pairs
+                        if (cp >= 0xD800 && cp < 0xDC00 &&
+                                end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                        {
+                            const std::uint32_t low = read_hex4(p + 2, end);
+                            if (low >= 0xDC00 && low < 0xE000)
+                            {
+                                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                                p += 6;
+                            }
+                        }
+                        append_utf8(out, cp);
+                        break;
+                    }
+                    default:
+                        throw std::invalid_argument("Invalid escape in JSON string");
+                }
+            }
+            return out;
+        }
+
+        std::int64_t value::get_int64() const
+        {
+            expect(kind::number);
+            const char *p = doc->json.data() + pos;
+            const char *end = doc->json.data() + doc->json.size();
+            const bool negative = (*p == '-');
+            if (negative)
+            {
+                ++p;
+            }
+
+            std::uint64_t v = 0;
+            while (p != end && *p >= '0' && *p <= '9')
+            {
+                v = v * 10 + static_cast<std::uint64_t>(*p++ - '0');
+            }
+            return negative ? -static_cast<std::int64_t>(v) : static_cast<std::int64_t>(v);
+        }
+
+        std::uint64_t value::get_uint64() const
+        {
+            expect(kind::number);
+            const char *p = doc->json.data() + pos;
+            const char *end = doc->json.data() + doc->json.size();
+            if (*p == '-')
+            {
+                throw std::invalid_argument("JSON number is negative");
+            }
+
+            std::uint64_t v = 0;
+            while (p != end && *p >= '0' && *p <= '9')
+            {
+                v = v * 10 + static_cast<std::uint64_t>(*p++ - '0');
+            }
+            return v;
+        }
+
+        double value::get_double() const
+        {
+            // The text isn't NUL terminated, so strtod needs its own copy
+            const auto text = raw_json();
+            return std::strtod(std::string(text.data(), text.size()).c_str(), nullptr);
+        }
+
+        bool value::get_bool() const
+        {
+            expect(kind::boolean);
+            return doc->json[pos] == 't';
+        }
+
+        boost::json::string_view value::raw_json() const
+        {
+            std::uint32_t end = pos;
+            switch (kind())
+            {
+                case kind::absent:
+                    return boost::json::string_view();
+                case kind::object:
+                case kind::array:
+                    end = doc->offset(skip() - 1) + 1;
+                    break;
+                case kind::string:
+                    end = doc->offset(idx + 1) + 1;
+                    break;
+                case kind::number:
+                    while (end < doc->json.size() && is_number_char(doc->json[end]))
+                    {
+                        ++end;
+                    }
+                    break;
+                case kind::boolean:
+                case kind::null:
+                    end += (doc->json[pos] == 'f') ? 5 : 4;
+                    break;
+            }
+            return boost::json::string_view(doc->json.data() + pos, end - pos);
+        }
+    } // namespace ondemand
+} // namespace discpp
@@ -0,0 +1,133 @@
+/*! \file presence_coalescer.cpp
+ *  \brief Collapses bursts of PRESENCE_UPDATEs to each member's latest
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdexcept>
+
+#define BOOST_LOG_DYN_LINK 1
+#include <boost/log/trivial.hpp>
+
+#include "core/ondemand.hpp"
+#include "core/presence_coalescer.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        presence_coalescer::presence_coalescer(boost::asio::io_context &ioc,
+                                               std::chrono::milliseconds window)
+            : timer(ioc), window(window)
+        {
+        }
+
+        void presence_coalescer::install(connection &cxn)
+        {
+            this->cxn = &cxn;
+            raw_handler next = cxn.get_raw_handler();
+            std::weak_ptr<presence_coalescer> weak = shared_from_this();
+            cxn.set_raw_handler([weak, next](boost::json::string_view frame,
+                                             const frame_header &header)
+            {
+                if (header.t == "PRESENCE_UPDATE")
+                {
+                    if (auto self = weak.lock())
+                    {
+                        if (self->offer(frame))
+                        {
+                            return true;
+                        }
+                    }
+                }
+                return next && next(frame, header);
+            });
+        }
+
+        bool presence_coalescer::offer(boost::json::string_view frame)
+        {
+            member_key key;
+            try
+            {
+                ondemand::document doc(frame);
+                const ondemand::value d = doc.root()["d"];
+                key.guild = snowflake::from_string(d["guild_id"].get_raw_string());
+                key.user = snowflake::from_string(d["user"]["id"].get_raw_string());
+            }
+            catch (const std::exception &e)
+            {
+                BOOST_LOG_TRIVIAL(debug) << "Not coalescing PRESENCE_UPDATE: " << e.what();
+                return false;
+            }
+
+            std::lock_guard<std::mutex> g(mutex);
+            ++received;
+            auto slot = slots.insert(key, held.size());
+            if (slot.second)
+            {
+                held.emplace_back(frame.data(), frame.size());
+            }
+            else
+            {
+                held[*slot.first].assign(frame.data(), frame.size());
+                ++collapsed;
+            }
+
+            if (!window_open)
+            {
+                window_open = true;
+                timer.expires_after(window);
+                std::weak_ptr<presence_coalescer> weak = shared_from_this();
+                timer.async_wait([weak](const boost::system::error_code &ec)
+                {
+                    auto self = weak.lock();
+                    if (!ec && self)
+                    {
+                        self->flush();
+                    }
+                });
+            }
+            return true;
+        }
+
+        void presence_coalescer::flush()
+        {
+            std::vector<std::string> frames;
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                frames.swap(held);
+                slots.clear();
+                window_open = false;
+                delivered += frames.size();
+            }
+            if (!cxn)
+            {
+                return;
+            }
+            for (const std::string &frame : frames)
+            {
+                cxn->read_queue.push(message(boost::json::parse(frame), boost::none));
+            }
+        }
+
+        coalescer_stats presence_coalescer::stats() const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            return coalescer_stats{received, delivered, collapsed};
+        }
+    } // namespace gateway
+} // namespace discpp
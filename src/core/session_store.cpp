@@ -0,0 +1,179 @@
+/*! \file session_store.cpp
+ *  \brief Durable storage of gateway sessions, for resuming after a restart
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "core/session_store.hpp"
+
+namespace discpp
+{
+    namespace gateway
+    {
+        namespace
+        {
+            /*! First line of every session file; the layout that follows is
+             *  one field per line: session id, resume URL, sequence, and the
+             *  save time in milliseconds since the Unix epoch */
+            const char header[] = "discpp-session 1";
+
+            void write_all(int fd, const std::string &data, const std::string &path)
+            {
+                std::size_t done = 0;
+                while (done < data.size())
+                {
+                    const ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+                    if (n < 0)
+                    {
+                        if (errno == EINTR)
+                        {
+                            continue;
+                        }
+                        const int err = errno;
+                        ::close(fd);
+                        throw std::system_error(err, std::generic_category(), "write " + path);
+                    }
+                    done += static_cast<std::size_t>(n);
+                }
+            }
+        }
+
+        session_store::session_store(std::string directory, std::chrono::seconds max_age)
+            : directory(std::move(directory)), max_age(max_age)
+        {
+        }
+
+        std::string session_store::path_for(std::uint32_t shard) const
+        {
+            return directory + "/session-" + std::to_string(shard);
+        }
+
+        boost::optional<session_state> session_store::load(std::uint32_t shard) const
+        {
+            std::ifstream in(path_for(shard));
+            std::string line;
+            if (!std::getline(in, line) || line != header)
+            {
+                return boost::none;
+            }
+
+            session_state state;
+            std::string sequence, saved_at;
+            if (!std::getline(in, state.session_id) || !std::getline(in, state.resume_url) ||
+                    !std::getline(in, sequence) || !std::getline(in, saved_at) ||
+                    state.session_id.empty())
+            {
+                return boost::none;
+            }
+            try
+            {
+                state.sequence = std::stoll(sequence);
+                state.saved_at = std::chrono::system_clock::time_point(
+                    std::chrono::milliseconds(std::stoll(saved_at)));
+            }
+            catch (const std::exception &)
+            {
+                return boost::none;
+            }
+
+            if (std::chrono::system_clock::now() - state.saved_at > max_age)
+            {
+                return boost::none;
+            }
+            return state;
+        }
+
+        void session_store::save(std::uint32_t shard, session_state state) const
+        {
+            using namespace std::chrono;
+            state.saved_at = system_clock::now();
+
+            std::string data = header;
+            data += '\n' + state.session_id + '\n' + state.resume_url + '\n' +
+                std::to_string(state.sequence) + '\n' +
+                std::to_string(duration_cast<milliseconds>(
+                    state.saved_at.time_since_epoch()).count()) + '\n';
+
+            const std::string path = path_for(shard);
+            const std::string temp = path + ".tmp";
+            // The session id is as good as the token for hijacking the
+            // session, so keep it private
+            const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+            if (fd < 0)
+            {
+                throw std::system_error(errno, std::generic_category(), "open " + temp);
+            }
+            write_all(fd, data, temp);
+            if (::fsync(fd) != 0)
+            {
+                const int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(), "fsync " + temp);
+            }
+            ::close(fd);
+
+            if (std::rename(temp.c_str(), path.c_str()) != 0)
+            {
+                const int err = errno;
+                std::remove(temp.c_str());
+                throw std::system_error(err, std::generic_category(), "rename " + temp);
+            }
+
+            // Make the rename itself durable
+            const int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dir >= 0)
+            {
+                ::fsync(dir);
+                ::close(dir);
+            }
+        }
+
+        void session_store::clear(std::uint32_t shard) const
+        {
+            std::remove(path_for(shard).c_str());
+        }
+
+        boost::json::object resume_payload(boost::json::string_view token,
+                                           const session_state &state)
+        {
+            boost::json::object d;
+            d["token"] = token;
+            d["session_id"] = boost::json::string_view(state.session_id);
+            if (state.sequence >= 0)
+            {
+                d["seq"] = state.sequence;
+            }
+            else
+            {
+                d["seq"] = nullptr;
+            }
+
+            boost::json::object payload;
+            payload["op"] = static_cast<int>(6);
+            payload["d"] = std::move(d);
+            return payload;
+        }
+    } // namespace gateway
+} // namespace discpp
@@ -0,0 +1,526 @@
+/*! \file types.cpp
+ *  \brief Compact, lazily decoded gateway and REST object types
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core/types.hpp"
+#include "core/frame_scanner.hpp"
+#include "core/ondemand.hpp"
+
+namespace discpp
+{
+    namespace types
+    {
+        namespace detail
+        {
+            namespace json = boost::json;
+            namespace od = ::discpp::ondemand;
+
+            class dom_value
+            {
+                /*! \class dom_value
+                 *  \brief A boost::json value with the interface of an
+                 *  ondemand::value
+                 *
+                 *  Lets the typed objects decode a DOM they are built from with
+                 *  the same code that decodes their source JSON, instead of
+                 *  serializing the DOM and indexing that.
+                 */
+                public:
+                    dom_value() = default;
+                    explicit dom_value(const json::value *v) : v(v) {}
+                    explicit dom_value(const json::object &o) : o(&o) {}
+
+                    od::kind kind() const
+                    {
+                        if (o)
+                        {
+                            return od::kind::object;
+                        }
+                        if (!v)
+                        {
+                            return od::kind::absent;
+                        }
+                        switch (v->kind())
+                        {
+                            case json::kind::object: return od::kind::object;
+                            case json::kind::array:  return od::kind::array;
+                            case json::kind::string: return od::kind::string;
+                            case json::kind::bool_:  return od::kind::boolean;
+                            case json::kind::null:   return od::kind::null;
+                            default:                 return od::kind::number;
+                        }
+                    }
+                    bool exists() const { return o || v; }
+                    bool is_null() const { return kind() == od::kind::null; }
+
+                    dom_value operator[](json::string_view key) const
+                    {
+                        const json::object *obj = o ? o : (v ? v->if_object() : nullptr);
+                        return dom_value(obj ? obj->if_contains(key) : nullptr);
+                    }
+                    dom_value at(std::size_t n) const
+                    {
+                        const json::array *a = v ? v->if_array() : nullptr;
+                        return dom_value(a && n < a->size() ? &(*a)[n] : nullptr);
+                    }
+                    dom_value at_path(json::string_view path) const
+                    {
+                        dom_value d = *this;
+                        while (d.exists() && !path.empty())
+                        {
+                            const auto dot = path.find('.');
+                            d = d[path.substr(0, dot)];
+                            path = (dot == json::string_view::npos) ?
+                                json::string_view() : path.substr(dot + 1);
+                        }
+                        return d;
+                    }
+                    template <typename F>
+                    void for_each_element(F &&f) const
+                    {
+                        if (const json::array *a = v ? v->if_array() : nullptr)
+                        {
+                            for (const json::value &e : *a)
+                            {
+                                f(dom_value(&e));
+                            }
+                        }
+                    }
+
+                    /*! The string, already unescaped by the parser */
+                    json::string_view get_raw_string() const
+                    {
+                        return v->get_string();
+                    }
+                    std::uint64_t get_uint64() const
+                    {
+                        return v->is_uint64() ? v->get_uint64() : static_cast<std::uint64_t>(get_int64());
+                    }
+                    std::int64_t get_int64() const
+                    {
+                        return v->is_int64() ? v->get_int64() :
+                               v->is_uint64() ? static_cast<std::int64_t>(v->get_uint64()) :
+                               static_cast<std::int64_t>(v->get_double());
+                    }
+                    bool get_bool() const { return v->get_bool(); }
+
+                private:
+                    const json::value *v = nullptr;
+                    /*! Set instead of #v for the object a type is built from */
+                    const json::object *o = nullptr;
+            };
+        } // namespace detail
+
+        namespace
+        {
+            namespace od = ::discpp::ondemand;
+            using detail::dom_value;
+
+            /*! Reads an unsigned integer sent either as a number or as a
+             *  string of digits (ids, permission bitsets); 0 if absent */
+            template <typename Value>
+            std::uint64_t uint_of(const Value &v)
+            {
+                switch (v.kind())
+                {
+                    case od::kind::number:
+                        return v.get_uint64();
+                    case od::kind::string:
+                    {
+                        std::uint64_t n = 0;
+                        for (char c : v.get_raw_string())
+                        {
+                            if (c < '0' || c > '9')
+                            {
+                                return 0;
+                            }
+                            n = n * 10 + static_cast<std::uint64_t>(c - '0');
+                        }
+                        return n;
+                    }
+                    default:
+                        return 0;
+                }
+            }
+
+            template <typename Value>
+            snowflake id_of(const Value &v)
+            {
+                return snowflake(uint_of(v));
+            }
+
+            template <typename Value>
+            std::int64_t int_of(const Value &v)
+            {
+                return v.kind() == od::kind::number ? v.get_int64() : 0;
+            }
+
+            template <typename Value>
+            bool present(const Value &v)
+            {
+                return v.exists() && !v.is_null();
+            }
+
+            template <typename Value>
+            bool truthy(const Value &v)
+            {
+                return v.kind() == od::kind::boolean && v.get_bool();
+            }
+
+            template <typename Value>
+            bool non_empty(const Value &v)
+            {
+                return v.kind() == od::kind::array && v.at(0).exists();
+            }
+
+            /*! Prefers the v6 `*_new` string variant of a permission field */
+            template <typename Value>
+            std::uint64_t permissions_of(const Value &obj, boost::json::string_view key)
+            {
+                const std::string wide = std::string(key.data(), key.size()) + "_new";
+                const Value v = obj[wide];
+                return v.exists() ? uint_of(v) : uint_of(obj[key]);
+            }
+
+            template <typename Field>
+            std::uint32_t bit(Field f, bool set)
+            {
+                return set ? static_cast<std::uint32_t>(f) : 0;
+            }
+        } // anonymous namespace
+
+        constexpr std::uint32_t text_ref::unescaped;
+
+        boost::json::object lazy_object::json() const
+        {
+            boost::json::value v = boost::json::parse(_source);
+            return std::move(v.as_object());
+        }
+
+        std::size_t lazy_object::footprint() const
+        {
+            return _source.capacity() + _text.capacity() + _extra_bytes;
+        }
+
+        boost::json::string_view lazy_object::text(text_ref t) const
+        {
+            const std::string &in = (t.size & text_ref::unescaped) ? _text : _source;
+            return boost::json::string_view(in.data() + t.offset, t.size & ~text_ref::unescaped);
+        }
+
+        text_ref lazy_object::keep_text(const od::value &v)
+        {
+            if (v.kind() != od::kind::string)
+            {
+                return text_ref();
+            }
+            const boost::json::string_view raw = v.get_raw_string();
+            if (raw.find('\\') == boost::json::string_view::npos)
+            {
+                // Nothing to unescape, so the source already holds the text
+                return text_ref{static_cast<std::uint32_t>(raw.data() - _source.data()),
+                                static_cast<std::uint32_t>(raw.size())};
+            }
+            const std::string decoded = v.get_string();
+            const text_ref t{static_cast<std::uint32_t>(_text.size()),
+                             static_cast<std::uint32_t>(decoded.size()) | text_ref::unescaped};
+            _text += decoded;
+            return t;
+        }
+
+        text_ref lazy_object::keep_text(const dom_value &v)
+        {
+            if (v.kind() != od::kind::string)
+            {
+                return text_ref();
+            }
+            // The DOM doesn't say where in the serialized source its strings
+            // ended up, so keep a copy
+            const boost::json::string_view decoded = v.get_raw_string();
+            const text_ref t{static_cast<std::uint32_t>(_text.size()),
+                             static_cast<std::uint32_t>(decoded.size()) | text_ref::unescaped};
+            _text.append(decoded.data(), decoded.size());
+            return t;
+        }
+
+        user::user(std::string json) : lazy_object(std::move(json))
+        {
+            od::document doc(_source);
+            decode(doc.root());
+        }
+
+        user::user(const boost::json::object &obj) : lazy_object(boost::json::serialize(obj))
+        {
+            decode(dom_value(obj));
+        }
+
+        template <typename Value>
+        void user::decode(const Value &root)
+        {
+            _id = id_of(root["id"]);
+            _username = keep_text(root["username"]);
+            _global_name = keep_text(root["global_name"]);
+            _avatar = keep_text(root["avatar"]);
+            _text.shrink_to_fit();
+            _present = bit(field::avatar, present(root["avatar"])) |
+                       bit(field::global_name, present(root["global_name"])) |
+                       bit(field::bot, truthy(root["bot"])) |
+                       bit(field::system, truthy(root["system"]));
+        }
+
+        guild_member::guild_member(std::string json, snowflake guild_id)
+            : lazy_object(std::move(json)), _guild_id(guild_id)
+        {
+            od::document doc(_source);
+            decode(doc.root());
+        }
+
+        guild_member::guild_member(const boost::json::object &obj, snowflake guild_id)
+            : lazy_object(boost::json::serialize(obj)), _guild_id(guild_id)
+        {
+            decode(dom_value(obj));
+        }
+
+        template <typename Value>
+        void guild_member::decode(const Value &root)
+        {
+            _user_id = id_of(root.at_path("user.id"));
+            if (!_guild_id)
+            {
+                _guild_id = id_of(root["guild_id"]);
+            }
+            const Value roles = root["roles"];
+            if (roles.kind() == od::kind::array)
+            {
+                roles.for_each_element([this](const Value &r)
+                {
+                    _roles.push_back(id_of(r));
+                });
+            }
+            _roles.shrink_to_fit();
+            _extra_bytes = _roles.capacity() * sizeof(snowflake);
+
+            _nick = keep_text(root["nick"]);
+            _joined_at = keep_text(root["joined_at"]);
+            _text.shrink_to_fit();
+            _present = bit(field::user, present(root["user"])) |
+                       bit(field::nick, present(root["nick"])) |
+                       bit(field::avatar, present(root["avatar"])) |
+                       bit(field::premium_since, present(root["premium_since"])) |
+                       bit(field::pending, truthy(root["pending"])) |
+                       bit(field::timed_out, present(root["communication_disabled_until"])) |
+                       bit(field::deaf, truthy(root["deaf"])) |
+                       bit(field::mute, truthy(root["mute"]));
+        }
+
+        types::user guild_member::user() const
+        {
+            boost::json::string_view raw;
+            if (!gateway::peek_member(_source, "user", raw))
+            {
+                return types::user();
+            }
+            return types::user(std::string(raw.data(), raw.size()));
+        }
+
+        role::role(std::string json, snowflake guild_id)
+            : lazy_object(std::move(json)), _guild_id(guild_id)
+        {
+            od::document doc(_source);
+            decode(doc.root());
+        }
+
+        role::role(const boost::json::object &obj, snowflake guild_id)
+            : lazy_object(boost::json::serialize(obj)), _guild_id(guild_id)
+        {
+            decode(dom_value(obj));
+        }
+
+        template <typename Value>
+        void role::decode(const Value &root)
+        {
+            _id = id_of(root["id"]);
+            if (!_guild_id)
+            {
+                _guild_id = id_of(root["guild_id"]);
+            }
+            _name = keep_text(root["name"]);
+            _text.shrink_to_fit();
+            _permissions = permissions_of(root, "permissions");
+            _position = static_cast<std::int32_t>(int_of(root["position"]));
+            _color = static_cast<std::uint32_t>(uint_of(root["color"]));
+            _present = bit(field::hoist, truthy(root["hoist"])) |
+                       bit(field::managed, truthy(root["managed"])) |
+                       bit(field::mentionable, truthy(root["mentionable"])) |
+                       bit(field::icon, present(root["icon"])) |
+                       bit(field::tags, present(root["tags"]));
+        }
+
+        channel::channel(std::string json, snowflake guild_id)
+            : lazy_object(std::move(json)), _guild_id(guild_id)
+        {
+            od::document doc(_source);
+            decode(doc.root());
+        }
+
+        channel::channel(const boost::json::object &obj, snowflake guild_id)
+            : lazy_object(boost::json::serialize(obj)), _guild_id(guild_id)
+        {
+            decode(dom_value(obj));
+        }
+
+        template <typename Value>
+        void channel::decode(const Value &root)
+        {
+            _id = id_of(root["id"]);
+            if (!_guild_id)
+            {
+                _guild_id = id_of(root["guild_id"]);
+            }
+            _parent_id = id_of(root["parent_id"]);
+            _type = static_cast<std::uint8_t>(uint_of(root["type"]));
+            _position = static_cast<std::int32_t>(int_of(root["position"]));
+
+            const Value overwrites = root["permission_overwrites"];
+            if (overwrites.kind() == od::kind::array)
+            {
+                overwrites.for_each_element([this](const Value &o)
+                {
+                    // API v6 sends the type as "role"/"member", later versions
+                    // as 0/1
+                    const Value type = o["type"];
+                    const bool member = (type.kind() == od::kind::string) ?
+                        type.get_raw_string() == "member" : uint_of(type) == 1;
+                    _overwrites.push_back(overwrite{
+                        id_of(o["id"]),
+                        member ? overwrite::target::member : overwrite::target::role,
+                        permissions_of(o, "allow"),
+                        permissions_of(o, "deny")});
+                });
+            }
+            _overwrites.shrink_to_fit();
+            _extra_bytes = _overwrites.capacity() * sizeof(overwrite);
+
+            _name = keep_text(root["name"]);
+            _topic = keep_text(root["topic"]);
+            _text.shrink_to_fit();
+            _present = bit(field::guild_id, static_cast<bool>(_guild_id)) |
+                       bit(field::parent_id, present(root["parent_id"])) |
+                       bit(field::topic, present(root["topic"])) |
+                       bit(field::last_message_id, present(root["last_message_id"])) |
+                       bit(field::nsfw, truthy(root["nsfw"])) |
+                       bit(field::recipients, present(root["recipients"]));
+        }
+
+        emoji::emoji(std::string json, snowflake guild_id)
+            : lazy_object(std::move(json)), _guild_id(guild_id)
+        {
+            od::document doc(_source);
+            decode(doc.root());
+        }
+
+        emoji::emoji(const boost::json::object &obj, snowflake guild_id)
+            : lazy_object(boost::json::serialize(obj)), _guild_id(guild_id)
+        {
+            decode(dom_value(obj));
+        }
+
+        template <typename Value>
+        void emoji::decode(const Value &root)
+        {
+            _id = id_of(root["id"]);
+            _name = keep_text(root["name"]);
+            _text.shrink_to_fit();
+            _present = bit(field::custom, static_cast<bool>(_id)) |
+                       bit(field::animated, truthy(root["animated"])) |
+                       bit(field::managed, truthy(root["managed"]));
+        }
+
+        guild::guild(std::string json) : lazy_object(std::move(json))
+        {
+            od::document doc(_source);
+            decode(doc.root());
+        }
+
+        guild::guild(const boost::json::object &obj) : lazy_object(boost::json::serialize(obj))
+        {
+            decode(dom_value(obj));
+        }
+
+        template <typename Value>
+        void guild::decode(const Value &root)
+        {
+            _id = id_of(root["id"]);
+            _owner_id = id_of(root["owner_id"]);
+            _member_count = static_cast<std::uint32_t>(uint_of(root["member_count"]));
+            _name = keep_text(root["name"]);
+            _icon = keep_text(root["icon"]);
+            _text.shrink_to_fit();
+            _present = bit(field::icon, present(root["icon"])) |
+                       bit(field::unavailable, truthy(root["unavailable"])) |
+                       bit(field::large, truthy(root["large"])) |
+                       bit(field::member_count, present(root["member_count"]));
+        }
+
+        message::message(std::string json) : lazy_object(std::move(json))
+        {
+            od::document doc(_source);
+            decode(doc.root());
+        }
+
+        message::message(const boost::json::object &obj) : lazy_object(boost::json::serialize(obj))
+        {
+            decode(dom_value(obj));
+        }
+
+        template <typename Value>
+        void message::decode(const Value &root)
+        {
+            _id = id_of(root["id"]);
+            _channel_id = id_of(root["channel_id"]);
+            _guild_id = id_of(root["guild_id"]);
+            _author_id = id_of(root.at_path("author.id"));
+            _type = static_cast<std::uint8_t>(uint_of(root["type"]));
+            _content = keep_text(root["content"]);
+            _timestamp = keep_text(root["timestamp"]);
+            _edited_timestamp = keep_text(root["edited_timestamp"]);
+            _text.shrink_to_fit();
+            _present = bit(field::guild_id, present(root["guild_id"])) |
+                       bit(field::edited_timestamp, present(root["edited_timestamp"])) |
+                       bit(field::member, present(root["member"])) |
+                       bit(field::webhook_id, present(root["webhook_id"])) |
+                       bit(field::referenced_message, present(root["referenced_message"])) |
+                       bit(field::attachments, non_empty(root["attachments"])) |
+                       bit(field::embeds, non_empty(root["embeds"])) |
+                       bit(field::pinned, truthy(root["pinned"])) |
+                       bit(field::tts, truthy(root["tts"])) |
+                       bit(field::mention_everyone, truthy(root["mention_everyone"]));
+        }
+
+        types::user message::author() const
+        {
+            boost::json::string_view raw;
+            if (!gateway::peek_member(_source, "author", raw))
+            {
+                return types::user();
+            }
+            return types::user(std::string(raw.data(), raw.size()));
+        }
+    } // namespace types
+} // namespace discpp
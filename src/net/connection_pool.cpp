@@ -0,0 +1,98 @@
+/*! \file connection_pool.cpp
+ *  \brief Keeps HTTPS connections to a host open between requests
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "net/connection_pool.hpp"
+#include "net/http.hpp"
+
+namespace discpp
+{
+    namespace http
+    {
+        connection_pool::lease::lease(connection_pool *pool, std::unique_ptr<stream> conn, bool reused)
+            : pool(pool), conn(std::move(conn)), _reused(reused)
+        {
+        }
+
+        connection_pool::lease::lease(lease &&other) noexcept
+            : pool(other.pool), conn(std::move(other.conn)), _reused(other._reused)
+        {
+        }
+
+        connection_pool::lease &connection_pool::lease::operator=(lease &&other) noexcept
+        {
+            pool = other.pool;
+            conn = std::move(other.conn);
+            _reused = other._reused;
+            return *this;
+        }
+
+        void connection_pool::lease::release()
+        {
+            if (conn)
+            {
+                pool->give_back(std::move(conn));
+            }
+        }
+
+        connection_pool::connection_pool(boost::asio::ssl::context &ssl,
+                                         std::string host,
+                                         std::string port,
+                                         std::size_t max_idle)
+            : ssl(ssl), _host(std::move(host)), _port(std::move(port)), max_idle(max_idle)
+        {
+        }
+
+        connection_pool::lease connection_pool::acquire()
+        {
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                if (!idle.empty())
+                {
+                    std::unique_ptr<stream> conn = std::move(idle.back());
+                    idle.pop_back();
+                    return lease(this, std::move(conn), true);
+                }
+            }
+            return connect();
+        }
+
+        connection_pool::lease connection_pool::connect()
+        {
+            std::unique_ptr<stream> conn(new stream(
+                create_https_stream<stream, connection_pool>(*this, _host, _port)));
+            return lease(this, std::move(conn), false);
+        }
+
+        void connection_pool::clear()
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            idle.clear();
+        }
+
+        void connection_pool::give_back(std::unique_ptr<stream> conn)
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            if (idle.size() < max_idle)
+            {
+                idle.push_back(std::move(conn));
+            }
+        }
+    } // namespace http
+} // namespace discpp
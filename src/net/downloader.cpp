@@ -0,0 +1,428 @@
+/*! \file downloader.cpp
+ *  \brief Downloads attachments and other CDN files in parallel ranges
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/beast/http.hpp>
+#include <boost/beast/version.hpp>
+
+#include "net/downloader.hpp"
+
+namespace discpp
+{
+    namespace http
+    {
+        struct downloader::file_state
+        {
+            std::string path;
+            int fd = -1;
+            std::string host;
+            std::string port;
+            std::string resource;
+
+            std::mutex mutex;
+            /*! Tasks queued or running for the file */
+            std::size_t outstanding = 1;
+            std::uint64_t written = 0;
+            std::exception_ptr error;
+            std::promise<std::uint64_t> done;
+
+            bool failed()
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                return static_cast<bool>(error);
+            }
+        };
+
+        namespace
+        {
+            namespace bhttp = boost::beast::http;
+
+            /*! Size of the buffer each connection reads bodies through */
+            constexpr std::size_t read_buffer = 64 * 1024;
+
+            void write_at(int fd, const char *data, std::size_t size, std::uint64_t offset,
+                          const std::string &path)
+            {
+                while (size > 0)
+                {
+                    const ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+                    if (n < 0)
+                    {
+                        if (errno == EINTR)
+                        {
+                            continue;
+                        }
+                        throw std::system_error(errno, std::generic_category(), "pwrite " + path);
+                    }
+                    data += n;
+                    size -= static_cast<std::size_t>(n);
+                    offset += static_cast<std::uint64_t>(n);
+                }
+            }
+
+            void preallocate(int fd, std::uint64_t size, const std::string &path)
+            {
+                const int err = ::posix_fallocate(fd, 0, static_cast<off_t>(size));
+                // Not every filesystem can reserve blocks; a plain resize
+                // still spares every chunk from growing the file
+                if (err != 0 && (err != EINVAL && err != EOPNOTSUPP))
+                {
+                    throw std::system_error(err, std::generic_category(), "fallocate " + path);
+                }
+                if (err != 0 && ::ftruncate(fd, static_cast<off_t>(size)) != 0)
+                {
+                    throw std::system_error(errno, std::generic_category(), "ftruncate " + path);
+                }
+            }
+
+            /*! The full length from a `bytes first-last/length` header */
+            std::uint64_t range_total(boost::beast::string_view content_range)
+            {
+                const std::size_t slash = content_range.find('/');
+                if (slash == boost::beast::string_view::npos || slash + 1 >= content_range.size())
+                {
+                    throw std::runtime_error("Malformed Content-Range header");
+                }
+                const std::string total(content_range.substr(slash + 1));
+                char *end = nullptr;
+                const unsigned long long n = std::strtoull(total.c_str(), &end, 10);
+                if (end == total.c_str() || *end != '\0')
+                {
+                    throw std::runtime_error("Content-Range without a known length");
+                }
+                return n;
+            }
+        }
+
+        downloader::downloader(boost::asio::ssl::context &ssl, download_limits limits)
+            : ssl(ssl), limits(limits)
+        {
+            const std::size_t n = std::max<std::size_t>(limits.max_connections, 1);
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                workers.emplace_back(&downloader::run, this);
+            }
+        }
+
+        downloader::~downloader()
+        {
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                stopping = true;
+            }
+            wakeup.notify_all();
+            for (std::thread &t : workers)
+            {
+                t.join();
+            }
+
+            for (const task &t : tasks)
+            {
+                finish(t.file, std::make_exception_ptr(
+                    std::runtime_error("downloader destroyed before the download finished")));
+            }
+        }
+
+        std::future<std::uint64_t> downloader::download(const boost::json::object &attachment,
+                                                        std::string path)
+        {
+            const boost::json::value *url = attachment.if_contains("url");
+            if (!url || !url->is_string())
+            {
+                throw std::invalid_argument("Attachment without a url");
+            }
+            const boost::json::string_view u = url->get_string();
+            return download(std::string(u.data(), u.size()), std::move(path));
+        }
+
+        std::future<std::uint64_t> downloader::download(const std::string &url, std::string path)
+        {
+            const std::string scheme = "https://";
+            if (url.compare(0, scheme.size(), scheme) != 0)
+            {
+                throw std::invalid_argument("Not an https URL: " + url);
+            }
+
+            std::shared_ptr<file_state> file = std::make_shared<file_state>();
+            const std::size_t slash = url.find('/', scheme.size());
+            const std::string authority = url.substr(scheme.size(), slash - scheme.size());
+            const std::size_t colon = authority.rfind(':');
+            file->host = authority.substr(0, colon);
+            file->port = colon == std::string::npos ? "443" : authority.substr(colon + 1);
+            file->resource = slash == std::string::npos ? "/" : url.substr(slash);
+            if (file->host.empty())
+            {
+                throw std::invalid_argument("URL without a host: " + url);
+            }
+
+            file->path = std::move(path);
+            file->fd = ::open(file->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (file->fd < 0)
+            {
+                throw std::system_error(errno, std::generic_category(), "open " + file->path);
+            }
+
+            std::future<std::uint64_t> result = file->done.get_future();
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                tasks.push_back(task{file, 0, 0});
+            }
+            wakeup.notify_one();
+            return result;
+        }
+
+        void downloader::run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                wakeup.wait(lock, [this]
+                {
+                    return stopping || !tasks.empty();
+                });
+                if (stopping)
+                {
+                    return;
+                }
+
+                const task t = tasks.front();
+                tasks.pop_front();
+                lock.unlock();
+                fetch(t);
+                lock.lock();
+            }
+        }
+
+        void downloader::fetch(const task &t)
+        {
+            // Another chunk already failed the download
+            if (t.file->failed())
+            {
+                finish(t.file, nullptr);
+                return;
+            }
+
+            try
+            {
+                connection_pool &pool = pool_for(t.file->host, t.file->port);
+                // A pooled connection the server has since closed fails
+                // before anything is read. The other idle ones may be just as
+                // stale, so the retry goes out on a new connection
+                if (!transfer(t, pool.acquire()))
+                {
+                    transfer(t, pool.connect());
+                }
+                finish(t.file, nullptr);
+            }
+            catch (...)
+            {
+                finish(t.file, std::current_exception());
+            }
+        }
+
+        bool downloader::transfer(const task &t, connection_pool::lease conn)
+        {
+            file_state &file = *t.file;
+
+            const std::uint64_t length = t.length ? t.length : limits.chunk_size;
+            bhttp::request<bhttp::empty_body> request(bhttp::verb::get, file.resource, 11);
+            request.set(bhttp::field::host, file.host);
+            request.set(bhttp::field::user_agent, BOOST_BEAST_VERSION_STRING);
+            request.set(bhttp::field::range, "bytes=" + std::to_string(t.offset) + "-" +
+                                             std::to_string(t.offset + length - 1));
+            request.keep_alive(true);
+
+            boost::beast::error_code err;
+            boost::beast::flat_buffer buf;
+            bhttp::response_parser<bhttp::buffer_body> parser;
+            parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+
+            bhttp::write(*conn, request, err);
+            if (!err)
+            {
+                bhttp::read_header(*conn, buf, parser, err);
+            }
+            if (err)
+            {
+                if (conn.reused())
+                {
+                    return false;
+                }
+                throw boost::beast::system_error{err};
+            }
+
+            const auto &header = parser.get();
+            std::uint64_t expected = std::numeric_limits<std::uint64_t>::max();
+            if (header.result() == bhttp::status::partial_content)
+            {
+                if (!t.length)
+                {
+                    // First response: now the size is known, so lay out the
+                    // file and let other connections take the rest
+                    const std::uint64_t total = range_total(header[bhttp::field::content_range]);
+                    preallocate(file.fd, total, file.path);
+
+                    std::vector<task> rest;
+                    for (std::uint64_t at = length; at < total; at += limits.chunk_size)
+                    {
+                        rest.push_back(task{t.file, at, std::min<std::uint64_t>(limits.chunk_size, total - at)});
+                    }
+                    if (!rest.empty())
+                    {
+                        {
+                            std::lock_guard<std::mutex> g(file.mutex);
+                            file.outstanding += rest.size();
+                        }
+                        {
+                            std::lock_guard<std::mutex> g(mutex);
+                            tasks.insert(tasks.end(), rest.begin(), rest.end());
+                        }
+                        wakeup.notify_all();
+                    }
+                    expected = std::min(length, total);
+                }
+                else
+                {
+                    expected = t.length;
+                }
+            }
+            else if (header.result() == bhttp::status::ok && !t.length)
+            {
+                // No ranges here; the whole file comes in this response
+                if (const auto size = parser.content_length())
+                {
+                    preallocate(file.fd, *size, file.path);
+                }
+            }
+            else
+            {
+                throw std::runtime_error("GET " + file.host + file.resource + " answered " +
+                                         std::to_string(header.result_int()));
+            }
+
+            char chunk[read_buffer];
+            std::uint64_t offset = t.offset;
+            while (!parser.is_done())
+            {
+                parser.get().body().data = chunk;
+                parser.get().body().size = sizeof chunk;
+                bhttp::read(*conn, buf, parser, err);
+                if (err == bhttp::error::need_buffer)
+                {
+                    err = {};
+                }
+                if (err)
+                {
+                    throw boost::beast::system_error{err};
+                }
+
+                const std::size_t n = sizeof chunk - parser.get().body().size;
+                write_at(file.fd, chunk, n, offset, file.path);
+                offset += n;
+                {
+                    std::lock_guard<std::mutex> g(file.mutex);
+                    file.written += n;
+                }
+                throttle(n);
+            }
+
+            if (expected != std::numeric_limits<std::uint64_t>::max() && offset - t.offset != expected)
+            {
+                throw std::runtime_error("Short range from " + file.host + file.resource);
+            }
+            if (parser.keep_alive())
+            {
+                conn.release();
+            }
+            return true;
+        }
+
+        void downloader::finish(const std::shared_ptr<file_state> &file, std::exception_ptr error)
+        {
+            {
+                std::lock_guard<std::mutex> g(file->mutex);
+                if (error && !file->error)
+                {
+                    file->error = error;
+                }
+                if (--file->outstanding > 0)
+                {
+                    return;
+                }
+            }
+
+            ::close(file->fd);
+            file->fd = -1;
+            if (file->error)
+            {
+                ::unlink(file->path.c_str());
+                file->done.set_exception(file->error);
+            }
+            else
+            {
+                file->done.set_value(file->written);
+            }
+        }
+
+        void downloader::throttle(std::uint64_t bytes)
+        {
+            if (!limits.max_bytes_per_second)
+            {
+                return;
+            }
+
+            using namespace std::chrono;
+            const auto cost = duration_cast<steady_clock::duration>(
+                duration<double>(static_cast<double>(bytes) / limits.max_bytes_per_second));
+            const auto now = steady_clock::now();
+            steady_clock::time_point until;
+            {
+                std::lock_guard<std::mutex> g(throttle_mutex);
+                // Time left unused is only banked for up to a second
+                next_free = std::max(next_free, now - seconds(1)) + cost;
+                until = next_free;
+            }
+            if (until > now)
+            {
+                std::this_thread::sleep_until(until);
+            }
+        }
+
+        connection_pool &downloader::pool_for(const std::string &host, const std::string &port)
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            std::unique_ptr<connection_pool> &pool = pools[host + ":" + port];
+            if (!pool)
+            {
+                pool.reset(new connection_pool(ssl, host, port, limits.max_connections));
+            }
+            return *pool;
+        }
+    } // namespace http
+} // namespace discpp
@@ -18,43 +18,115 @@
  *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "net/http.hpp"
 
 namespace discpp
 {
     namespace http
     {
-        void url_encode(std::string &substring)
+        namespace
+        {
+            /*! Whether RFC 3986 lets `c` appear in a URL as is */
+            inline bool unreserved(unsigned char c)
+            {
+                return (c >= '0' && c <= '9') ||
+                       (c >= 'A' && c <= 'Z') ||
+                       (c >= 'a' && c <= 'z') ||
+                       c == '-' || c == '.' || c == '_' || c == '~';
+            }
+
+#if defined(__SSE2__)
+            /*! Length of the run of unreserved bytes at the start of
+             *  [first, last), checked 16 bytes at a time */
+            std::size_t unreserved_prefix(const char *first, const char *last)
+            {
+                const char *p = first;
+                // Signed compares treat bytes >= 0x80 as negative, so they
+                // fall outside every range below, as they should
+                const __m128i below_0 = _mm_set1_epi8('0' - 1), above_9 = _mm_set1_epi8('9' + 1);
+                const __m128i below_A = _mm_set1_epi8('A' - 1), above_Z = _mm_set1_epi8('Z' + 1);
+                const __m128i below_a = _mm_set1_epi8('a' - 1), above_z = _mm_set1_epi8('z' + 1);
+                const __m128i dash = _mm_set1_epi8('-'), dot = _mm_set1_epi8('.');
+                const __m128i underscore = _mm_set1_epi8('_'), tilde = _mm_set1_epi8('~');
+
+                while (last - p >= 16)
+                {
+                    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                    __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, below_0), _mm_cmplt_epi8(v, above_9));
+                    ok = _mm_or_si128(ok, _mm_and_si128(_mm_cmpgt_epi8(v, below_A), _mm_cmplt_epi8(v, above_Z)));
+                    ok = _mm_or_si128(ok, _mm_and_si128(_mm_cmpgt_epi8(v, below_a), _mm_cmplt_epi8(v, above_z)));
+                    ok = _mm_or_si128(ok, _mm_or_si128(_mm_cmpeq_epi8(v, dash), _mm_cmpeq_epi8(v, dot)));
+                    ok = _mm_or_si128(ok, _mm_or_si128(_mm_cmpeq_epi8(v, underscore), _mm_cmpeq_epi8(v, tilde)));
+
+                    const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(ok));
+                    if (mask != 0xFFFF)
+                    {
+                        // Stop at the first byte that needs escaping
+                        return static_cast<std::size_t>(p - first) + __builtin_ctz(~mask);
+                    }
+                    p += 16;
+                }
+                while (p != last && unreserved(static_cast<unsigned char>(*p)))
+                {
+                    ++p;
+                }
+                return static_cast<std::size_t>(p - first);
+            }
+#else
+            std::size_t unreserved_prefix(const char *first, const char *last)
+            {
+                const char *p = first;
+                while (p != last && unreserved(static_cast<unsigned char>(*p)))
+                {
+                    ++p;
+                }
+                return static_cast<std::size_t>(p - first);
+            }
+#endif
+        }
+
+        char *url_encode(boost::json::string_view s, char *o)
         {
-            char const hex_chars[16] = {'0','1','2','3',
-                                        '4','5','6','7',
-                                        '8','9','A','B',
-                                        'C','D','E','F'};
+            static const char hex_chars[] = "0123456789ABCDEF";
 
-            for (auto i = substring.begin(); i != substring.end(); i++)
+            // Written through a pointer into room for the worst case; a
+            // per-byte append would check capacity every time
+            const char *p = s.data();
+            const char *const last = p + s.size();
+            while (p != last)
             {
-                std::string ins;
-                // TODO: see if we can tidy this up (in a meaningful way)
-                // This should be rather efficient; let's assume most of
-                // any string we're given is unreserved; then, we'll likely
-                // fail one of these individual AND predicates and short-circuit
-                // evaluate.
-                if (
-                    (*i < '0' || *i > '9') &&
-                    (*i < 'A' || *i > 'Z') &&
-                    (*i < 'a' || *i > 'z') &&
-                    (*i != '~')            &&
-                    (*i != '-')            &&
-                    (*i != '_')            &&
-                    (*i != '.')
-                   )
+                // Copy the unreserved run in one go, then escape the run of
+                // bytes after it; UTF-8 characters come as several at once
+                const std::size_t run = unreserved_prefix(p, last);
+                std::memcpy(o, p, run);
+                o += run;
+                p += run;
+
+                while (p != last && !unreserved(static_cast<unsigned char>(*p)))
                 {
-                    ins += "%";
-                    ins += hex_chars[(*i & 0xF0) >> 4];
-                    ins += hex_chars[(*i & 0x0F)];
-                    substring.replace(i, i+1, ins);
+                    const unsigned char c = static_cast<unsigned char>(*p++);
+                    o[0] = '%';
+                    o[1] = hex_chars[c >> 4];
+                    o[2] = hex_chars[c & 0x0F];
+                    o += 3;
                 }
             }
+            return o;
+        }
+
+        std::string url_encode(boost::json::string_view s)
+        {
+            // Cut to length afterwards. Encoded strings are emoji and short
+            // queries, so the transient 3x is small.
+            std::string out(3 * s.size(), '\0');
+            out.resize(static_cast<std::size_t>(url_encode(s, &out[0]) - out.data()));
+            return out;
         }
     }
 }
@@ -0,0 +1,176 @@
+/*! \file multipart.cpp
+ *  \brief multipart/form-data request bodies that don't copy their files
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <random>
+
+#include "net/multipart.hpp"
+
+namespace discpp
+{
+    namespace http
+    {
+        namespace
+        {
+            const char crlf[] = "\r\n";
+
+            /*! Makes `s` safe inside a quoted header parameter, the way
+             *  browsers do */
+            std::string quote(const std::string &s)
+            {
+                std::string out = "\"";
+                for (char c : s)
+                {
+                    switch (c)
+                    {
+                        case '"':  out += "%22"; break;
+                        case '\r': out += "%0D"; break;
+                        case '\n': out += "%0A"; break;
+                        default:   out += c;     break;
+                    }
+                }
+                return out + '"';
+            }
+
+            /*! Drops CR and LF from a header value, so it can't end the
+             *  header early and smuggle in headers of its own */
+            std::string header_value(const std::string &s)
+            {
+                std::string out;
+                out.reserve(s.size());
+                for (char c : s)
+                {
+                    if (c != '\r' && c != '\n')
+                    {
+                        out += c;
+                    }
+                }
+                return out;
+            }
+        }
+
+        multipart_form::multipart_form()
+        {
+            static const char hex[] = "0123456789abcdef";
+            std::random_device rd;
+            _boundary = "discpp-";
+            for (int i = 0; i < 4; ++i)
+            {
+                std::uint32_t r = rd();
+                for (int j = 0; j < 8; ++j, r >>= 4)
+                {
+                    _boundary += hex[r & 0xF];
+                }
+            }
+            tail = "--" + _boundary + "--" + crlf;
+        }
+
+        void multipart_form::add_field(std::string name, std::string value, std::string content_type)
+        {
+            part p;
+            p.value = std::move(value);
+            add_part(std::move(name), nullptr, std::move(content_type), std::move(p));
+        }
+
+        void multipart_form::add_file(std::string name,
+                                      std::string filename,
+                                      std::shared_ptr<const mapped_file> file,
+                                      std::string content_type)
+        {
+            part p;
+            p.file = std::move(file);
+            add_part(std::move(name), &filename, std::move(content_type), std::move(p));
+        }
+
+        void multipart_form::add_file(std::string name,
+                                      std::string filename,
+                                      const std::string &path,
+                                      std::string content_type)
+        {
+            add_file(std::move(name), std::move(filename),
+                     std::make_shared<const mapped_file>(path, mapped_file::access_hint::sequential),
+                     std::move(content_type));
+        }
+
+        void multipart_form::add_part(std::string name,
+                                      const std::string *filename,
+                                      std::string content_type,
+                                      part p)
+        {
+            p.head = "--" + _boundary + crlf +
+                "Content-Disposition: form-data; name=" + quote(name);
+            if (filename)
+            {
+                p.head += "; filename=" + quote(*filename);
+            }
+            p.head += crlf;
+            if (!content_type.empty())
+            {
+                p.head += "Content-Type: " + header_value(content_type) + crlf;
+            }
+            p.head += crlf;
+            parts.push_back(std::move(p));
+        }
+
+        std::string multipart_form::content_type() const
+        {
+            return "multipart/form-data; boundary=" + _boundary;
+        }
+
+        std::uint64_t multipart_form::size() const
+        {
+            std::uint64_t n = tail.size();
+            for (const part &p : parts)
+            {
+                n += p.head.size() + p.value.size() + (sizeof crlf - 1);
+                if (p.file)
+                {
+                    n += p.file->size();
+                }
+                for (const boost::asio::const_buffer &b : p.data)
+                {
+                    n += b.size();
+                }
+            }
+            return n;
+        }
+
+        std::vector<boost::asio::const_buffer> multipart_form::buffers() const
+        {
+            std::vector<boost::asio::const_buffer> out;
+            out.reserve(3 * parts.size() + 1);
+            for (const part &p : parts)
+            {
+                out.emplace_back(p.head.data(), p.head.size());
+                if (!p.value.empty())
+                {
+                    out.emplace_back(p.value.data(), p.value.size());
+                }
+                if (p.file && p.file->size() > 0)
+                {
+                    out.emplace_back(p.file->data(), p.file->size());
+                }
+                out.insert(out.end(), p.data.begin(), p.data.end());
+                out.emplace_back(crlf, sizeof crlf - 1);
+            }
+            out.emplace_back(tail.data(), tail.size());
+            return out;
+        }
+    } // namespace http
+} // namespace discpp
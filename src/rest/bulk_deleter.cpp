@@ -0,0 +1,299 @@
+/*! \file bulk_deleter.cpp
+ *  \brief Gathers single message deletions into bulk-delete requests
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iterator>
+
+#include "core/dis.hpp"
+#include "rest/rest.hpp"
+#include "rest/bulk_deleter.hpp"
+#include "rest/route.hpp"
+#include "net/http.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        namespace
+        {
+            /*! Sends a request, again after waiting as long as the API asks
+             *  for as often as it refuses it with 429, and returns the status
+             *  it finally answers with */
+            template <class Send>
+            unsigned int until_accepted(rate_limit &bucket, Send send)
+            {
+                while (true)
+                {
+                    std::this_thread::sleep_until(bucket.ready_at());
+                    auto response = send();
+                    bucket.update(response);
+                    if (response.result_int() != 429)
+                    {
+                        return response.result_int();
+                    }
+                }
+            }
+        }
+
+        constexpr std::size_t bulk_deleter::max_batch;
+
+        bulk_deleter::bulk_deleter(std::string token, std::chrono::milliseconds window)
+            : token(std::move(token)), window(window)
+        {
+            worker = std::thread(&bulk_deleter::run, this);
+        }
+
+        bulk_deleter::~bulk_deleter()
+        {
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                stopping = true;
+            }
+            wakeup.notify_all();
+            worker.join();
+        }
+
+        bool bulk_deleter::bulk_deletable(snowflake message_id)
+        {
+            // The API's limit is two weeks; leave a minute for the request to
+            // get there
+            using namespace std::chrono;
+            const auto limit = hours(24 * 14) - minutes(1);
+            return system_clock::now() - message_id.time() < limit;
+        }
+
+        std::future<unsigned int> bulk_deleter::delete_message(snowflake channel_id, snowflake message_id)
+        {
+            request r;
+            r.message_id = message_id;
+            std::future<unsigned int> result = r.done.get_future();
+
+            bool full;
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                batch &b = pending[channel_id];
+                if (b.requests.empty())
+                {
+                    b.deadline = std::chrono::steady_clock::now() + window;
+                }
+                b.requests.push_back(std::move(r));
+                full = b.requests.size() >= max_batch;
+                if (full)
+                {
+                    b.deadline = std::chrono::steady_clock::now();
+                }
+            }
+            if (full)
+            {
+                wakeup.notify_all();
+            }
+            return result;
+        }
+
+        void bulk_deleter::flush()
+        {
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                flush_all = true;
+            }
+            wakeup.notify_all();
+        }
+
+        void bulk_deleter::run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                // Take every batch that is due, or all of them when flushing
+                const auto now = std::chrono::steady_clock::now();
+                const bool take_all = flush_all || stopping;
+                std::vector<std::pair<snowflake, std::vector<request>>> due;
+                auto next = std::chrono::steady_clock::time_point::max();
+                pending.erase_if([&](snowflake channel_id, batch &b)
+                {
+                    if (take_all || b.deadline <= now)
+                    {
+                        due.emplace_back(channel_id, std::move(b.requests));
+                        return true;
+                    }
+                    next = std::min(next, b.deadline);
+                    return false;
+                });
+                flush_all = false;
+
+                if (!due.empty())
+                {
+                    lock.unlock();
+                    for (auto &d : due)
+                    {
+                        send(d.first, std::move(d.second));
+                    }
+                    lock.lock();
+                    continue;
+                }
+                if (stopping)
+                {
+                    return;
+                }
+
+                if (next == std::chrono::steady_clock::time_point::max())
+                {
+                    wakeup.wait(lock);
+                }
+                else
+                {
+                    wakeup.wait_until(lock, next);
+                }
+            }
+        }
+
+        void bulk_deleter::send(snowflake channel_id, std::vector<request> requests)
+        {
+            // Old messages can only go one by one
+            auto old = std::stable_partition(requests.begin(), requests.end(),
+                [](const request &r)
+                {
+                    return bulk_deletable(r.message_id);
+                });
+            for (auto it = old; it != requests.end(); ++it)
+            {
+                try
+                {
+                    it->done.set_value(delete_one(channel_id, it->message_id));
+                }
+                catch (...)
+                {
+                    it->done.set_exception(std::current_exception());
+                }
+            }
+            requests.erase(old, requests.end());
+
+            // The same message may have been asked for twice; the API
+            // refuses duplicate ids, so send each once and answer both
+            std::sort(requests.begin(), requests.end(),
+                [](const request &a, const request &b)
+                {
+                    return a.message_id < b.message_id;
+                });
+
+            auto first = requests.begin();
+            while (first != requests.end())
+            {
+                boost::json::array ids;
+                auto last = first;
+                while (last != requests.end() && ids.size() < max_batch)
+                {
+                    if (last == first || last->message_id != std::prev(last)->message_id)
+                    {
+                        ids.emplace_back(boost::json::string_view(last->message_id.to_string()));
+                    }
+                    ++last;
+                }
+                // Keep duplicates of the last id with their batch
+                while (last != requests.end() && last->message_id == std::prev(last)->message_id)
+                {
+                    ++last;
+                }
+
+                if (ids.size() > 1)
+                {
+                    bool settled = true;
+                    try
+                    {
+                        const unsigned int status = delete_many(channel_id, std::move(ids));
+                        // Bulk deletes need MANAGE_MESSAGES, but deleting our
+                        // own messages doesn't, so a refusal may yet be
+                        // undone one message at a time below
+                        settled = status != 403;
+                        for (auto it = first; settled && it != last; ++it)
+                        {
+                            it->done.set_value(status);
+                        }
+                    }
+                    catch (...)
+                    {
+                        for (auto it = first; it != last; ++it)
+                        {
+                            it->done.set_exception(std::current_exception());
+                        }
+                    }
+                    if (settled)
+                    {
+                        first = last;
+                        continue;
+                    }
+                }
+
+                while (first != last)
+                {
+                    auto same = std::next(first);
+                    while (same != last && same->message_id == first->message_id)
+                    {
+                        ++same;
+                    }
+                    try
+                    {
+                        const unsigned int status = delete_one(channel_id, first->message_id);
+                        for (auto it = first; it != same; ++it)
+                        {
+                            it->done.set_value(status);
+                        }
+                    }
+                    catch (...)
+                    {
+                        for (auto it = first; it != same; ++it)
+                        {
+                            it->done.set_exception(std::current_exception());
+                        }
+                    }
+                    first = same;
+                }
+            }
+        }
+
+        unsigned int bulk_deleter::delete_one(snowflake channel_id, snowflake message_id)
+        {
+            return until_accepted(single_bucket, [&]
+            {
+                context ctx;
+                return http::delete_(ctx,
+                                     API_URL,
+                                     route(routes::channel_message, channel_id, message_id).view(),
+                                     token);
+            });
+        }
+
+        unsigned int bulk_deleter::delete_many(snowflake channel_id, boost::json::array ids)
+        {
+            boost::json::object body;
+            body["messages"] = std::move(ids);
+            const std::string payload(boost::json::to_string(boost::json::value(std::move(body))).c_str());
+            return until_accepted(bulk_bucket, [&]
+            {
+                context ctx;
+                return http::post(ctx,
+                                  API_URL,
+                                  route(routes::bulk_delete, channel_id).view(),
+                                  token,
+                                  payload);
+            });
+        }
+    } // namespace rest
+} // namespace discpp
@@ -18,8 +18,14 @@
  *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+#include <stdexcept>
+
 #include "rest/rest.hpp"
 #include "rest/channel.hpp"
+#include "rest/route.hpp"
+#include "cache/message_cache.hpp"
+#include "cache/reaction_index.hpp"
 #include "net/http.hpp"
 
 namespace discpp
@@ -28,6 +34,21 @@ namespace discpp
     {
         namespace channel
         {
+            namespace
+            {
+                std::atomic<cache::message_cache*> message_cache_hook{nullptr};
+                std::atomic<cache::reaction_index*> reaction_index_hook{nullptr};
+            }
+
+            void use_message_cache(cache::message_cache *cache)
+            {
+                message_cache_hook = cache;
+            }
+
+            void use_reaction_index(cache::reaction_index *index)
+            {
+                reaction_index_hook = index;
+            }
 
             namespace detail
             {
@@ -38,101 +59,257 @@ namespace discpp
                         return std::string(emoji_["name"].as_string().c_str());
                     }
 
-                    return std::string(emoji_["id"].as_string().c_str()) +
-                           std::string(emoji_["name"].as_string().c_str());
+                    // Custom emojis are addressed as name:id
+                    return std::string(emoji_["name"].as_string().c_str()) + ":" +
+                           std::string(emoji_["id"].as_string().c_str());
+                }
+
+                route emoji_route(snowflake channel_id, snowflake message_id, const ::discpp::emoji &emoji_)
+                {
+                    route r(routes::reactions, channel_id, message_id);
+                    r.append("/");
+                    r.append_encoded(emoji_.at("name").as_string());
+                    const boost::json::value *id = emoji_.if_contains("id");
+                    if (id && !id->is_null())
+                    {
+                        // Custom emojis are addressed as name:id
+                        r.append("%3A");
+                        r.append_encoded(id->as_string());
+                    }
+                    return r;
+                }
+
+                unsigned int delete_reaction(snowflake channel_id,
+                                             snowflake message_id,
+                                             ::discpp::emoji emoji_,
+                                             boost::json::string_view user,
+                                             boost::json::string_view token)
+                {
+                    context ctx;
+                    auto response = http::delete_(ctx,
+                                                API_URL,
+                                                emoji_route(channel_id, message_id, emoji_).append("/").append(user).view(),
+                                                token);
+
+                    if (response.result() == boost::beast::http::status::no_content)
+                    {
+                        return response.result_int();
+                    }
+
+                    return boost::json::parse(response.body()).as_object()["code"].as_uint64();
                 }
             }
 
             // TODO: double check return values for failed calls;
-            ::discpp::channel get_channel(std::string channel_id, std::string token)
+            ::discpp::channel get_channel(snowflake channel_id, boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::get(ctx,
                                         API_URL,
-                                        "/channels/" + channel_id,
-                                        token
-                                       );
+                                        route(routes::channel, channel_id).view(),
+                                        token);
 
                 return boost::json::parse(response.body()).as_object();
             }
 
-            ::discpp::channel modify_channel(std::string channel_id,
+            ::discpp::channel modify_channel(snowflake channel_id,
                                    boost::json::object patch,
-                                   std::string token)
+                                   boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::patch(ctx,
                                           API_URL,
-                                          "/channels/" + channel_id,
+                                          route(routes::channel, channel_id).view(),
                                           token,
                                           std::string(boost::json::to_string(boost::json::value(patch)).c_str()));
 
                 return boost::json::parse(response.body()).as_object();
             }
 
-            ::discpp::channel delete_channel(std::string channel_id, std::string token)
+            ::discpp::channel delete_channel(snowflake channel_id, boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::delete_(ctx,
                                             API_URL,
-                                            "channels/" + channel_id,
+                                            route(routes::channel, channel_id).view(),
                                             token);
                 return boost::json::parse(response.body()).as_object();
             }
 
-            boost::json::array get_channel_messages(std::string channel_id,
-                                                    std::string token)
+            boost::json::array get_channel_messages(snowflake channel_id,
+                                                    boost::json::string_view token)
+            {
+                if (cache::message_cache *cache = message_cache_hook)
+                {
+                    if (auto cached = cache->latest(channel_id))
+                    {
+                        boost::json::array messages;
+                        for (const auto &m : *cached)
+                        {
+                            messages.push_back(m->json());
+                        }
+                        return messages;
+                    }
+                }
+
+                context ctx;
+                auto response = http::get(ctx,
+                                        API_URL,
+                                        route(routes::channel_messages, channel_id).view(),
+                                        token);
+
+                return boost::json::parse(response.body()).as_array();
+            }
+
+            route &history_query::append_to(route &r) const
+            {
+                if (limit < 1 || limit > 100)
+                {
+                    throw std::invalid_argument("history_query limit must be between 1 and 100");
+                }
+                if ((before ? 1 : 0) + (after ? 1 : 0) + (around ? 1 : 0) > 1)
+                {
+                    throw std::invalid_argument("history_query takes only one of before, after and around");
+                }
+
+                r.append("?limit=").append(limit);
+                if (before)
+                {
+                    r.append("&before=").append(before);
+                }
+                else if (after)
+                {
+                    r.append("&after=").append(after);
+                }
+                else if (around)
+                {
+                    r.append("&around=").append(around);
+                }
+                return r;
+            }
+
+            boost::json::array get_channel_messages(snowflake channel_id,
+                                                    const history_query &query,
+                                                    boost::json::string_view token)
             {
+                // Checked up front, so a bad query fails whether or not the
+                // cache could have answered it
+                route resource(routes::channel_messages, channel_id);
+                query.append_to(resource);
+
+                if (cache::message_cache *cache = message_cache_hook)
+                {
+                    boost::optional<std::vector<cache::message_cache::pointer>> cached;
+                    if (query.before)
+                    {
+                        cached = cache->before(channel_id, query.before, query.limit);
+                    }
+                    else if (query.after)
+                    {
+                        cached = cache->after(channel_id, query.after, query.limit);
+                    }
+                    else if (query.around)
+                    {
+                        cached = cache->around(channel_id, query.around, query.limit);
+                    }
+                    else
+                    {
+                        cached = cache->latest(channel_id, query.limit);
+                    }
+
+                    if (cached)
+                    {
+                        boost::json::array messages;
+                        for (const auto &m : *cached)
+                        {
+                            messages.push_back(m->json());
+                        }
+                        return messages;
+                    }
+                }
+
                 context ctx;
                 auto response = http::get(ctx,
                                         API_URL,
-                                        "/channels/" + channel_id + "/messages",
+                                        resource.view(),
                                         token);
 
                 return boost::json::parse(response.body()).as_array();
             }
 
-            ::discpp::message get_channel_message(std::string channel_id,
-                                        std::string message_id,
-                                        std::string token)
+            pager iterate_messages(snowflake channel_id, boost::json::string_view token, snowflake before)
+            {
+                // The range outlives this call, so it keeps its own token
+                return pager([=, token = std::string(token.data(), token.size())](snowflake cursor)
+                {
+                    history_query query;
+                    query.before = cursor;
+                    query.limit = 100;
+                    return get_channel_messages(channel_id, query, token);
+                }, 100, before);
+            }
+
+            ::discpp::message get_channel_message(snowflake channel_id,
+                                        snowflake message_id,
+                                        boost::json::string_view token)
             {
+                if (cache::message_cache *cache = message_cache_hook)
+                {
+                    if (auto cached = cache->find(channel_id, message_id))
+                    {
+                        return cached->json();
+                    }
+                }
+
                 context ctx;
                 auto response = http::get(ctx,
                                         API_URL,
-                                        "/channels/" + channel_id + "/messages/"
-                                            + message_id,
+                                        route(routes::channel_message, channel_id, message_id).view(),
                                         token);
 
                 return boost::json::parse(response.body()).as_object();
             }
 
-            ::discpp::message create_message(std::string channel_id,
+            ::discpp::message create_message(snowflake channel_id,
                                    boost::json::object msg,
-                                   std::string token)
+                                   boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::post(ctx,
                                          API_URL,
-                                         "/channels/" + channel_id + "/messages",
+                                         route(routes::channel_messages, channel_id).view(),
                                          token,
                                          std::string(boost::json::to_string(boost::json::value(msg)).c_str()));
                 return boost::json::parse(response.body()).as_object();
             }
 
-            unsigned int create_reaction(std::string channel_id,
-                                         std::string message_id,
-                                         ::discpp::emoji emoji_,
-                                         std::string token)
+            ::discpp::message create_message(snowflake channel_id,
+                                   boost::json::object msg,
+                                   http::multipart_form files,
+                                   boost::json::string_view token)
             {
-                std::string emoji_string =
-                    http::url_encode(detail::get_emoji_string(emoji_));
+                files.add_field("payload_json",
+                                std::string(boost::json::to_string(boost::json::value(msg)).c_str()),
+                                "application/json");
 
+                context ctx;
+                auto response = http::post_multipart(ctx,
+                                                   API_URL,
+                                                   route(routes::channel_messages, channel_id).view(),
+                                                   token,
+                                                   std::move(files));
+                return boost::json::parse(response.body()).as_object();
+            }
+
+            unsigned int create_reaction(snowflake channel_id,
+                                         snowflake message_id,
+                                         ::discpp::emoji emoji_,
+                                         boost::json::string_view token)
+            {
                 context ctx;
                 auto response = http::put(ctx,
                                         API_URL,
-                                        "/channels/" + channel_id + "/messages/"
-                                            + message_id + "/reactions/"
-                                            + emoji_string + "/@me",
+                                        detail::emoji_route(channel_id, message_id, emoji_).append("/@me").view(),
                                         token,
                                         "");
                 if (response.result() == boost::beast::http::status::no_content)
@@ -143,107 +320,176 @@ namespace discpp
                 return boost::json::parse(response.body()).as_object()["code"].as_uint64();
             }
 
-            unsigned int delete_own_reaction(std::string channel_id,
-                                             std::string message_id,
+            unsigned int delete_own_reaction(snowflake channel_id,
+                                             snowflake message_id,
                                              ::discpp::emoji emoji_,
-                                             std::string token)
+                                             boost::json::string_view token)
             {
-                return delete_user_reaction(channel_id,
-                                            message_id,
-                                            emoji_,
-                                            "@me",
-                                            token);
+                return detail::delete_reaction(channel_id,
+                                               message_id,
+                                               emoji_,
+                                               "@me",
+                                               token);
             }
 
-            unsigned int delete_user_reaction(std::string channel_id,
-                                              std::string message_id,
+            unsigned int delete_user_reaction(snowflake channel_id,
+                                              snowflake message_id,
                                               ::discpp::emoji emoji_,
-                                              std::string user_id,
-                                              std::string token)
+                                              snowflake user_id,
+                                              boost::json::string_view token)
             {
-                std::string emoji_string =
-                    http::url_encode(detail::get_emoji_string(emoji_));
-
-                context ctx;
-                auto response = http::delete_(ctx,
-                                            API_URL,
-                                            "/channels/" + channel_id + "/messages/"
-                                                + message_id + "/reactions/"
-                                                + emoji_string + "/" + user_id,
-                                            token);
+                return detail::delete_reaction(channel_id,
+                                               message_id,
+                                               emoji_,
+                                               user_id.to_string(),
+                                               token);
+            }
 
-                if (response.result() == boost::beast::http::status::no_content)
+            namespace
+            {
+                /*! Up to `limit` users who reacted with `emoji_`, by
+                 *  ascending id, starting after `after` */
+                boost::json::array reactions_page(snowflake channel_id,
+                                                  snowflake message_id,
+                                                  const ::discpp::emoji &emoji_,
+                                                  snowflake after,
+                                                  unsigned int limit,
+                                                  boost::json::string_view token)
                 {
-                    return response.result_int();
-                }
+                    route resource = detail::emoji_route(channel_id, message_id, emoji_);
+                    resource.append("?limit=").append(limit);
+                    if (after)
+                    {
+                        resource.append("&after=").append(after);
+                    }
 
-                return boost::json::parse(response.body()).as_object()["code"].as_uint64();
+                    context ctx;
+                    auto response = http::get(ctx, API_URL, resource.view(), token);
+
+                    return boost::json::parse(response.body()).as_array();
+                }
             }
 
-            boost::json::array get_reactions(std::string channel_id,
-                                             std::string message_id,
+            boost::json::array get_reactions(snowflake channel_id,
+                                             snowflake message_id,
                                              ::discpp::emoji emoji_,
-                                             std::string token)
+                                             boost::json::string_view token)
             {
-                std::string emoji_string =
-                    http::url_encode(detail::get_emoji_string(emoji_));
+                // 25 is what the API sends when no limit is given
+                return reactions_page(channel_id, message_id, emoji_, snowflake(), 25, token);
+            }
 
-                context ctx;
-                auto response = http::get(ctx,
-                                        API_URL,
-                                        "/channels/" + channel_id + "/messages/"
-                                            + message_id + "/reactions/"
-                                            + emoji_string,
-                                        token);
+            std::vector<snowflake> get_reaction_user_ids(snowflake channel_id,
+                                                         snowflake message_id,
+                                                         ::discpp::emoji emoji_,
+                                                         boost::json::string_view token,
+                                                         snowflake after,
+                                                         unsigned int limit)
+            {
+                if (cache::reaction_index *index = reaction_index_hook)
+                {
+                    if (auto users = index->users(message_id, cache::reaction_index::emoji_key(emoji_),
+                                                  after, limit))
+                    {
+                        return std::move(*users);
+                    }
+                }
 
-                if (response.result() == boost::beast::http::status::no_content)
+                std::vector<snowflake> out;
+                for (const boost::json::value &user :
+                         reactions_page(channel_id, message_id, emoji_, after, limit, token))
                 {
-                    return response.result_int();
+                    if (const boost::json::object *u = user.if_object())
+                    {
+                        if (const boost::json::value *id = u->if_contains("id"))
+                        {
+                            out.push_back(snowflake::from_json(*id));
+                        }
+                    }
                 }
+                return out;
+            }
 
-                return boost::json::parse(response.body()).as_object()["code"].as_uint64();
+            std::size_t get_reaction_count(snowflake channel_id,
+                                           snowflake message_id,
+                                           ::discpp::emoji emoji_,
+                                           boost::json::string_view token)
+            {
+                const std::string key = cache::reaction_index::emoji_key(emoji_);
+                if (cache::reaction_index *index = reaction_index_hook)
+                {
+                    if (auto n = index->count(message_id, key))
+                    {
+                        return *n;
+                    }
+                }
+
+                // The message carries a count per emoji, so one request will
+                // do, however many users reacted
+                const ::discpp::message message = get_channel_message(channel_id, message_id, token);
+                const boost::json::value *reactions = message.if_contains("reactions");
+                if (!reactions || !reactions->is_array())
+                {
+                    return 0;
+                }
+                for (const boost::json::value &v : reactions->as_array())
+                {
+                    const boost::json::object *r = v.if_object();
+                    const boost::json::value *e = r ? r->if_contains("emoji") : nullptr;
+                    const boost::json::value *n = r ? r->if_contains("count") : nullptr;
+                    if (e && e->is_object() && n && n->is_int64() && n->get_int64() >= 0 &&
+                        cache::reaction_index::emoji_key(e->as_object()) == key)
+                    {
+                        return static_cast<std::size_t>(n->get_int64());
+                    }
+                }
+                return 0;
+            }
+
+            pager iterate_reactions(snowflake channel_id,
+                                    snowflake message_id,
+                                    ::discpp::emoji emoji_,
+                                    boost::json::string_view token)
+            {
+                return pager([=, token = std::string(token.data(), token.size())](snowflake after)
+                {
+                    return reactions_page(channel_id, message_id, emoji_, after, 100, token);
+                }, 100);
             }
 
             // TODO: should this be void?
-            void delete_all_reactions(std::string channel_id,
-                                      std::string message_id,
-                                      std::string token)
+            void delete_all_reactions(snowflake channel_id,
+                                      snowflake message_id,
+                                      boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::delete_(ctx,
                                             API_URL,
-                                            "/channels/" + channel_id + "/messages/"
-                                                + message_id + "/reactions",
+                                            route(routes::reactions, channel_id, message_id).view(),
                                             token);
             }
 
-            void delete_all_reactions_for_emoji(std::string channel_id,
-                                                std::string message_id,
+            void delete_all_reactions_for_emoji(snowflake channel_id,
+                                                snowflake message_id,
                                                 ::discpp::emoji emoji_,
-                                                std::string token)
+                                                boost::json::string_view token)
             {
-                std::string emoji_string =
-                    http::url_encode(detail::get_emoji_string(emoji_));
-
                 context ctx;
                 auto response = http::delete_(ctx,
                                             API_URL,
-                                            "/channels/" + channel_id + "/messages/"
-                                                + message_id + "/reactions/"
-                                                + emoji_string,
+                                            detail::emoji_route(channel_id, message_id, emoji_).view(),
                                             token);
             }
 
-            ::discpp::message edit_message(std::string channel_id,
-                                 std::string message_id,
+            ::discpp::message edit_message(snowflake channel_id,
+                                 snowflake message_id,
                                  boost::json::object patch,
-                                 std::string token)
+                                 boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::patch(ctx,
                                           API_URL,
-                                          "/channels/" + channel_id + "/messages/"
-                                              + message_id,
+                                          route(routes::channel_message, channel_id, message_id).view(),
                                           token,
                                           std::string(boost::json::to_string(boost::json::value(patch)).c_str()));
 
@@ -251,28 +497,27 @@ namespace discpp
 
             }
 
-            unsigned int delete_message(std::string channel_id,
-                                        std::string message_id,
-                                        std::string token)
+            unsigned int delete_message(snowflake channel_id,
+                                        snowflake message_id,
+                                        boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::delete_(ctx,
                                             API_URL,
-                                            "/channels/" + channel_id + "/messages"
-                                                + message_id,
+                                            route(routes::channel_message, channel_id, message_id).view(),
                                             token);
 
                 return response.result_int();
             }
 
-            unsigned int bulk_delete_messages(std::string channel_id,
+            unsigned int bulk_delete_messages(snowflake channel_id,
                                               boost::json::object messages,
-                                              std::string token)
+                                              boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::post(ctx,
                                          API_URL,
-                                         "/channels/" + channel_id + "/messages/bulk-delete",
+                                         route(routes::bulk_delete, channel_id).view(),
                                          token,
                                          std::string(boost::json::to_string(boost::json::value(messages)).c_str()));
 
@@ -280,16 +525,15 @@ namespace discpp
             }
 
             // TODO: make sure guild channel
-            unsigned int edit_channel_permissions(std::string channel_id,
-                                                  std::string overwrite_id,
+            unsigned int edit_channel_permissions(snowflake channel_id,
+                                                  snowflake overwrite_id,
                                                   boost::json::object perms,
-                                                  std::string token)
+                                                  boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::put(ctx,
                                         API_URL,
-                                        "/channels/" + channel_id + "/permissions/"
-                                            + overwrite_id,
+                                        route(routes::permission_overwrite, channel_id, overwrite_id).view(),
                                         token,
                                         std::string(boost::json::to_string(boost::json::value(perms)).c_str()));
 
@@ -297,26 +541,34 @@ namespace discpp
             }
 
             // TODO: make sure guild channel; also check; is it an array?
-            boost::json::array get_channel_invites(std::string channel_id,
-                                                   std::string token)
+            boost::json::array get_channel_invites(snowflake channel_id,
+                                                   boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::get(ctx,
                                           API_URL,
-                                          "/channels/" + channel_id + "/invites",
+                                          route(routes::channel_invites, channel_id).view(),
                                           token);
 
                 return boost::json::parse(response.body()).as_array();
             }
 
-            ::discpp::invite create_channel_invite(std::string channel_id,
+            pager iterate_invites(snowflake channel_id, boost::json::string_view token)
+            {
+                return pager([=, token = std::string(token.data(), token.size())](snowflake)
+                {
+                    return get_channel_invites(channel_id, token);
+                }, 0);
+            }
+
+            ::discpp::invite create_channel_invite(snowflake channel_id,
                                          boost::json::object invite,
-                                         std::string token)
+                                         boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::post(ctx,
                                            API_URL,
-                                           "/channels/" + channel_id + "/invites",
+                                           route(routes::channel_invites, channel_id).view(),
                                            token,
                                            std::string(boost::json::to_string(boost::json::value(invite)).c_str()));
 
@@ -324,98 +576,93 @@ namespace discpp
             }
 
             // TODO: make sure guild channel
-            unsigned int delete_channel_permission(std::string channel_id,
-                                                   std::string overwrite_id,
-                                                   std::string token)
+            unsigned int delete_channel_permission(snowflake channel_id,
+                                                   snowflake overwrite_id,
+                                                   boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::delete_(ctx,
                                               API_URL,
-                                              "/channels/" + channel_id
-                                                  + "/permissions/" + overwrite_id,
+                                              route(routes::permission_overwrite, channel_id, overwrite_id).view(),
                                               token);
 
                 return response.result_int();
             }
 
-            unsigned int trigger_typing_indicator(std::string channel_id,
-                                                  std::string token)
+            unsigned int trigger_typing_indicator(snowflake channel_id,
+                                                  boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::post(ctx,
                                            API_URL,
-                                           "/channels/" + channel_id + "/typing",
+                                           route(routes::typing, channel_id).view(),
                                            token,
                                            "");
 
                 return response.result_int();
             }
 
-            boost::json::array get_pinned_messages(std::string channel_id,
-                                                   std::string token)
+            boost::json::array get_pinned_messages(snowflake channel_id,
+                                                   boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::get(ctx,
                                           API_URL,
-                                          "/channels/" + channel_id + "/pins",
+                                          route(routes::pins, channel_id).view(),
                                           token);
 
                 return boost::json::parse(response.body()).as_array();
             }
 
-            unsigned int add_pinned_channel_message(std::string channel_id,
-                                                    std::string message_id,
-                                                    std::string token)
+            unsigned int add_pinned_channel_message(snowflake channel_id,
+                                                    snowflake message_id,
+                                                    boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::put(ctx,
                                         API_URL,
-                                        "/channels/" + channel_id
-                                            + "/pins/" + message_id,
+                                        route(routes::pin, channel_id, message_id).view(),
                                         token,
                                         "");
 
                 return response.result_int();
             }
 
-            unsigned int delete_pinned_channel_message(std::string channel_id,
-                                                       std::string message_id,
-                                                       std::string token)
+            unsigned int delete_pinned_channel_message(snowflake channel_id,
+                                                       snowflake message_id,
+                                                       boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::delete_(ctx,
                                             API_URL,
-                                            "/channels/" + channel_id
-                                                + "/pins/" + message_id,
+                                            route(routes::pin, channel_id, message_id).view(),
                                             token);
 
                 return response.result_int();
             }
 
             // TODO: should this be void?
-            void group_dm_add_recipient(std::string channel_id,
-                                        std::string user_id,
+            void group_dm_add_recipient(snowflake channel_id,
+                                        snowflake user_id,
                                         boost::json::object user,
-                                        std::string token)
+                                        boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::put(ctx,
                                         API_URL,
-                                        "/channels/" + channel_id
-                                            + "/recipients/" + user_id,
+                                        route(routes::recipient, channel_id, user_id).view(),
                                         token,
                                         std::string(boost::json::to_string(boost::json::value(user)).c_str()));
             }
 
-            void group_dm_remove_recipient(std::string channel_id,
-                                           std::string user_id,
-                                           std::string token)
+            void group_dm_remove_recipient(snowflake channel_id,
+                                           snowflake user_id,
+                                           boost::json::string_view token)
             {
                 context ctx;
                 auto response = http::delete_(ctx,
                                             API_URL,
-                                            "/channels/" + channel_id
-                                                + "/recipients/" + user_id,
+                                            route(routes::recipient, channel_id, user_id).view(),
                                             token);
             }
 
@@ -0,0 +1,230 @@
+/*! \file edit_coalescer.cpp
+ *  \brief Collapses bursts of edits to the same object into one request
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include "rest/rest.hpp"
+#include "rest/edit_coalescer.hpp"
+#include "rest/route.hpp"
+#include "net/http.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        edit_coalescer::edit_coalescer(std::string token)
+            : token(std::move(token))
+        {
+            worker = std::thread(&edit_coalescer::run, this);
+        }
+
+        edit_coalescer::~edit_coalescer()
+        {
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                stopping = true;
+            }
+            wakeup.notify_all();
+            worker.join();
+        }
+
+        std::future<::discpp::message> edit_coalescer::edit_message(snowflake channel_id,
+                                                                    snowflake message_id,
+                                                                    boost::json::object patch)
+        {
+            return submit(target{channel_id, message_id}, std::move(patch));
+        }
+
+        std::future<::discpp::channel> edit_coalescer::modify_channel(snowflake channel_id,
+                                                                      boost::json::object patch)
+        {
+            return submit(target{channel_id, snowflake()}, std::move(patch));
+        }
+
+        edit_coalescer::statistics edit_coalescer::stats() const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            return counters;
+        }
+
+        void edit_coalescer::merge_under(boost::json::object &into, const boost::json::object &patch)
+        {
+            for (const auto &kv : patch)
+            {
+                if (!into.contains(kv.key()))
+                {
+                    into[kv.key()] = kv.value();
+                }
+            }
+        }
+
+        std::future<boost::json::object> edit_coalescer::submit(target t, boost::json::object patch)
+        {
+            std::promise<boost::json::object> done;
+            std::future<boost::json::object> result = done.get_future();
+
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                ++counters.submitted;
+                if (pending_edit *queued = pending.find(t))
+                {
+                    // The newer patch wins wherever both set a field
+                    merge_under(patch, queued->patch);
+                    queued->patch = std::move(patch);
+                    queued->waiters.push_back(std::move(done));
+                    ++counters.merged;
+                    return result;
+                }
+                pending_edit edit;
+                edit.patch = std::move(patch);
+                edit.waiters.push_back(std::move(done));
+                pending.insert(t, std::move(edit));
+                order.push_back(t);
+            }
+            wakeup.notify_all();
+            return result;
+        }
+
+        rate_limit &edit_coalescer::bucket(const target &t)
+        {
+            return t.message_id ? message_buckets[t.channel_id] : channel_buckets[t.channel_id];
+        }
+
+        void edit_coalescer::run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                if (stopping)
+                {
+                    pending.for_each([](const target &, pending_edit &edit)
+                    {
+                        for (auto &w : edit.waiters)
+                        {
+                            w.set_exception(std::make_exception_ptr(
+                                std::runtime_error("edit_coalescer destroyed before the edit was sent")));
+                        }
+                    });
+                    pending.clear();
+                    order.clear();
+                    return;
+                }
+
+                // Send the oldest edit whose bucket has room
+                const auto now = rate_limit::clock::now();
+                auto next = rate_limit::clock::time_point::max();
+                auto ready = order.end();
+                for (auto it = order.begin(); it != order.end(); ++it)
+                {
+                    const auto at = bucket(*it).ready_at();
+                    if (at <= now)
+                    {
+                        ready = it;
+                        break;
+                    }
+                    next = std::min(next, at);
+                }
+
+                if (ready != order.end())
+                {
+                    const target t = *ready;
+                    order.erase(ready);
+                    pending_edit edit = std::move(*pending.find(t));
+                    pending.erase(t);
+                    ++counters.sent;
+
+                    lock.unlock();
+                    send(t, std::move(edit));
+                    lock.lock();
+                    continue;
+                }
+
+                if (order.empty())
+                {
+                    wakeup.wait(lock);
+                }
+                else
+                {
+                    wakeup.wait_until(lock, next);
+                }
+            }
+        }
+
+        void edit_coalescer::send(target t, pending_edit edit)
+        {
+            const route resource = t.message_id ? route(routes::channel_message, t.channel_id, t.message_id)
+                                                : route(routes::channel, t.channel_id);
+
+            try
+            {
+                context ctx;
+                auto response = http::patch(ctx,
+                                            API_URL,
+                                            resource.view(),
+                                            token,
+                                            std::string(boost::json::to_string(boost::json::value(edit.patch)).c_str()));
+
+                {
+                    std::lock_guard<std::mutex> g(mutex);
+                    bucket(t).update(response);
+                    if (response.result_int() == 429 && !stopping)
+                    {
+                        // Try again once the bucket resets, folding in
+                        // whatever was queued for the target meanwhile
+                        if (pending_edit *newer = pending.find(t))
+                        {
+                            merge_under(newer->patch, edit.patch);
+                            std::move(edit.waiters.begin(), edit.waiters.end(),
+                                      std::back_inserter(newer->waiters));
+                        }
+                        else
+                        {
+                            pending.insert(t, std::move(edit));
+                            order.push_front(t);
+                        }
+                        return;
+                    }
+                }
+
+                const unsigned int status = response.result_int();
+                if (status < 200 || status >= 300)
+                {
+                    // Error bodies aren't the edited object; don't pass them off as one
+                    throw std::runtime_error("PATCH " + std::string(resource.view().data(), resource.view().size())
+                                             + " failed with HTTP " + std::to_string(status));
+                }
+                const boost::json::object result = boost::json::parse(response.body()).as_object();
+                for (auto &w : edit.waiters)
+                {
+                    w.set_value(result);
+                }
+            }
+            catch (...)
+            {
+                for (auto &w : edit.waiters)
+                {
+                    w.set_exception(std::current_exception());
+                }
+            }
+        }
+    } // namespace rest
+} // namespace discpp
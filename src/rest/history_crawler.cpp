@@ -0,0 +1,341 @@
+/*! \file history_crawler.cpp
+ *  \brief Walks whole channel histories, many channels at once
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "rest/rest.hpp"
+#include "rest/channel.hpp"
+#include "rest/history_crawler.hpp"
+#include "rest/route.hpp"
+#include "net/http.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        namespace
+        {
+            /*! First line of every checkpoint file; one "channel oldest"
+             *  pair follows per line */
+            const char checkpoint_header[] = "discpp-history 1";
+
+            /*! 5xx answers in a row a crawl sits out before it fails; the
+             *  waits between them add up to half a minute */
+            constexpr unsigned int max_server_errors = 5;
+        }
+
+        constexpr unsigned int history_crawler::page_size;
+
+        history_crawler::history_crawler(std::string token, std::size_t workers)
+            : token(std::move(token))
+        {
+            const std::size_t n = std::max<std::size_t>(workers, 1);
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                this->workers.emplace_back(&history_crawler::run, this);
+            }
+        }
+
+        history_crawler::~history_crawler()
+        {
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                stopping = true;
+            }
+            wakeup.notify_all();
+            for (std::thread &t : workers)
+            {
+                t.join();
+            }
+
+            jobs.for_each([](snowflake, std::unique_ptr<job> &j)
+            {
+                j->done.set_exception(std::make_exception_ptr(
+                    std::runtime_error("history_crawler destroyed before the crawl finished")));
+            });
+        }
+
+        std::future<std::size_t> history_crawler::crawl(snowflake channel_id,
+                                                        page_handler handler,
+                                                        snowflake before)
+        {
+            std::unique_ptr<job> j(new job);
+            j->channel_id = channel_id;
+            j->before = before;
+            j->handler = std::move(handler);
+            std::future<std::size_t> result = j->done.get_future();
+
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                if (!jobs.insert(channel_id, std::move(j)).second)
+                {
+                    throw std::logic_error("Channel " + channel_id.to_string() + " is already being crawled");
+                }
+                idle.push_back(channel_id);
+            }
+            wakeup.notify_one();
+            return result;
+        }
+
+        snowflake history_crawler::checkpoint(snowflake channel_id) const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            const std::unique_ptr<job> *j = jobs.find(channel_id);
+            return j ? (*j)->before : snowflake();
+        }
+
+        void history_crawler::run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping)
+            {
+                // Take the channel that has waited longest and may be asked
+                // for its next page
+                const auto now = rate_limit::clock::now();
+                auto next = rate_limit::clock::time_point::max();
+                auto ready = idle.end();
+                for (auto it = idle.begin(); it != idle.end(); ++it)
+                {
+                    const auto at = std::max(buckets[*it].ready_at(), (*jobs.find(*it))->retry_at);
+                    if (at <= now)
+                    {
+                        ready = it;
+                        break;
+                    }
+                    next = std::min(next, at);
+                }
+
+                if (ready == idle.end())
+                {
+                    if (next == rate_limit::clock::time_point::max())
+                    {
+                        wakeup.wait(lock);
+                    }
+                    else
+                    {
+                        wakeup.wait_until(lock, next);
+                    }
+                    continue;
+                }
+
+                const snowflake channel_id = *ready;
+                idle.erase(ready);
+                // Only this worker touches the job until it is idle again,
+                // and the map holds it by pointer, so it stays put
+                job &j = **jobs.find(channel_id);
+
+                lock.unlock();
+                bool more;
+                try
+                {
+                    more = step(j);
+                }
+                catch (...)
+                {
+                    j.done.set_exception(std::current_exception());
+                    more = false;
+                }
+                lock.lock();
+
+                if (more)
+                {
+                    idle.push_back(channel_id);
+                    wakeup.notify_one();
+                }
+                else
+                {
+                    jobs.erase(channel_id);
+                }
+            }
+        }
+
+        bool history_crawler::step(job &j)
+        {
+            channel::history_query query;
+            query.before = j.before;
+            query.limit = page_size;
+
+            route resource(routes::channel_messages, j.channel_id);
+            query.append_to(resource);
+
+            context ctx;
+            auto response = http::get(ctx, API_URL, resource.view(), token);
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                buckets[j.channel_id].update(response);
+            }
+
+            const unsigned int status = response.result_int();
+            if (status == 429)
+            {
+                // The bucket now knows when to try again
+                return true;
+            }
+            if (status >= 500)
+            {
+                // Most likely passing trouble on the API's side; ask again,
+                // waiting twice as long each time, up to a point
+                if (++j.server_errors > max_server_errors)
+                {
+                    throw std::runtime_error("GET " + std::string(resource.view().data(), resource.view().size())
+                                             + " kept failing with HTTP " + std::to_string(status));
+                }
+                j.retry_at = rate_limit::clock::now() + std::chrono::seconds(1 << (j.server_errors - 1));
+                return true;
+            }
+            if (status < 200 || status >= 300)
+            {
+                // An error object, not a page; a 403 or 404 won't go away
+                throw std::runtime_error("GET " + std::string(resource.view().data(), resource.view().size())
+                                         + " failed with HTTP " + std::to_string(status));
+            }
+            j.server_errors = 0;
+
+            const boost::json::array page = boost::json::parse(response.body()).as_array();
+            if (!page.empty())
+            {
+                j.handler(j.channel_id, page);
+                j.delivered += page.size();
+
+                const boost::json::object *oldest = page.back().if_object();
+                const boost::json::value *id = oldest ? oldest->if_contains("id") : nullptr;
+                const snowflake before = id ? snowflake::from_json(*id) : snowflake();
+                if (before)
+                {
+                    std::lock_guard<std::mutex> g(mutex);
+                    j.before = before;
+                }
+                else
+                {
+                    throw std::runtime_error("Message without an id in the history of channel "
+                                             + j.channel_id.to_string());
+                }
+            }
+
+            if (page.size() < page_size)
+            {
+                j.done.set_value(j.delivered);
+                return false;
+            }
+            return true;
+        }
+
+        ndjson_writer::ndjson_writer(std::string path)
+            : path(std::move(path))
+        {
+            std::ifstream in(this->path + ".checkpoint");
+            std::string line;
+            if (std::getline(in, line) && line == checkpoint_header)
+            {
+                while (std::getline(in, line))
+                {
+                    const std::size_t space = line.find(' ');
+                    if (space == std::string::npos)
+                    {
+                        continue;
+                    }
+                    try
+                    {
+                        const boost::json::string_view l(line);
+                        checkpoints.insert_or_assign(snowflake::from_string(l.substr(0, space)),
+                                                     snowflake::from_string(l.substr(space + 1)));
+                    }
+                    catch (const std::invalid_argument &)
+                    {
+                    }
+                }
+            }
+
+            out.open(this->path, std::ios::out | std::ios::app | std::ios::binary);
+            if (!out)
+            {
+                throw std::runtime_error("Couldn't open " + this->path + " for appending");
+            }
+        }
+
+        void ndjson_writer::write(snowflake channel_id, const boost::json::array &page)
+        {
+            if (page.empty())
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> g(mutex);
+            for (const boost::json::value &message : page)
+            {
+                out << boost::json::to_string(message).c_str() << '\n';
+            }
+            out.flush();
+            if (!out)
+            {
+                throw std::runtime_error("Couldn't write to " + path);
+            }
+
+            const boost::json::object *oldest = page.back().if_object();
+            const boost::json::value *id = oldest ? oldest->if_contains("id") : nullptr;
+            if (id)
+            {
+                checkpoints.insert_or_assign(channel_id, snowflake::from_json(*id));
+                save_checkpoints();
+            }
+        }
+
+        history_crawler::page_handler ndjson_writer::handler()
+        {
+            return [this](snowflake channel_id, const boost::json::array &page)
+            {
+                write(channel_id, page);
+            };
+        }
+
+        snowflake ndjson_writer::resume_point(snowflake channel_id) const
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            const snowflake *at = checkpoints.find(channel_id);
+            return at ? *at : snowflake();
+        }
+
+        void ndjson_writer::save_checkpoints()
+        {
+            const std::string target = path + ".checkpoint";
+            const std::string temp = target + ".tmp";
+            {
+                std::ofstream cp(temp, std::ios::out | std::ios::trunc);
+                cp << checkpoint_header << '\n';
+                checkpoints.for_each([&cp](snowflake channel_id, snowflake oldest)
+                {
+                    cp << channel_id.to_string() << ' ' << oldest.to_string() << '\n';
+                });
+                cp.flush();
+                if (!cp)
+                {
+                    throw std::runtime_error("Couldn't write " + temp);
+                }
+            }
+            if (std::rename(temp.c_str(), target.c_str()) != 0)
+            {
+                std::remove(temp.c_str());
+                throw std::runtime_error("Couldn't replace " + target);
+            }
+        }
+    } // namespace rest
+} // namespace discpp
@@ -0,0 +1,102 @@
+/*! \file pager.cpp
+ *  \brief Walks paginated list endpoints a page at a time
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <thread>
+
+#include "rest/pager.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        pager::pager(fetch_function fetch, std::size_t page_size, snowflake start)
+            : fetch(std::move(fetch)), page_size(page_size), cursor(start)
+        {
+        }
+
+        pager::iterator pager::begin()
+        {
+            if (!started)
+            {
+                started = true;
+                load(fetch(cursor));
+            }
+            return iterator(this);
+        }
+
+        const boost::json::value &pager::current() const
+        {
+            return page.begin()[index];
+        }
+
+        void pager::load(boost::json::array fetched)
+        {
+            page = std::move(fetched);
+            index = 0;
+            exhausted = page.empty();
+            // Late enough that a walk given up early rarely pays for a page
+            // it never reads, early enough that the page is usually in by
+            // the time it's needed
+            prefetch_at = page.size() - page.size() / 4;
+        }
+
+        void pager::prefetch_next()
+        {
+            if (page_size == 0 || page.size() < page_size)
+            {
+                return;
+            }
+
+            const boost::json::object *last = page.back().if_object();
+            const boost::json::value *id = last ? last->if_contains("id") : nullptr;
+            cursor = id ? snowflake::from_json(*id) : snowflake();
+            if (!cursor)
+            {
+                return;
+            }
+            // The task gets its own copy of the fetcher, so the pager may
+            // still be moved, or destroyed, while a page is on its way. Unlike
+            // std::async's, this future doesn't block when dropped
+            std::packaged_task<boost::json::array(snowflake)> task(fetch);
+            next = task.get_future();
+            std::thread(std::move(task), cursor).detach();
+        }
+
+        void pager::advance()
+        {
+            if (++index == prefetch_at)
+            {
+                prefetch_next();
+            }
+            if (index < page.size())
+            {
+                return;
+            }
+
+            if (!next.valid())
+            {
+                page = boost::json::array();
+                exhausted = true;
+                return;
+            }
+            load(next.get());
+        }
+    } // namespace rest
+} // namespace discpp
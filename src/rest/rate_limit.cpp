@@ -0,0 +1,83 @@
+/*! \file rate_limit.cpp
+ *  \brief Tracks the state of REST rate limit buckets
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <string>
+
+#include "rest/rate_limit.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        namespace
+        {
+            /*! Parses a header holding (fractional) seconds; none if absent */
+            bool seconds_in(boost::json::string_view header, rate_limit::clock::duration &out)
+            {
+                if (header.empty())
+                {
+                    return false;
+                }
+                const std::string s(header.data(), header.size());
+                char *end = nullptr;
+                const double seconds = std::strtod(s.c_str(), &end);
+                if (end == s.c_str() || seconds < 0)
+                {
+                    return false;
+                }
+                out = std::chrono::duration_cast<rate_limit::clock::duration>(
+                    std::chrono::duration<double>(seconds));
+                return true;
+            }
+        }
+
+        void rate_limit::update(boost::json::string_view remaining_header,
+                                boost::json::string_view reset_after,
+                                boost::json::string_view retry_after,
+                                bool too_many_requests)
+        {
+            const clock::time_point now = clock::now();
+            clock::duration wait;
+
+            if (too_many_requests)
+            {
+                remaining = 0;
+                reset = now + (seconds_in(retry_after, wait) ? wait : std::chrono::seconds(1));
+                return;
+            }
+
+            if (!remaining_header.empty())
+            {
+                remaining = std::strtol(std::string(remaining_header.data(),
+                                                    remaining_header.size()).c_str(), nullptr, 10);
+            }
+            if (seconds_in(reset_after, wait))
+            {
+                reset = now + wait;
+            }
+        }
+
+        rate_limit::clock::time_point rate_limit::ready_at() const
+        {
+            return remaining > 0 ? clock::time_point() : reset;
+        }
+    } // namespace rest
+} // namespace discpp
@@ -0,0 +1,102 @@
+/*! \file route.cpp
+ *  \brief REST routes, rendered without touching the heap
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "rest/route.hpp"
+#include "net/http.hpp"
+
+namespace discpp
+{
+    namespace rest
+    {
+        constexpr std::size_t route::capacity;
+
+        route &route::append(boost::json::string_view s)
+        {
+            if (s.size() > capacity - length)
+            {
+                throw std::length_error("Route longer than " + std::to_string(capacity) + " bytes");
+            }
+            std::memcpy(buffer + length, s.data(), s.size());
+            length += s.size();
+            return *this;
+        }
+
+        route &route::append(snowflake id)
+        {
+            return append_decimal(id.value());
+        }
+
+        route &route::append(unsigned int n)
+        {
+            return append_decimal(n);
+        }
+
+        route &route::append_encoded(boost::json::string_view s)
+        {
+            if (3 * s.size() > capacity - length)
+            {
+                // Only the worst case is known not to fit; the actual
+                // encoding may still
+                return append(http::url_encode(s));
+            }
+            length = static_cast<std::size_t>(http::url_encode(s, buffer + length) - buffer);
+            return *this;
+        }
+
+        route &route::append_decimal(std::uint64_t v)
+        {
+            // 2^64 has 20 digits
+            char digits[20];
+            char *p = digits + sizeof digits;
+            do
+            {
+                *--p = static_cast<char>('0' + v % 10);
+                v /= 10;
+            } while (v);
+            return append(boost::json::string_view(p, static_cast<std::size_t>(digits + sizeof digits - p)));
+        }
+
+        void route::render(const char *text, std::size_t size, const route_arg *args)
+        {
+            std::size_t start = 0;
+            for (std::size_t i = 0; i + 1 < size; ++i)
+            {
+                if (text[i] != '{' || text[i + 1] != '}')
+                {
+                    continue;
+                }
+                append(boost::json::string_view(text + start, i - start));
+                if (args->is_id)
+                {
+                    append(args->id);
+                }
+                else
+                {
+                    append(args->text);
+                }
+                ++args;
+                start = ++i + 1;
+            }
+            append(boost::json::string_view(text + start, size - start));
+        }
+    } // namespace rest
+} // namespace discpp
@@ -0,0 +1,40 @@
+/*! \file check.hpp
+ *  \brief The assertion macro shared by the tests
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <cstdlib>
+#include <iostream>
+
+/*! Fails the test, naming the condition and where it was checked, unless
+ *  `cond` holds. Tests are plain executables; any failure exits with 1. */
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            std::cerr << __FILE__ << ":" << __LINE__                        \
+                      << ": check failed: " #cond << std::endl;             \
+            std::exit(1);                                                   \
+        }                                                                   \
+    } while (false)
+
+#endif
@@ -0,0 +1,266 @@
+/*! \file ondemand_test.cpp
+ *  \brief Checks ondemand::document against boost::json on random input
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include <boost/json.hpp>
+
+#include "core/ondemand.hpp"
+#include "check.hpp"
+
+namespace
+{
+    using namespace discpp;
+
+    /*! Writes random JSON, heavy on the things the structural indexer has
+     *  to get right: quotes and brackets inside strings, runs of
+     *  backslashes, and strings straddling 64 byte blocks */
+    class generator
+    {
+        public:
+            explicit generator(std::uint32_t seed) : rng(seed) {}
+
+            std::string document()
+            {
+                std::string out;
+                space(out);
+                value(out, 0);
+                space(out);
+                return out;
+            }
+
+        private:
+            std::size_t below(std::size_t n) { return rng() % n; }
+
+            void space(std::string &out)
+            {
+                static const char ws[] = " \t\r\n";
+                for (std::size_t n = below(4) ? 0 : below(3); n > 0; --n)
+                {
+                    out += ws[below(4)];
+                }
+            }
+
+            void string(std::string &out, bool escapes)
+            {
+                static const char plain[] = "abcXYZ019 {}[]:,";
+                static const char *const special[] = {
+                    "\\\"", "\\\\", "\\/", "\\n", "\\t", "\\u00e9", "\\ud83d\\ude00",
+                    "\\\\\\\"", "\xc3\xa9"
+                };
+                out += '"';
+                const std::size_t n = below(8) ? below(12) : below(150);
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    if (escapes && !below(4))
+                    {
+                        out += special[below(sizeof special / sizeof *special)];
+                    }
+                    else
+                    {
+                        out += plain[below(sizeof plain - 1)];
+                    }
+                }
+                out += '"';
+            }
+
+            void value(std::string &out, int depth)
+            {
+                // Containers at the top, scalars at the bottom
+                const std::size_t pick = depth == 0 ? below(2) : depth > 4 ? 2 + below(5) : below(7);
+                switch (pick)
+                {
+                    case 0:
+                    {
+                        out += '{';
+                        const std::size_t n = below(6);
+                        for (std::size_t i = 0; i < n; ++i)
+                        {
+                            if (i)
+                            {
+                                out += ',';
+                            }
+                            space(out);
+                            // Keys are compared raw, so keep them unescaped;
+                            // the index makes them unique
+                            out += "\"k" + std::to_string(i) + "{:[,]}\"";
+                            space(out);
+                            out += ':';
+                            space(out);
+                            value(out, depth + 1);
+                            space(out);
+                        }
+                        out += '}';
+                        break;
+                    }
+                    case 1:
+                    {
+                        out += '[';
+                        const std::size_t n = below(7);
+                        for (std::size_t i = 0; i < n; ++i)
+                        {
+                            if (i)
+                            {
+                                out += ',';
+                            }
+                            space(out);
+                            value(out, depth + 1);
+                            space(out);
+                        }
+                        out += ']';
+                        break;
+                    }
+                    case 2:
+                    case 3:
+                        string(out, true);
+                        break;
+                    case 4:
+                    {
+                        static const char *const numbers[] = {
+                            "0", "-1", "42", "18446744073709551615", "-9223372036854775808",
+                            "3.25", "-0.5", "1e3", "6.02E+23"
+                        };
+                        out += numbers[below(sizeof numbers / sizeof *numbers)];
+                        break;
+                    }
+                    case 5:
+                        out += below(2) ? "true" : "false";
+                        break;
+                    default:
+                        out += "null";
+                        break;
+                }
+            }
+
+            std::mt19937 rng;
+    };
+
+    void compare(const ondemand::value &got, const boost::json::value &want)
+    {
+        CHECK(got.exists());
+        switch (want.kind())
+        {
+            case boost::json::kind::object:
+            {
+                CHECK(got.kind() == ondemand::kind::object);
+                const boost::json::object &o = want.get_object();
+                auto it = o.begin();
+                got.for_each_field([&](boost::json::string_view key, const ondemand::value &v)
+                {
+                    CHECK(it != o.end());
+                    CHECK(key == it->key());
+                    compare(v, it->value());
+                    compare(got[key], it->value());
+                    ++it;
+                });
+                CHECK(it == o.end());
+                CHECK(!got["missing"].exists());
+                break;
+            }
+            case boost::json::kind::array:
+            {
+                CHECK(got.kind() == ondemand::kind::array);
+                const boost::json::array &a = want.get_array();
+                std::size_t i = 0;
+                got.for_each_element([&](const ondemand::value &v)
+                {
+                    CHECK(i < a.size());
+                    compare(v, a[i]);
+                    CHECK(got.at(i).raw_json() == v.raw_json());
+                    ++i;
+                });
+                CHECK(i == a.size());
+                CHECK(!got.at(a.size()).exists());
+                break;
+            }
+            case boost::json::kind::string:
+                CHECK(got.kind() == ondemand::kind::string);
+                CHECK(got.get_string() == boost::json::string_view(want.get_string()));
+                break;
+            case boost::json::kind::int64:
+                CHECK(got.kind() == ondemand::kind::number);
+                CHECK(got.get_int64() == want.get_int64());
+                break;
+            case boost::json::kind::uint64:
+                CHECK(got.kind() == ondemand::kind::number);
+                CHECK(got.get_uint64() == want.get_uint64());
+                break;
+            case boost::json::kind::double_:
+                CHECK(got.kind() == ondemand::kind::number);
+                CHECK(std::fabs(got.get_double() - want.get_double()) <=
+                      1e-12 * std::fabs(want.get_double()));
+                break;
+            case boost::json::kind::bool_:
+                CHECK(got.kind() == ondemand::kind::boolean);
+                CHECK(got.get_bool() == want.get_bool());
+                break;
+            case boost::json::kind::null:
+                CHECK(got.is_null());
+                break;
+        }
+    }
+}
+
+int main()
+{
+    const ondemand::simd_level levels[] = {
+        ondemand::simd_level::scalar, ondemand::simd_level::sse42, ondemand::simd_level::avx2
+    };
+
+    generator gen(2024);
+    for (int i = 0; i < 20000; ++i)
+    {
+        const std::string json = gen.document();
+        const boost::json::value want = boost::json::parse(json);
+        for (const ondemand::simd_level level : levels)
+        {
+            const ondemand::document doc(json, level);
+            compare(doc.root(), want);
+        }
+    }
+
+    // Paths through a gateway frame
+    const std::string frame = R"({"op":0,"s":7,"t":"MESSAGE_CREATE","d":)"
+                              R"({"content":"a \"quoted\" {b}","author":{"id":"80351110224678912"}}})";
+    for (const ondemand::simd_level level : levels)
+    {
+        const ondemand::document doc(frame, level);
+        CHECK(doc.root().at_path("d.author.id").get_string() == "80351110224678912");
+        CHECK(doc.root().at_path("d.content").get_string() == "a \"quoted\" {b}");
+        CHECK(!doc.root().at_path("d.author.name").exists());
+        CHECK(doc.root()["s"].get_int64() == 7);
+    }
+
+    // An unterminated string can't be indexed
+    bool threw = false;
+    try
+    {
+        ondemand::document doc(R"({"a":"b})");
+    }
+    catch (const std::invalid_argument &)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+    return 0;
+}
@@ -0,0 +1,76 @@
+/*! \file url_encode_test.cpp
+ *  \brief Checks http::url_encode against a byte-at-a-time reference
+ */
+
+/*  This file is part of discpp.
+ *
+ *  discpp is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  discpp is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with discpp. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <random>
+#include <string>
+
+#include "net/http.hpp"
+#include "check.hpp"
+
+namespace
+{
+    using namespace discpp;
+
+    /*! RFC 3986 percent-encoding, the obvious way */
+    std::string reference(const std::string &s)
+    {
+        static const char hex[] = "0123456789ABCDEF";
+        std::string out;
+        for (unsigned char c : s)
+        {
+            if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+                c == '-' || c == '.' || c == '_' || c == '~')
+            {
+                out += static_cast<char>(c);
+            }
+            else
+            {
+                out += '%';
+                out += hex[c >> 4];
+                out += hex[c & 0x0F];
+            }
+        }
+        return out;
+    }
+}
+
+int main()
+{
+    CHECK(http::url_encode("") == "");
+    CHECK(http::url_encode("thumbs:41771983423143937") == "thumbs%3A41771983423143937");
+    CHECK(http::url_encode("\xF0\x9F\x91\x8D") == "%F0%9F%91%8D");
+    CHECK(http::url_encode("a b/c?d") == "a%20b%2Fc%3Fd");
+
+    // Mostly unreserved bytes, so the 16 byte runs get exercised, with
+    // every other byte value mixed in. Lengths straddle the block size.
+    static const char unreserved[] = "azAZ09-._~";
+    std::mt19937 rng(1);
+    for (int i = 0; i < 20000; ++i)
+    {
+        std::string s(rng() % 70, '\0');
+        for (char &c : s)
+        {
+            c = rng() % 10 < 7 ? unreserved[rng() % (sizeof unreserved - 1)]
+                               : static_cast<char>(rng() % 256);
+        }
+        CHECK(http::url_encode(s) == reference(s));
+    }
+    return 0;
+}